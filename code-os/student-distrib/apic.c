@@ -0,0 +1,564 @@
+/* apic.c - Local APIC and IOAPIC support
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "i8259.h"
+#include "lib.h"
+#include "paging.h"
+#include "pit.h"
+
+#define CPUID_FEATURES_LEAF     1
+#define CPUID_EDX_APIC          0x00000200  // CPUID.1:EDX bit 9
+
+#define LAPIC_DEFAULT_BASE      0xFEE00000
+#define IOAPIC_DEFAULT_BASE     0xFEC00000
+
+#define FIRMWARE_ALIGN          16          // MP and ACPI pointers sit on paragraph boundaries
+
+/* ACPI: root pointer, table header and MADT layout */
+#define ACPI_RSDP_LENGTH        20          // bytes covered by the version 1 checksum
+#define ACPI_RSDP_RSDT          16
+#define ACPI_HEADER_LENGTH      36
+#define ACPI_TABLE_LENGTH       4
+#define MADT_LAPIC_ADDR         36
+#define MADT_ENTRIES            44
+#define MADT_LAPIC              0           // processor local APIC
+#define MADT_IOAPIC             1
+#define MADT_OVERRIDE           2           // ISA interrupt source override
+#define MADT_LAPIC_ENABLED      0x1
+
+/* MP specification: floating pointer and configuration table layout */
+#define MP_FLOAT_LENGTH         16
+#define MP_FLOAT_CONFIG         4
+#define MP_FLOAT_FEATURE1       11          // nonzero: a default configuration without a table
+#define MP_FLOAT_FEATURE2       12
+#define MP_FEATURE2_IMCR        0x80        // PIC mode: IMCR must be switched to APIC mode
+#define MP_CONFIG_LENGTH        4
+#define MP_CONFIG_COUNT         34
+#define MP_CONFIG_LAPIC_ADDR    36
+#define MP_CONFIG_ENTRIES       44
+#define MP_PROCESSOR            0
+#define MP_BUS                  1
+#define MP_IOAPIC               2
+#define MP_IO_INTERRUPT         3
+#define MP_PROCESSOR_SIZE       20
+#define MP_ENTRY_SIZE           8           // every other entry type
+#define MP_CPU_ENABLED          0x1
+#define MP_IOAPIC_ENABLED       0x1
+#define MP_INT_VECTORED         0
+
+#define IMCR_SELECT_PORT        0x22
+#define IMCR_DATA_PORT          0x23
+#define IMCR_SELECT             0x70
+#define IMCR_APIC_MODE          0x01
+
+/* MPS/ACPI interrupt flags: polarity in bits 0-1, trigger mode in bits 2-3 */
+#define INT_POLARITY_MASK       0x3
+#define INT_POLARITY_LOW        0x3
+#define INT_TRIGGER_MASK        0xC
+#define INT_TRIGGER_LEVEL       0xC
+
+#define LAPIC_CALIBRATE_US      10000       // measure the LAPIC timer over 10ms of PIT time
+#define US_PER_SEC              1000000
+
+volatile uint32_t apic_enabled = 0;
+uint32_t apic_cpu_count = 0;
+uint8_t apic_cpu_ids[APIC_MAX_CPUS];
+uint32_t apic_bsp_id = 0;
+
+static volatile uint8_t* lapic_base = (uint8_t*)LAPIC_DEFAULT_BASE;
+static volatile uint8_t* ioapic_base = NULL;
+static uint32_t ioapic_gsi_base = 0;
+static uint32_t ioapic_imcr = 0;            // firmware left the PICs wired straight to the CPU
+
+/* IOAPIC pin and MPS/ACPI flags of each ISA IRQ (identity, edge, active high unless overridden) */
+static uint32_t isa_irq_gsi[APIC_ISA_IRQS];
+static uint32_t isa_irq_flags[APIC_ISA_IRQS];
+
+static uint32_t lapic_timer_hz_count = 0;   // LAPIC timer counts per second at LAPIC_TIMER_DIV_16
+static spinlock_t ioapic_lock = SPINLOCK_INIT;  // the select/window pair is not reentrant
+
+static int32_t acpi_parse(void);
+static int32_t mp_parse(void);
+static uint32_t ioapic_read(uint32_t reg);
+static void ioapic_write(uint32_t reg, uint32_t value);
+
+/*
+ * checksum_ok
+ *   DESCRIPTION: Firmware table checksum: all bytes must add up to 0
+ *   INPUTS: table - first byte, length - number of bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the checksum holds
+ *   SIDE EFFECTS: none
+ */
+static int32_t checksum_ok(const uint8_t* table, uint32_t length){
+    uint8_t sum = 0;
+    uint32_t i;
+
+    for(i = 0; i < length; i++){
+        sum += table[i];
+    }
+    return sum == 0;
+}
+
+/*
+ * firmware_find
+ *   DESCRIPTION: Look for a signed structure in the EBDA and BIOS ROM areas
+ *   INPUTS: signature - string it starts with, length - bytes covered by its checksum
+ *   OUTPUTS: none
+ *   RETURN VALUE: its address, or NULL (the areas must be mapped, see paging_map_firmware)
+ *   SIDE EFFECTS: none
+ */
+static uint8_t* firmware_find(const int8_t* signature, uint32_t length){
+    uint32_t areas[2][2] = {
+        { FIRMWARE_EBDA_START, FIRMWARE_EBDA_END },
+        { FIRMWARE_ROM_START, FIRMWARE_ROM_END }
+    };
+    uint32_t sig_length = strlen(signature);
+    uint32_t area;
+    uint8_t* p;
+
+    for(area = 0; area < 2; area++){
+        for(p = (uint8_t*)areas[area][0]; p < (uint8_t*)areas[area][1]; p += FIRMWARE_ALIGN){
+            if(strncmp((int8_t*)p, signature, sig_length) == 0 && checksum_ok(p, length)){
+                return p;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * apic_add_cpu
+ *   DESCRIPTION: Remember a processor listed by the firmware
+ *   INPUTS: id - its LAPIC id
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: grows apic_cpu_ids (extra processors are ignored)
+ */
+static void apic_add_cpu(uint32_t id){
+    if(apic_cpu_count < APIC_MAX_CPUS){
+        apic_cpu_ids[apic_cpu_count++] = id;
+    }
+}
+
+/*
+ * apic_init
+ *   DESCRIPTION: Detect the LAPIC and IOAPIC and route the ISA IRQs through them
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the APICs are in use, -1 if the 8259 stays in charge
+ *   SIDE EFFECTS: Masks the 8259s, maps the APIC registers, enables the LAPIC of
+ *                 this CPU. Call after i8259_init and before any enable_irq.
+ */
+int32_t apic_init(void){
+    uint32_t features;
+    uint32_t irq, pin, pins;
+    uint32_t low;
+    int32_t found;
+
+    asm volatile ("cpuid"
+            : "=d"(features)
+            : "a"(CPUID_FEATURES_LEAF)
+            : "ebx", "ecx"
+    );
+    if(!(features & CPUID_EDX_APIC)){
+        return -1;
+    }
+
+    for(irq = 0; irq < APIC_ISA_IRQS; irq++){
+        isa_irq_gsi[irq] = irq;
+        isa_irq_flags[irq] = 0;
+    }
+
+    // the tables live in BIOS memory, which is not normally mapped
+    paging_map_firmware(1);
+    found = (acpi_parse() == 0 || mp_parse() == 0);
+    paging_map_firmware(0);
+    if(!found || ioapic_base == NULL){
+        apic_cpu_count = 0;
+        return -1;
+    }
+
+    if(paging_map_4mb((uint32_t)lapic_base, 1) < 0 || paging_map_4mb((uint32_t)ioapic_base, 1) < 0){
+        return -1;
+    }
+
+    // silence the 8259s for good; they stay remapped so stray vectors land above 0x20
+    outb(0xFF, MASTER_8259_DATA);
+    outb(0xFF, SLAVE_8259_DATA);
+    if(ioapic_imcr){
+        outb(IMCR_SELECT, IMCR_SELECT_PORT);
+        outb(IMCR_APIC_MODE, IMCR_DATA_PORT);
+    }
+
+    lapic_enable();
+    apic_bsp_id = lapic_id();
+
+    // every pin starts masked; ISA IRQs go to the boot processor
+    pins = ((ioapic_read(IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+    for(pin = 0; pin < pins; pin++){
+        ioapic_write(IOAPIC_REG_REDIR + 2 * pin, IOAPIC_REDIR_MASKED);
+        ioapic_write(IOAPIC_REG_REDIR + 2 * pin + 1, 0);
+    }
+    for(irq = 0; irq < APIC_ISA_IRQS; irq++){
+        if(irq == SLAVE_IRQ_ON_MASTER || isa_irq_gsi[irq] - ioapic_gsi_base >= pins){
+            continue;                       // the cascade line does not exist on an IOAPIC
+        }
+        pin = isa_irq_gsi[irq] - ioapic_gsi_base;
+        low = (APIC_IRQ_VECTOR_BASE + irq) | IOAPIC_REDIR_MASKED;
+        if((isa_irq_flags[irq] & INT_POLARITY_MASK) == INT_POLARITY_LOW){
+            low |= IOAPIC_REDIR_ACTIVE_LOW;
+        }
+        if((isa_irq_flags[irq] & INT_TRIGGER_MASK) == INT_TRIGGER_LEVEL){
+            low |= IOAPIC_REDIR_LEVEL;
+        }
+        ioapic_write(IOAPIC_REG_REDIR + 2 * pin + 1, apic_bsp_id << IOAPIC_DEST_SHIFT);
+        ioapic_write(IOAPIC_REG_REDIR + 2 * pin, low);
+    }
+
+    apic_enabled = 1;
+    return 0;
+}
+
+/*
+ * acpi_parse
+ *   DESCRIPTION: Read the processors, IOAPIC and ISA overrides from the ACPI MADT
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if a MADT was found, -1 otherwise
+ *   SIDE EFFECTS: fills the module state; maps the ACPI tables while reading them
+ */
+static int32_t acpi_parse(void){
+    uint8_t* rsdp = firmware_find("RSD PTR ", ACPI_RSDP_LENGTH);
+    uint8_t* rsdt;
+    uint8_t* madt = NULL;
+    uint8_t* entry;
+    uint8_t* end;
+    int32_t rsdt_mapped, madt_mapped = 0;
+    uint32_t i, count;
+
+    if(rsdp == NULL){
+        return -1;
+    }
+    rsdt = (uint8_t*)*(uint32_t*)(rsdp + ACPI_RSDP_RSDT);
+    if((rsdt_mapped = paging_map_4mb((uint32_t)rsdt, 0)) < 0){
+        return -1;
+    }
+
+    if(strncmp((int8_t*)rsdt, "RSDT", 4) == 0){
+        count = (*(uint32_t*)(rsdt + ACPI_TABLE_LENGTH) - ACPI_HEADER_LENGTH) / sizeof(uint32_t);
+        for(i = 0; i < count && madt == NULL; i++){
+            entry = (uint8_t*)((uint32_t*)(rsdt + ACPI_HEADER_LENGTH))[i];
+            if((madt_mapped = paging_map_4mb((uint32_t)entry, 0)) < 0){
+                continue;
+            }
+            if(strncmp((int8_t*)entry, "APIC", 4) == 0){
+                madt = entry;
+            } else if(madt_mapped == 1){
+                paging_unmap_4mb((uint32_t)entry);
+            }
+        }
+    }
+
+    if(madt != NULL){
+        lapic_base = (uint8_t*)*(uint32_t*)(madt + MADT_LAPIC_ADDR);
+        end = madt + *(uint32_t*)(madt + ACPI_TABLE_LENGTH);
+        for(entry = madt + MADT_ENTRIES; entry < end && entry[1] != 0; entry += entry[1]){
+            switch(entry[0]){
+                case MADT_LAPIC:
+                    if(*(uint32_t*)(entry + 4) & MADT_LAPIC_ENABLED){
+                        apic_add_cpu(entry[3]);
+                    }
+                    break;
+                case MADT_IOAPIC:
+                    if(ioapic_base == NULL){    // the first IOAPIC carries the ISA IRQs
+                        ioapic_base = (uint8_t*)*(uint32_t*)(entry + 4);
+                        ioapic_gsi_base = *(uint32_t*)(entry + 8);
+                    }
+                    break;
+                case MADT_OVERRIDE:
+                    if(entry[3] < APIC_ISA_IRQS){
+                        isa_irq_gsi[entry[3]] = *(uint32_t*)(entry + 4);
+                        isa_irq_flags[entry[3]] = *(uint16_t*)(entry + 8);
+                    }
+                    break;
+            }
+        }
+        if(madt_mapped == 1){
+            paging_unmap_4mb((uint32_t)madt);
+        }
+    }
+    if(rsdt_mapped == 1){
+        paging_unmap_4mb((uint32_t)rsdt);
+    }
+    return (madt != NULL) ? 0 : -1;
+}
+
+/*
+ * mp_parse
+ *   DESCRIPTION: Read the processors, IOAPIC and ISA routing from the MP configuration table
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if an MP floating pointer was found, -1 otherwise
+ *   SIDE EFFECTS: fills the module state
+ */
+static int32_t mp_parse(void){
+    uint8_t* mpf = firmware_find("_MP_", MP_FLOAT_LENGTH);
+    uint8_t* config;
+    uint8_t* entry;
+    uint32_t isa_bus = (uint32_t)-1;
+    uint32_t i, count;
+    int32_t mapped;
+
+    if(mpf == NULL){
+        return -1;
+    }
+    ioapic_imcr = (mpf[MP_FLOAT_FEATURE2] & MP_FEATURE2_IMCR) != 0;
+
+    config = (uint8_t*)*(uint32_t*)(mpf + MP_FLOAT_CONFIG);
+    if(mpf[MP_FLOAT_FEATURE1] != 0 || config == NULL){
+        // one of the default configurations: two CPUs, standard addresses
+        apic_add_cpu(0);
+        apic_add_cpu(1);
+        ioapic_base = (uint8_t*)IOAPIC_DEFAULT_BASE;
+        return 0;
+    }
+
+    if((mapped = paging_map_4mb((uint32_t)config, 0)) < 0){
+        return -1;
+    }
+    if(strncmp((int8_t*)config, "PCMP", 4) == 0 &&
+       checksum_ok(config, *(uint16_t*)(config + MP_CONFIG_LENGTH))){
+        lapic_base = (uint8_t*)*(uint32_t*)(config + MP_CONFIG_LAPIC_ADDR);
+        count = *(uint16_t*)(config + MP_CONFIG_COUNT);
+        entry = config + MP_CONFIG_ENTRIES;
+        for(i = 0; i < count; i++){
+            switch(entry[0]){
+                case MP_PROCESSOR:
+                    if(entry[3] & MP_CPU_ENABLED){
+                        apic_add_cpu(entry[1]);
+                    }
+                    entry += MP_PROCESSOR_SIZE;
+                    continue;
+                case MP_BUS:
+                    if(strncmp((int8_t*)entry + 2, "ISA", 3) == 0){
+                        isa_bus = entry[1];
+                    }
+                    break;
+                case MP_IOAPIC:
+                    if((entry[3] & MP_IOAPIC_ENABLED) && ioapic_base == NULL){
+                        ioapic_base = (uint8_t*)*(uint32_t*)(entry + 4);
+                    }
+                    break;
+                case MP_IO_INTERRUPT:
+                    // the bus entries come first, so isa_bus is known by now
+                    if(entry[1] == MP_INT_VECTORED && entry[4] == isa_bus && entry[5] < APIC_ISA_IRQS){
+                        isa_irq_gsi[entry[5]] = entry[7];
+                        isa_irq_flags[entry[5]] = *(uint16_t*)(entry + 2);
+                    }
+                    break;
+            }
+            entry += MP_ENTRY_SIZE;
+        }
+    }
+    if(mapped == 1){
+        paging_unmap_4mb((uint32_t)config);
+    }
+    return (ioapic_base != NULL) ? 0 : -1;
+}
+
+/*
+ * lapic_read, lapic_write
+ *   DESCRIPTION: Access a local APIC register
+ *   INPUTS: reg - LAPIC_* offset, value - value to store
+ *   OUTPUTS: none
+ *   RETURN VALUE: register contents (lapic_read)
+ *   SIDE EFFECTS: device register access
+ */
+uint32_t lapic_read(uint32_t reg){
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+void lapic_write(uint32_t reg, uint32_t value){
+    *(volatile uint32_t*)(lapic_base + reg) = value;
+}
+
+/*
+ * ioapic_read, ioapic_write
+ *   DESCRIPTION: Access an IOAPIC register through the select/window pair
+ *   INPUTS: reg - register index, value - value to store
+ *   OUTPUTS: none
+ *   RETURN VALUE: register contents (ioapic_read)
+ *   SIDE EFFECTS: device register access
+ */
+static uint32_t ioapic_read(uint32_t reg){
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    return *(volatile uint32_t*)(ioapic_base + IOAPIC_WINDOW);
+}
+
+static void ioapic_write(uint32_t reg, uint32_t value){
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_WINDOW) = value;
+}
+
+/*
+ * lapic_enable
+ *   DESCRIPTION: Turn on the local APIC of the calling CPU
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Sets the spurious vector, accepts all priorities, masks LINT0
+ */
+void lapic_enable(void){
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);    // 8259 virtual wire, unused now
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_NMI);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+}
+
+/*
+ * lapic_id
+ *   DESCRIPTION: LAPIC id of the calling CPU
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the id
+ *   SIDE EFFECTS: none
+ */
+uint32_t lapic_id(void){
+    return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/*
+ * lapic_eoi
+ *   DESCRIPTION: Signal end of interrupt to the calling CPU's LAPIC
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: one memory-mapped store
+ */
+void lapic_eoi(void){
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+ * lapic_timer_init
+ *   DESCRIPTION: Start the calling CPU's LAPIC timer in periodic mode
+ *   INPUTS: hz - interrupts per second
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Calibrates the timer against the PIT on first use
+ */
+void lapic_timer_init(uint32_t hz){
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_16);
+
+    if(lapic_timer_hz_count == 0){
+        // count down from the top for a known stretch of PIT time
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+        lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+        pit_wait_us(LAPIC_CALIBRATE_US);
+        lapic_timer_hz_count = (0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT)) * (US_PER_SEC / LAPIC_CALIBRATE_US);
+        lapic_write(LAPIC_TIMER_INIT, 0);
+    }
+
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR | LAPIC_TIMER_PERIODIC);
+    lapic_timer_set_rate(hz);
+}
+
+/*
+ * lapic_timer_set_rate
+ *   DESCRIPTION: Change the period of the calling CPU's LAPIC timer
+ *   INPUTS: hz - interrupts per second
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Restarts the count
+ */
+void lapic_timer_set_rate(uint32_t hz){
+    uint32_t count = lapic_timer_hz_count / (hz ? hz : 1);
+    lapic_write(LAPIC_TIMER_INIT, count ? count : 1);
+}
+
+/*
+ * lapic_timer_oneshot
+ *   DESCRIPTION: Switch the calling CPU's LAPIC timer to a single interrupt
+ *   INPUTS: hz - periodic rate the delay is counted in, periods - how many
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Stops the periodic tick until lapic_timer_init
+ */
+void lapic_timer_oneshot(uint32_t hz, uint32_t periods){
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, lapic_timer_hz_count / hz * periods);
+}
+
+/*
+ * lapic_timer_elapsed
+ *   DESCRIPTION: How much of a one-shot delay has passed
+ *   INPUTS: hz - rate passed to lapic_timer_oneshot
+ *   OUTPUTS: none
+ *   RETURN VALUE: whole periods elapsed (all of them once it fired)
+ *   SIDE EFFECTS: none
+ */
+uint32_t lapic_timer_elapsed(uint32_t hz){
+    uint32_t period = lapic_timer_hz_count / hz;
+
+    return (lapic_read(LAPIC_TIMER_INIT) - lapic_read(LAPIC_TIMER_CURRENT)) / (period ? period : 1);
+}
+
+/*
+ * lapic_timer_handler
+ *   DESCRIPTION: LAPIC timer interrupt (vector LAPIC_TIMER_VECTOR)
+ *   INPUTS: frame - context the timer interrupted
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Acknowledges the LAPIC, then runs the common timer tick
+ *                 (which may switch to another task before returning)
+ */
+void lapic_timer_handler(irq_frame_t* frame){
+    lapic_eoi();
+    timer_tick(frame);
+}
+
+/*
+ * ioapic_set_mask
+ *   DESCRIPTION: Mask or unmask the IOAPIC pin of an ISA IRQ
+ *   INPUTS: irq - ISA IRQ number, masked - 1 to mask
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: rewrites the low half of the redirection entry
+ */
+static void ioapic_set_mask(uint32_t irq, uint32_t masked){
+    uint32_t reg;
+    uint32_t flags;
+
+    if(irq >= APIC_ISA_IRQS){
+        return;
+    }
+    reg = IOAPIC_REG_REDIR + 2 * (isa_irq_gsi[irq] - ioapic_gsi_base);
+
+    spin_lock_irqsave(&ioapic_lock, flags);
+    if(masked){
+        ioapic_write(reg, ioapic_read(reg) | IOAPIC_REDIR_MASKED);
+    } else{
+        ioapic_write(reg, ioapic_read(reg) & ~IOAPIC_REDIR_MASKED);
+    }
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+/*
+ * ioapic_enable_irq, ioapic_disable_irq
+ *   DESCRIPTION: Unmask/mask the IOAPIC pin an ISA IRQ is wired to
+ *   INPUTS: irq - ISA IRQ number (0-15)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: rewrites the low half of the pin's redirection entry
+ */
+void ioapic_enable_irq(uint32_t irq){
+    ioapic_set_mask(irq, 0);
+}
+
+void ioapic_disable_irq(uint32_t irq){
+    ioapic_set_mask(irq, 1);
+}
@@ -0,0 +1,177 @@
+/* apic.h - Local APIC and IOAPIC support
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+#include "idt.h"
+
+/* apic_init() looks for the interrupt controllers in the ACPI MADT, then in
+ * the MP configuration table. When it finds a LAPIC and an IOAPIC it masks
+ * the 8259s and enable_irq/disable_irq/send_eoi (i8259.c) switch over to
+ * the IOAPIC redirection table and the memory-mapped LAPIC EOI register.
+ * Without them everything keeps running on the 8259 and the PIT. */
+
+#define APIC_MAX_CPUS           8
+#define APIC_ISA_IRQS           16
+
+/* Vectors. ISA IRQ n keeps vector 0x20 + n, as with the 8259 */
+#define APIC_IRQ_VECTOR_BASE    0x20
+#define LAPIC_TIMER_VECTOR      0x30
+#define SCHED_IPI_VECTOR        0x31        // wakes an idle CPU (smp_wakeup)
+#define APIC_SPURIOUS_VECTOR    0xFF
+
+/* Local APIC registers (byte offsets from the LAPIC base) */
+#define LAPIC_ID                0x020
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0
+#define LAPIC_ICR_LOW           0x300
+#define LAPIC_ICR_HIGH          0x310
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_TIMER_INIT        0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+
+#define LAPIC_SVR_ENABLE        0x100
+#define LAPIC_LVT_MASKED        0x10000
+#define LAPIC_LVT_NMI           0x400
+#define LAPIC_TIMER_PERIODIC    0x20000
+#define LAPIC_TIMER_DIV_16      0x3
+#define LAPIC_ID_SHIFT          24
+
+/* IOAPIC registers, reached through the select/window pair */
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WINDOW           0x10
+#define IOAPIC_REG_VERSION      0x01
+#define IOAPIC_REG_REDIR        0x10        // two registers per pin
+#define IOAPIC_REDIR_MASKED     0x10000
+#define IOAPIC_REDIR_LEVEL      0x8000
+#define IOAPIC_REDIR_ACTIVE_LOW 0x2000
+#define IOAPIC_DEST_SHIFT       24
+
+/* 1 once interrupts are routed through the IOAPIC and LAPIC */
+extern volatile uint32_t apic_enabled;
+/* Processors the firmware lists, by LAPIC id; the boot processor is apic_bsp_id */
+extern uint32_t apic_cpu_count;
+extern uint8_t apic_cpu_ids[APIC_MAX_CPUS];
+extern uint32_t apic_bsp_id;
+
+/*
+ * apic_init
+ *   DESCRIPTION: Detect the LAPIC and IOAPIC and route the ISA IRQs through them
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the APICs are in use, -1 if the 8259 stays in charge
+ *   SIDE EFFECTS: Masks the 8259s, maps the APIC registers, enables the LAPIC of
+ *                 this CPU. Call after i8259_init and before any enable_irq.
+ */
+int32_t apic_init(void);
+
+/*
+ * lapic_enable
+ *   DESCRIPTION: Turn on the local APIC of the calling CPU
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Sets the spurious vector, accepts all priorities, masks LINT0
+ */
+void lapic_enable(void);
+
+/*
+ * lapic_timer_init
+ *   DESCRIPTION: Start the calling CPU's LAPIC timer in periodic mode
+ *   INPUTS: hz - interrupts per second
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Calibrates the timer against the PIT on first use
+ */
+void lapic_timer_init(uint32_t hz);
+
+/*
+ * lapic_timer_set_rate
+ *   DESCRIPTION: Change the period of the calling CPU's LAPIC timer
+ *   INPUTS: hz - interrupts per second
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Restarts the count
+ */
+void lapic_timer_set_rate(uint32_t hz);
+
+/*
+ * lapic_timer_oneshot
+ *   DESCRIPTION: Switch the calling CPU's LAPIC timer to a single interrupt
+ *   INPUTS: hz - periodic rate the delay is counted in, periods - how many
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Stops the periodic tick until lapic_timer_init
+ */
+void lapic_timer_oneshot(uint32_t hz, uint32_t periods);
+
+/*
+ * lapic_timer_elapsed
+ *   DESCRIPTION: How much of a one-shot delay has passed
+ *   INPUTS: hz - rate passed to lapic_timer_oneshot
+ *   OUTPUTS: none
+ *   RETURN VALUE: whole periods elapsed (all of them once it fired)
+ *   SIDE EFFECTS: none
+ */
+uint32_t lapic_timer_elapsed(uint32_t hz);
+
+/*
+ * lapic_timer_handler
+ *   DESCRIPTION: LAPIC timer interrupt (vector LAPIC_TIMER_VECTOR)
+ *   INPUTS: frame - context the timer interrupted
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Acknowledges the LAPIC, then runs the common timer tick
+ */
+void lapic_timer_handler(irq_frame_t* frame);
+
+/*
+ * lapic_id
+ *   DESCRIPTION: LAPIC id of the calling CPU
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the id
+ *   SIDE EFFECTS: none
+ */
+uint32_t lapic_id(void);
+
+/*
+ * lapic_read, lapic_write
+ *   DESCRIPTION: Access a local APIC register
+ *   INPUTS: reg - LAPIC_* offset, value - value to store
+ *   OUTPUTS: none
+ *   RETURN VALUE: register contents (lapic_read)
+ *   SIDE EFFECTS: device register access
+ */
+uint32_t lapic_read(uint32_t reg);
+void lapic_write(uint32_t reg, uint32_t value);
+
+/*
+ * lapic_eoi
+ *   DESCRIPTION: Signal end of interrupt to the calling CPU's LAPIC
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: one memory-mapped store
+ */
+void lapic_eoi(void);
+
+/*
+ * ioapic_enable_irq, ioapic_disable_irq
+ *   DESCRIPTION: Unmask/mask the IOAPIC pin an ISA IRQ is wired to
+ *   INPUTS: irq - ISA IRQ number (0-15)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: rewrites the low half of the pin's redirection entry
+ */
+void ioapic_enable_irq(uint32_t irq);
+void ioapic_disable_irq(uint32_t irq);
+
+#endif /* _APIC_H */
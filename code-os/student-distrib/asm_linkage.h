@@ -5,6 +5,10 @@
     extern void rtc_handler_asm();          // linkage for RTC handler
     extern void keyboard_handler_asm();     // linkage for keyboard handler
     extern void pit_handler_asm();     // linkage for keyboard handler
+    extern void lapic_timer_handler_asm();  // linkage for LAPIC timer handler
+    extern void ata_handler_asm();          // linkage for the primary IDE channel
+    extern void apic_spurious_asm();        // LAPIC spurious vector (no EOI)
+    extern void sched_ipi_asm();            // wakeup IPI between CPUs
 #endif
 
 #endif
@@ -0,0 +1,457 @@
+/* ata.c - IDE/ATA disks on the primary channel
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ata.h"
+#include "lib.h"
+#include "i8259.h"
+#include "sched.h"
+#include "timer.h"
+
+/* primary channel task file */
+#define ATA_DATA                0x1F0
+#define ATA_COUNT               0x1F2
+#define ATA_LBA_LO              0x1F3
+#define ATA_LBA_MID             0x1F4
+#define ATA_LBA_HI              0x1F5
+#define ATA_DRIVE               0x1F6
+#define ATA_STATUS              0x1F7       // read
+#define ATA_COMMAND             0x1F7       // write
+#define ATA_CONTROL             0x3F6       // write; reads give the status without acking the IRQ
+
+#define ATA_SR_BSY              0x80
+#define ATA_SR_DF               0x20
+#define ATA_SR_DRQ              0x08
+#define ATA_SR_ERR              0x01
+#define ATA_CTRL_NIEN           0x02        // no interrupts from the drive
+
+#define ATA_CMD_READ_PIO        0x20
+#define ATA_CMD_WRITE_PIO       0x30
+#define ATA_CMD_READ_DMA        0xC8
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_FLUSH           0xE7
+#define ATA_CMD_IDENTIFY        0xEC
+
+#define ATA_DRIVE_LBA           0xE0        // LBA addressing, bits 24-27 of the LBA below
+#define ATA_ID_SECTORS_LO       60          // IDENTIFY words holding the LBA28 sector count
+#define ATA_ID_SECTORS_HI       61
+#define ATA_LBA28_MAX           (1 << 28)
+#define ATA_TIMEOUT             1000000     // status polls before giving up
+#define ATA_DMA_TIMEOUT_MS      5000        // a DMA transfer whose interrupt has not come by then failed
+
+/* bus-master IDE registers, at the controller's BAR4 */
+#define BM_COMMAND              0
+#define BM_STATUS               2
+#define BM_PRDT                 4
+#define BM_CMD_START            0x01
+#define BM_CMD_READ             0x08        // device to memory
+#define BM_SR_ERR               0x02
+#define BM_SR_IRQ               0x04
+#define PRD_EOT                 0x8000
+
+#define PCI_CONFIG_ADDRESS      0xCF8
+#define PCI_CONFIG_DATA         0xCFC
+#define PCI_ENABLE              0x80000000
+#define PCI_CLASS_IDE           0x0101      // mass storage, IDE
+#define PCI_REG_COMMAND         0x04
+#define PCI_REG_CLASS           0x08
+#define PCI_REG_BAR4            0x20
+#define PCI_CMD_IO_MASTER       0x05        // I/O space and bus mastering
+
+/* DMA target: the kernel page is identity mapped, so these addresses are physical */
+#define ATA_DMA_SECTORS         8           // per command: one 4kB page, which never crosses 64kB
+#define ATA_DMA_BYTES           (ATA_DMA_SECTORS * ATA_SECTOR_SIZE)
+#define KERNEL_PAGE_START       0x400000
+#define KERNEL_PAGE_END         0x800000
+
+/* physical region descriptor; one covers a whole transfer */
+typedef struct {
+    uint32_t addr;
+    uint16_t bytes;
+    uint16_t flags;
+} prd_t;
+
+static uint32_t drive_sectors[ATA_NUM_DRIVES];     // 0 for no drive
+static uint32_t bm_base;                            // 0 for PIO only
+static prd_t prd __attribute__((aligned(8)));
+static uint8_t bounce[ATA_DMA_BYTES] __attribute__((aligned(ATA_DMA_BYTES)));
+static sleep_lock_t channel_lock = SLEEP_LOCK_INIT;    // one transfer at a time; prd and bounce
+
+static volatile int dma_done;                       // the interrupt came or the timeout expired
+static volatile int dma_timed_out;
+static volatile uint32_t dma_status;                // bus-master status the transfer ended with
+static wait_queue_t dma_wait = WAIT_QUEUE_INIT;
+static ktimer_t dma_timer;
+static volatile uint32_t dma_seq;                   // transfers started; tells dma_timer's callback if it is stale
+
+static int32_t ata_transfer(uint32_t drive, uint32_t lba, uint32_t count, uint8_t* buf, int write);
+static void ata_dma_timeout(ktimer_t* timer);
+static int32_t ata_dma(uint32_t drive, uint32_t lba, uint32_t count, uint32_t addr, int write);
+static int32_t ata_pio(uint32_t drive, uint32_t lba, uint32_t count, uint8_t* buf, int write);
+static void ata_select(uint32_t drive, uint32_t lba, uint32_t count);
+static uint32_t ata_wait(uint32_t mask);
+static uint32_t ata_identify(uint32_t drive);
+static uint32_t pci_read(uint32_t bus, uint32_t dev, uint32_t func, uint32_t reg);
+static void pci_write(uint32_t bus, uint32_t dev, uint32_t func, uint32_t reg, uint32_t value);
+
+/*
+ * ata_init
+ *   DESCRIPTION: Find the drives and the bus-master registers
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of ATA drives found
+ *   SIDE EFFECTS: Enables PCI bus mastering on the IDE controller and IRQ 14
+ */
+int32_t ata_init(void){
+    uint32_t dev, func, bar, found = 0;
+
+    // the IDE controller is on bus 0 on every chipset QEMU emulates
+    for(dev = 0; dev < 32 && bm_base == 0; dev++){
+        for(func = 0; func < 8; func++){
+            if((pci_read(0, dev, func, 0) & 0xFFFF) == 0xFFFF) continue;
+            if((pci_read(0, dev, func, PCI_REG_CLASS) >> 16) != PCI_CLASS_IDE) continue;
+            bar = pci_read(0, dev, func, PCI_REG_BAR4);
+            if(bar & 1){
+                bm_base = bar & 0xFFFC;
+                pci_write(0, dev, func, PCI_REG_COMMAND,
+                          (pci_read(0, dev, func, PCI_REG_COMMAND) & 0xFFFF) | PCI_CMD_IO_MASTER);
+            }
+            break;
+        }
+    }
+
+    // PIO polls, so only DMA wants the interrupt
+    outb(bm_base ? 0 : ATA_CTRL_NIEN, ATA_CONTROL);
+    drive_sectors[ATA_MASTER] = ata_identify(ATA_MASTER);
+    drive_sectors[ATA_SLAVE] = ata_identify(ATA_SLAVE);
+    found = (drive_sectors[ATA_MASTER] != 0) + (drive_sectors[ATA_SLAVE] != 0);
+    if(found && bm_base){
+        enable_irq(ATA_IRQ);
+    }
+    return found;
+}
+
+/*
+ * ata_sectors
+ *   DESCRIPTION: Size of a drive
+ *   INPUTS: drive - ATA_MASTER or ATA_SLAVE
+ *   OUTPUTS: none
+ *   RETURN VALUE: its LBA28 sector count, 0 if there is no such drive
+ *   SIDE EFFECTS: none
+ */
+uint32_t ata_sectors(uint32_t drive){
+    return (drive < ATA_NUM_DRIVES) ? drive_sectors[drive] : 0;
+}
+
+/*
+ * ata_read
+ *   DESCRIPTION: Read whole sectors from a drive
+ *   INPUTS: drive - ATA_MASTER or ATA_SLAVE, lba - first sector
+ *           count - sectors, buf - kernel memory of count * ATA_SECTOR_SIZE bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 for no drive, sectors past its end, or a
+ *                 device error or timeout
+ *   SIDE EFFECTS: May sleep
+ */
+int32_t ata_read(uint32_t drive, uint32_t lba, uint32_t count, void* buf){
+    return ata_transfer(drive, lba, count, buf, 0);
+}
+
+/*
+ * ata_write
+ *   DESCRIPTION: Write whole sectors to a drive
+ *   INPUTS: drive - ATA_MASTER or ATA_SLAVE, lba - first sector
+ *           count - sectors, buf - kernel memory of count * ATA_SECTOR_SIZE bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 for no drive, sectors past its end, or a
+ *                 device error or timeout
+ *   SIDE EFFECTS: May sleep
+ */
+int32_t ata_write(uint32_t drive, uint32_t lba, uint32_t count, const void* buf){
+    return ata_transfer(drive, lba, count, (uint8_t*)buf, 1);
+}
+
+/*
+ * ata_handler
+ *   DESCRIPTION: IRQ 14 handler
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Finishes the DMA transfer in flight and wakes its task.
+ *                 Ignores the interrupt if a polling transfer got there first.
+ */
+void ata_handler(void){
+    uint32_t status = inb(bm_base + BM_STATUS);
+
+    if(status & BM_SR_IRQ){
+        outb(status, bm_base + BM_STATUS);      // writing the IRQ and error bits back clears them
+        dma_status = status;
+        dma_done = 1;
+        sched_wake(&dma_wait);
+    }
+    inb(ATA_STATUS);                            // the drive drops its interrupt line
+    send_eoi(ATA_IRQ);
+}
+
+/*
+ * ata_dma_timeout
+ *   DESCRIPTION: Callback of dma_timer: the transfer's interrupt did not come
+ *   INPUTS: timer - dma_timer, its data the dma_seq of the transfer it was armed for
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wakes the task in ata_dma to give up, unless that transfer
+ *                 already finished (the callback ran late, after timer_cancel)
+ */
+static void ata_dma_timeout(ktimer_t* timer){
+    if((uint32_t)timer->data == dma_seq && !dma_done){
+        dma_timed_out = 1;
+        dma_done = 1;
+        sched_wake(&dma_wait);
+    }
+}
+
+/*
+ * ata_transfer
+ *   DESCRIPTION: ata_read and ata_write
+ *   INPUTS: drive, lba, count, buf - as they take them; write - 1 to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: Holds the channel for the whole transfer
+ */
+static int32_t ata_transfer(uint32_t drive, uint32_t lba, uint32_t count, uint8_t* buf, int write){
+    uint32_t chunk, addr;
+    int32_t ret = 0;
+
+    if(drive >= ATA_NUM_DRIVES || drive_sectors[drive] == 0 || buf == NULL){
+        return -1;
+    }
+    if(lba >= drive_sectors[drive] || count > drive_sectors[drive] - lba){
+        return -1;
+    }
+
+    sleep_lock(&channel_lock);
+    if(bm_base == 0){
+        ret = ata_pio(drive, lba, count, buf, write);
+        sleep_unlock(&channel_lock);
+        return ret;
+    }
+    while(count > 0 && ret == 0){
+        chunk = (count < ATA_DMA_SECTORS) ? count : ATA_DMA_SECTORS;
+        addr = (uint32_t)buf;
+        if((addr & (ATA_DMA_BYTES - 1)) == 0 && addr >= KERNEL_PAGE_START && addr < KERNEL_PAGE_END){
+            ret = ata_dma(drive, lba, chunk, addr, write);
+        } else {
+            if(write) memcpy(bounce, buf, chunk * ATA_SECTOR_SIZE);
+            ret = ata_dma(drive, lba, chunk, (uint32_t)bounce, write);
+            if(!write && ret == 0) memcpy(buf, bounce, chunk * ATA_SECTOR_SIZE);
+        }
+        lba += chunk;
+        count -= chunk;
+        buf += chunk * ATA_SECTOR_SIZE;
+    }
+    sleep_unlock(&channel_lock);
+    return ret;
+}
+
+/*
+ * ata_dma
+ *   DESCRIPTION: One bus-master DMA command
+ *   INPUTS: drive, lba - where, count - 1 to ATA_DMA_SECTORS
+ *           addr - physical address, not crossing a 64kB boundary
+ *           write - 1 for memory to disk
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a device or bus error, or a timeout
+ *   SIDE EFFECTS: Sleeps until IRQ 14 or for at most ATA_DMA_TIMEOUT_MS, or
+ *                 polls if there is no task to put to sleep yet (boot)
+ */
+static int32_t ata_dma(uint32_t drive, uint32_t lba, uint32_t count, uint32_t addr, int write){
+    uint32_t dir = write ? 0 : BM_CMD_READ;
+    uint32_t status, i;
+
+    prd.addr = addr;
+    prd.bytes = count * ATA_SECTOR_SIZE;
+    prd.flags = PRD_EOT;
+    outl((uint32_t)&prd, bm_base + BM_PRDT);
+    outb(dir, bm_base + BM_COMMAND);
+    outb(inb(bm_base + BM_STATUS) | BM_SR_IRQ | BM_SR_ERR, bm_base + BM_STATUS);
+    dma_done = 0;
+
+    ata_select(drive, lba, count);
+    outb(write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA, ATA_COMMAND);
+    outb(dir | BM_CMD_START, bm_base + BM_COMMAND);
+
+    if(this_cpu()->terminal != NULL){
+        // a lost interrupt must not keep channel_lock (and the file system above it) forever
+        dma_timed_out = 0;
+        dma_timer.func = ata_dma_timeout;
+        dma_timer.data = (void*)++dma_seq;
+        timer_add_after(&dma_timer, TIMER_MS_TO_TICKS(ATA_DMA_TIMEOUT_MS));
+        sched_wait(&dma_wait, &dma_done);
+        timer_cancel(&dma_timer);
+        if(dma_timed_out){
+            outb(dir, bm_base + BM_COMMAND);
+            return -1;
+        }
+    } else {
+        // the handler may still take it if interrupts are on
+        for(i = 0; !dma_done && !(inb(bm_base + BM_STATUS) & BM_SR_IRQ); i++){
+            if(i == ATA_TIMEOUT){
+                outb(dir, bm_base + BM_COMMAND);
+                return -1;
+            }
+        }
+        if(!dma_done){
+            status = inb(bm_base + BM_STATUS);
+            outb(status, bm_base + BM_STATUS);
+            dma_status = status;
+        }
+    }
+
+    outb(dir, bm_base + BM_COMMAND);
+    status = inb(ATA_STATUS);
+    if((dma_status & BM_SR_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF))){
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * ata_pio
+ *   DESCRIPTION: Move sectors through the data port, for a controller
+ *                without bus mastering
+ *   INPUTS: drive, lba, count, buf, write - as ata_transfer takes them
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a device error or timeout
+ *   SIDE EFFECTS: Polls; flushes the drive's cache after a write
+ */
+static int32_t ata_pio(uint32_t drive, uint32_t lba, uint32_t count, uint8_t* buf, int write){
+    uint32_t chunk, i, words;
+
+    while(count > 0){
+        chunk = (count < 256) ? count : 256;        // a count register of 0 means 256
+        ata_select(drive, lba, chunk & 0xFF);
+        outb(write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO, ATA_COMMAND);
+        for(i = 0; i < chunk; i++){
+            if(!(ata_wait(ATA_SR_DRQ) & ATA_SR_DRQ)){
+                return -1;
+            }
+            words = ATA_SECTOR_SIZE / 2;
+            if(write){
+                asm volatile ("rep outsw" : "+S"(buf), "+c"(words) : "d"(ATA_DATA) : "memory");
+            } else {
+                asm volatile ("rep insw" : "+D"(buf), "+c"(words) : "d"(ATA_DATA) : "memory");
+            }
+        }
+        lba += chunk;
+        count -= chunk;
+    }
+    if(write){
+        outb(ATA_CMD_FLUSH, ATA_COMMAND);
+        if(ata_wait(0) & (ATA_SR_ERR | ATA_SR_DF | ATA_SR_BSY)){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * ata_select
+ *   DESCRIPTION: Load the task file for a read or write command
+ *   INPUTS: drive, lba - where, count - sectors (0 for 256)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void ata_select(uint32_t drive, uint32_t lba, uint32_t count){
+    outb(ATA_DRIVE_LBA | (drive << 4) | ((lba >> 24) & 0x0F), ATA_DRIVE);
+    ata_wait(0);
+    outb(count, ATA_COUNT);
+    outb(lba & 0xFF, ATA_LBA_LO);
+    outb((lba >> 8) & 0xFF, ATA_LBA_MID);
+    outb((lba >> 16) & 0xFF, ATA_LBA_HI);
+}
+
+/*
+ * ata_wait
+ *   DESCRIPTION: Poll the status until the drive is not busy and, if asked,
+ *                has data ready
+ *   INPUTS: mask - ATA_SR_DRQ to wait for data as well, 0 for not busy only
+ *   OUTPUTS: none
+ *   RETURN VALUE: the last status read (BSY still set on a timeout)
+ *   SIDE EFFECTS: Stops early on an error
+ */
+static uint32_t ata_wait(uint32_t mask){
+    uint32_t status = 0, i;
+
+    // the alternate status needs 400ns to reflect a new command or drive
+    for(i = 0; i < 4; i++){
+        inb(ATA_CONTROL);
+    }
+    for(i = 0; i < ATA_TIMEOUT; i++){
+        status = inb(ATA_STATUS);
+        if(status & ATA_SR_BSY) continue;
+        if((status & (ATA_SR_ERR | ATA_SR_DF)) || (status & mask) == mask){
+            break;
+        }
+    }
+    return status;
+}
+
+/*
+ * ata_identify
+ *   DESCRIPTION: Ask a drive what it is
+ *   INPUTS: drive - ATA_MASTER or ATA_SLAVE
+ *   OUTPUTS: none
+ *   RETURN VALUE: its LBA28 sector count, 0 for no drive or a non-ATA one (ATAPI)
+ *   SIDE EFFECTS: none
+ */
+static uint32_t ata_identify(uint32_t drive){
+    uint16_t id[ATA_SECTOR_SIZE / 2];
+    uint32_t status, sectors;
+    int i;
+
+    outb(ATA_DRIVE_LBA | (drive << 4), ATA_DRIVE);
+    ata_wait(0);
+    outb(0, ATA_COUNT);
+    outb(0, ATA_LBA_LO);
+    outb(0, ATA_LBA_MID);
+    outb(0, ATA_LBA_HI);
+    outb(ATA_CMD_IDENTIFY, ATA_COMMAND);
+
+    status = inb(ATA_STATUS);
+    if(status == 0 || status == 0xFF){
+        return 0;                           // nothing there, or no channel at all
+    }
+    status = ata_wait(0);
+    if((status & ATA_SR_BSY) || inb(ATA_LBA_MID) != 0 || inb(ATA_LBA_HI) != 0){
+        return 0;                           // hung, or an ATAPI signature
+    }
+    status = ata_wait(ATA_SR_DRQ);
+    if(!(status & ATA_SR_DRQ)){
+        return 0;
+    }
+    for(i = 0; i < ATA_SECTOR_SIZE / 2; i++){
+        id[i] = inw(ATA_DATA);
+    }
+    sectors = id[ATA_ID_SECTORS_LO] | ((uint32_t)id[ATA_ID_SECTORS_HI] << 16);
+    return (sectors < ATA_LBA28_MAX) ? sectors : ATA_LBA28_MAX - 1;
+}
+
+/*
+ * pci_read, pci_write
+ *   DESCRIPTION: Configuration space access (mechanism #1)
+ *   INPUTS: bus, dev, func - the function, reg - dword-aligned register
+ *           value - what to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: the register (pci_read); 0xFFFFFFFF if there is no function
+ *   SIDE EFFECTS: none
+ */
+static uint32_t pci_read(uint32_t bus, uint32_t dev, uint32_t func, uint32_t reg){
+    outl(PCI_ENABLE | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xFC), PCI_CONFIG_ADDRESS);
+    return inl(PCI_CONFIG_DATA);
+}
+
+static void pci_write(uint32_t bus, uint32_t dev, uint32_t func, uint32_t reg, uint32_t value){
+    outl(PCI_ENABLE | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xFC), PCI_CONFIG_ADDRESS);
+    outl(value, PCI_CONFIG_DATA);
+}
@@ -0,0 +1,66 @@
+/* ata.h - IDE/ATA disks on the primary channel
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+
+/* The two drives on the primary IDE channel, found with IDENTIFY at boot.
+ * Transfers use bus-master DMA when the PCI scan finds the IDE controller,
+ * and PIO otherwise. A DMA transfer sleeps until IRQ 14 reports it done;
+ * before the scheduler starts (file_system_init) it polls instead. One
+ * transfer runs on the channel at a time. DMA goes straight to a buffer in
+ * the kernel page when it is 4kB aligned, through a bounce buffer if not. */
+
+#define ATA_IRQ                 14
+#define ATA_SECTOR_SIZE         512
+#define ATA_NUM_DRIVES          2           // master and slave
+#define ATA_MASTER              0
+#define ATA_SLAVE               1
+
+/*
+ * ata_init
+ *   DESCRIPTION: Find the drives and the bus-master registers
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of ATA drives found
+ *   SIDE EFFECTS: Enables PCI bus mastering on the IDE controller and IRQ 14
+ */
+int32_t ata_init(void);
+
+/*
+ * ata_sectors
+ *   DESCRIPTION: Size of a drive
+ *   INPUTS: drive - ATA_MASTER or ATA_SLAVE
+ *   OUTPUTS: none
+ *   RETURN VALUE: its LBA28 sector count, 0 if there is no such drive
+ *   SIDE EFFECTS: none
+ */
+uint32_t ata_sectors(uint32_t drive);
+
+/*
+ * ata_read, ata_write
+ *   DESCRIPTION: Move whole sectors between a drive and memory
+ *   INPUTS: drive - ATA_MASTER or ATA_SLAVE, lba - first sector
+ *           count - sectors, buf - kernel memory of count * ATA_SECTOR_SIZE bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 for no drive, sectors past its end, or a
+ *                 device error or timeout
+ *   SIDE EFFECTS: May sleep (not from interrupt context)
+ */
+int32_t ata_read(uint32_t drive, uint32_t lba, uint32_t count, void* buf);
+int32_t ata_write(uint32_t drive, uint32_t lba, uint32_t count, const void* buf);
+
+/*
+ * ata_handler
+ *   DESCRIPTION: IRQ 14 handler (asm_linkage.S)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Finishes the DMA transfer in flight and wakes its task
+ */
+void ata_handler(void);
+
+#endif /* _ATA_H */
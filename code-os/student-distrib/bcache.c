@@ -0,0 +1,238 @@
+/* bcache.c - Block buffer cache in front of the ATA disks
+ * vim:ts=4 noexpandtab
+ */
+
+#include "bcache.h"
+#include "ata.h"
+#include "lib.h"
+#include "sched.h"
+
+#define BCACHE_SECTORS          (BCACHE_BLOCK_SIZE / ATA_SECTOR_SIZE)
+#define BCACHE_HASH(drive, block)   (((block) ^ ((drive) << 5)) & (BCACHE_HASH_SIZE - 1))
+
+typedef struct bcache_buf {
+    uint32_t drive;
+    uint32_t block;
+    uint32_t valid;                         // holds the block's data and is in the hash table
+    uint8_t* data;
+    struct bcache_buf* hash_next;
+    struct bcache_buf* lru_prev;            // toward the most recently used
+    struct bcache_buf* lru_next;            // toward the least recently used
+} bcache_buf_t;
+
+bcache_stats_t bcache_stats;
+
+// 4kB aligned, so the disk DMAs straight into them
+static uint8_t bcache_data[BCACHE_BLOCKS][BCACHE_BLOCK_SIZE] __attribute__((aligned(BCACHE_BLOCK_SIZE)));
+static bcache_buf_t bcache_bufs[BCACHE_BLOCKS];
+static bcache_buf_t* bcache_hash[BCACHE_HASH_SIZE];
+static bcache_buf_t bcache_lru;            // list head: lru_next is the most recent, lru_prev the least
+static sleep_lock_t bcache_lock = SLEEP_LOCK_INIT;
+
+static bcache_buf_t* bcache_lookup(uint32_t drive, uint32_t block);
+static bcache_buf_t* bcache_fill(uint32_t drive, uint32_t block, int read);
+static void bcache_touch(bcache_buf_t* buf);
+static void bcache_drop(bcache_buf_t* buf);
+
+/*
+ * bcache_init
+ *   DESCRIPTION: Start with every buffer empty
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void bcache_init(void){
+    int i;
+
+    bcache_lru.lru_next = bcache_lru.lru_prev = &bcache_lru;
+    for(i = 0; i < BCACHE_BLOCKS; i++){
+        bcache_bufs[i].data = bcache_data[i];
+        bcache_bufs[i].lru_prev = &bcache_lru;
+        bcache_bufs[i].lru_next = bcache_lru.lru_next;
+        bcache_lru.lru_next->lru_prev = &bcache_bufs[i];
+        bcache_lru.lru_next = &bcache_bufs[i];
+    }
+}
+
+/*
+ * bcache_read
+ *   DESCRIPTION: Copy part of a disk block out, through the cache
+ *   INPUTS: drive - ATA drive, block - its 4kB block, offset - byte in it to start at
+ *           buf - where to copy to, length - bytes (offset + length at most a block)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on a hit, 1 on a miss (read from the disk), -1 on a disk error
+ *   SIDE EFFECTS: May sleep; may evict the least recently used block
+ */
+int32_t bcache_read(uint32_t drive, uint32_t block, uint32_t offset, void* buf, uint32_t length){
+    bcache_buf_t* cached;
+    int32_t ret = 0;
+
+    sleep_lock(&bcache_lock);
+    cached = bcache_lookup(drive, block);
+    if(cached != NULL){
+        bcache_stats.hits++;
+    } else {
+        bcache_stats.misses++;
+        cached = bcache_fill(drive, block, 1);
+        ret = 1;
+    }
+    if(cached == NULL){
+        sleep_unlock(&bcache_lock);
+        return -1;
+    }
+    bcache_touch(cached);
+    memcpy(buf, cached->data + offset, length);
+    sleep_unlock(&bcache_lock);
+    return ret;
+}
+
+/*
+ * bcache_write
+ *   DESCRIPTION: Copy into part of a disk block, through the cache to the disk
+ *   INPUTS: drive - ATA drive, block - its 4kB block, offset - byte in it to start at
+ *           buf - what to copy, NULL for zeros, length - bytes (offset + length at most a block)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a disk error (the block is dropped from the cache)
+ *   SIDE EFFECTS: May sleep; reads the rest of an uncached block first unless all of it is written
+ */
+int32_t bcache_write(uint32_t drive, uint32_t block, uint32_t offset, const void* buf, uint32_t length){
+    bcache_buf_t* cached;
+
+    sleep_lock(&bcache_lock);
+    bcache_stats.writes++;
+    cached = bcache_lookup(drive, block);
+    if(cached == NULL){
+        cached = bcache_fill(drive, block, length != BCACHE_BLOCK_SIZE);
+    }
+    if(cached == NULL){
+        sleep_unlock(&bcache_lock);
+        return -1;
+    }
+    if(buf == NULL){
+        memset(cached->data + offset, 0, length);
+    } else {
+        memcpy(cached->data + offset, buf, length);
+    }
+    if(ata_write(drive, block * BCACHE_SECTORS, BCACHE_SECTORS, cached->data) == -1){
+        bcache_drop(cached);                // no telling what the disk has now
+        sleep_unlock(&bcache_lock);
+        return -1;
+    }
+    bcache_touch(cached);
+    sleep_unlock(&bcache_lock);
+    return 0;
+}
+
+/*
+ * bcache_readahead
+ *   DESCRIPTION: Bring blocks that will be read soon into the cache
+ *   INPUTS: drive - ATA drive, blocks - their numbers, count - how many (up to BCACHE_READAHEAD)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: May sleep. Skips blocks already cached and stops at a disk error.
+ */
+void bcache_readahead(uint32_t drive, const uint32_t* blocks, uint32_t count){
+    bcache_buf_t* cached;
+    uint32_t i;
+
+    if(count > BCACHE_READAHEAD){
+        count = BCACHE_READAHEAD;
+    }
+    sleep_lock(&bcache_lock);
+    for(i = 0; i < count; i++){
+        if(bcache_lookup(drive, blocks[i]) != NULL) continue;
+        cached = bcache_fill(drive, blocks[i], 1);
+        if(cached == NULL) break;
+        bcache_touch(cached);
+        bcache_stats.readahead++;
+    }
+    sleep_unlock(&bcache_lock);
+}
+
+/*
+ * bcache_lookup
+ *   DESCRIPTION: Find a cached block (bcache_lock held)
+ *   INPUTS: drive, block - which
+ *   OUTPUTS: none
+ *   RETURN VALUE: its buffer, NULL if it is not cached
+ *   SIDE EFFECTS: none
+ */
+static bcache_buf_t* bcache_lookup(uint32_t drive, uint32_t block){
+    bcache_buf_t* buf;
+
+    for(buf = bcache_hash[BCACHE_HASH(drive, block)]; buf != NULL; buf = buf->hash_next){
+        if(buf->drive == drive && buf->block == block){
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * bcache_fill
+ *   DESCRIPTION: Give an uncached block the least recently used buffer (bcache_lock held)
+ *   INPUTS: drive, block - which, read - 1 to read its data from the disk,
+ *           0 if the caller is about to overwrite all of it
+ *   OUTPUTS: none
+ *   RETURN VALUE: the buffer, in the hash table; NULL on a disk error
+ *   SIDE EFFECTS: Evicts whatever the buffer held
+ */
+static bcache_buf_t* bcache_fill(uint32_t drive, uint32_t block, int read){
+    bcache_buf_t* buf = bcache_lru.lru_prev;
+    uint32_t bucket = BCACHE_HASH(drive, block);
+
+    bcache_drop(buf);
+    if(read && ata_read(drive, block * BCACHE_SECTORS, BCACHE_SECTORS, buf->data) == -1){
+        return NULL;
+    }
+    buf->drive = drive;
+    buf->block = block;
+    buf->valid = 1;
+    buf->hash_next = bcache_hash[bucket];
+    bcache_hash[bucket] = buf;
+    bcache_stats.cached++;
+    return buf;
+}
+
+/*
+ * bcache_touch
+ *   DESCRIPTION: Make a buffer the most recently used (bcache_lock held)
+ *   INPUTS: buf - the buffer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void bcache_touch(bcache_buf_t* buf){
+    buf->lru_prev->lru_next = buf->lru_next;
+    buf->lru_next->lru_prev = buf->lru_prev;
+    buf->lru_prev = &bcache_lru;
+    buf->lru_next = bcache_lru.lru_next;
+    bcache_lru.lru_next->lru_prev = buf;
+    bcache_lru.lru_next = buf;
+}
+
+/*
+ * bcache_drop
+ *   DESCRIPTION: Forget what a buffer holds (bcache_lock held)
+ *   INPUTS: buf - the buffer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Takes it out of the hash table and makes it the first to be reused
+ */
+static void bcache_drop(bcache_buf_t* buf){
+    bcache_buf_t** link;
+
+    if(buf->valid){
+        for(link = &bcache_hash[BCACHE_HASH(buf->drive, buf->block)]; *link != buf; link = &(*link)->hash_next);
+        *link = buf->hash_next;
+        buf->valid = 0;
+        bcache_stats.cached--;
+    }
+    buf->lru_prev->lru_next = buf->lru_next;
+    buf->lru_next->lru_prev = buf->lru_prev;
+    buf->lru_next = &bcache_lru;
+    buf->lru_prev = bcache_lru.lru_prev;
+    bcache_lru.lru_prev->lru_next = buf;
+    bcache_lru.lru_prev = buf;
+}
@@ -0,0 +1,77 @@
+/* bcache.h - Block buffer cache in front of the ATA disks
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+#include "types.h"
+
+/* BCACHE_BLOCKS 4kB blocks of disk data, found by drive and block number
+ * (the disk's 4kB blocks counted from LBA 0) through a hash table and
+ * evicted least recently used first. Writes go through to the disk before
+ * they return, so a cached block never differs from the disk and eviction
+ * never writes. The file system asks for readahead when it reads a file
+ * sequentially; there is no kernel worker to do it in the background, so
+ * the blocks are read then and there, in the same pass as the miss that
+ * asked for them. One lock covers the cache and is held across the disk
+ * I/O (the IDE channel takes one transfer at a time anyway). */
+
+#define BCACHE_BLOCKS           64          // 256kB
+#define BCACHE_BLOCK_SIZE       4096
+#define BCACHE_HASH_SIZE        64          // a power of 2
+#define BCACHE_READAHEAD        8           // most blocks read ahead of a sequential miss
+
+typedef struct bcache_stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead;                     // blocks read ahead of being asked for
+    uint32_t writes;
+    uint32_t cached;                        // blocks holding disk data
+} bcache_stats_t;
+
+extern bcache_stats_t bcache_stats;        // shown in proc/bcache
+
+/*
+ * bcache_init
+ *   DESCRIPTION: Start with every buffer empty
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void bcache_init(void);
+
+/*
+ * bcache_read
+ *   DESCRIPTION: Copy part of a disk block out, through the cache
+ *   INPUTS: drive - ATA drive, block - its 4kB block, offset - byte in it to start at
+ *           buf - where to copy to, length - bytes (offset + length at most a block)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on a hit, 1 on a miss (read from the disk), -1 on a disk error
+ *   SIDE EFFECTS: May sleep; may evict the least recently used block
+ */
+int32_t bcache_read(uint32_t drive, uint32_t block, uint32_t offset, void* buf, uint32_t length);
+
+/*
+ * bcache_write
+ *   DESCRIPTION: Copy into part of a disk block, through the cache to the disk
+ *   INPUTS: drive - ATA drive, block - its 4kB block, offset - byte in it to start at
+ *           buf - what to copy, NULL for zeros, length - bytes (offset + length at most a block)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a disk error (the block is dropped from the cache)
+ *   SIDE EFFECTS: May sleep; reads the rest of an uncached block first unless all of it is written
+ */
+int32_t bcache_write(uint32_t drive, uint32_t block, uint32_t offset, const void* buf, uint32_t length);
+
+/*
+ * bcache_readahead
+ *   DESCRIPTION: Bring blocks that will be read soon into the cache
+ *   INPUTS: drive - ATA drive, blocks - their numbers, count - how many (up to BCACHE_READAHEAD)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: May sleep. Skips blocks already cached and stops at a disk error.
+ */
+void bcache_readahead(uint32_t drive, const uint32_t* blocks, uint32_t count);
+
+#endif /* _BCACHE_H */
@@ -2,8 +2,11 @@
 #include "x86_desc.h"
 #include "lib.h"
 #include "exception_handler.h"
+#include "trace.h"
+#include "signal.h"
+#include "terminal.h"
 
-/* File that includes all "handlers" for exceptions (prints information) */
+/* Common C handler for the exceptions: signals for user programs, prints information for the kernel */
 
 // Array that stores exception vector numbers and name of exception in order based on table 5.1 of IA-32 reference manual
 static char* exceptionNames[] = {
@@ -31,271 +34,124 @@ static char* exceptionNames[] = {
     "Vector No. 21: System Call Hold"
 };
 
-/* 
- * divide_error_exception
- *   DESCRIPTION: Prints prompt that divide error exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints divide error exception to the screen and freeze by using while loop
- */
-void divide_error_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x00]);
-    while(1);
-}
-
-/* 
- * debug_exception
- *   DESCRIPTION: Prints prompt that debug exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints debug exception to the screen and freeze by using while loop
- */
-void debug_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x01]);
-    while(1);
-}
-
-/* 
- * nmi_interrupt
- *   DESCRIPTION: Prints prompt that non-maskable interrupt was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints nmi interrupt to the screen and freeze by using while loop
- */
-void nmi_interrupt(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x02]);
-    while(1);
-}
-
-/* 
- * breakpoint_exception
- *   DESCRIPTION: Prints prompt that breakpoint exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints breakpoint exception to the screen and freeze by using while loop
- */
-void breakpoint_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x03]);
-    while(1);
+#define EXCEPTION_DE       0x00
+#define EXCEPTION_NMI      0x02
+#define EXCEPTION_DF       0x08
+#define EXCEPTION_PF       0x0E
+#define EXCEPTION_MF       0x10
+#define EXCEPTION_MC       0x12
+#define EXCEPTION_XM       0x13
+
+#define EFLAGS_IF          0x200
+#define DUMP_STACK_WORDS   16          // words of the faulting stack exception_dump shows
+#define DUMP_WORDS_PER_LINE 4
+
+/* 
+ * exception_signal
+ *   DESCRIPTION: Signal a user program gets for an exception it caused
+ *   INPUTS: vector - exception vector
+ *   OUTPUTS: none
+ *   RETURN VALUE: SIG_DIV_ZERO or SIG_SEGFAULT, -1 if the program is not to blame
+ *   SIDE EFFECTS: none
+ */
+static int32_t exception_signal(uint32_t vector){
+    switch(vector){
+        case EXCEPTION_DE:
+        case EXCEPTION_MF:
+        case EXCEPTION_XM:
+            return SIG_DIV_ZERO;
+        case EXCEPTION_NMI:
+        case EXCEPTION_DF:
+        case EXCEPTION_MC:
+            return -1;
+        default:
+            return SIG_SEGFAULT;
+    }
+}
+
+/* 
+ * exception_dump
+ *   DESCRIPTION: Print the context of an exception taken in the kernel
+ *   INPUTS: f - registers and frame saved by the entry stub
+ *   OUTPUTS: register and stack dump on the screen
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void exception_dump(exception_frame_t* f){
+    uint32_t* stack;
+    uint32_t cr2;
+    int i;
+
+    // no privilege change, so the interrupted stack continues right above eflags
+    stack = &f->frame.esp;
+    asm volatile ("movl %%cr2, %0" : "=r"(cr2));
+
+    printf("Exception\n");
+    printf("%s (error %#x) on CPU %u, pid %u\n", exceptionNames[f->vector], f->error_code,
+           this_cpu()->index, cur_pid);
+    printf("eip %#x  cs %#x  eflags %#x  cr2 %#x\n", f->frame.eip, f->frame.cs, f->frame.eflags, cr2);
+    printf("eax %#x  ebx %#x  ecx %#x  edx %#x\n", f->regs.eax, f->regs.ebx, f->regs.ecx, f->regs.edx);
+    printf("esi %#x  edi %#x  ebp %#x  esp %#x\n", f->regs.esi, f->regs.edi, f->regs.ebp, (uint32_t)stack);
+    for(i = 0; i < DUMP_STACK_WORDS; i++){
+        if(i % DUMP_WORDS_PER_LINE == 0){
+            printf("%#x:", (uint32_t)&stack[i]);
+        }
+        printf(" %#x", stack[i]);
+        if(i % DUMP_WORDS_PER_LINE == DUMP_WORDS_PER_LINE - 1){
+            printf("\n");
+        }
+    }
+}
+
+/* 
+ * exception_handler
+ *   DESCRIPTION: Common handler for the processor exceptions
+ *   INPUTS: f - registers and frame saved by the entry stub
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: At CPL 3, raises SIG_DIV_ZERO or SIG_SEGFAULT for the current
+ *                 process and delivers it. In the kernel, dumps the registers,
+ *                 then halts the process the kernel was working for with
+ *                 status 256, or stops this CPU if there is none to blame
+ *                 or the fault came with a sleep lock held.
+ */
+void exception_handler(exception_frame_t* f){
+    terminal_struct* term;
+
+    int32_t signum;
+    pcb_struct* pcb;
+
+    if(f->vector == EXCEPTION_PF){
+        uint32_t fault_addr;
+        asm volatile ("movl %%cr2, %0" : "=r"(fault_addr));
+        TRACE(TRACE_PAGE_FAULT, fault_addr, f->error_code);
+    }
+
+    signum = exception_signal(f->vector);
+    if(IRQ_FROM_USER(&f->frame) && signum >= 0){
+        pcb = get_pcb_ptr();
+        // the handler itself faulted: returning would only fault again
+        if(pcb->sig_masked){
+            process_halt(SIG_KILL_STATUS);
+        }
+        signal_send(pcb, signum);
+        signal_deliver(&f->regs, &f->frame, f->vector, f->error_code);
+        return;
+    }
+
+    exception_dump(f);
+
+    // a system call went wrong (a bad user pointer, say). With interrupts on
+    // it holds no spinlock, so the process can go and the CPU carry on,
+    // unless it holds a sleep lock (fs_lock, say) nobody else could then take.
+    term = this_cpu()->terminal;
+    if(signum >= 0 && (f->frame.eflags & EFLAGS_IF) && term != NULL && term->number_of_processes > 0
+       && term->sleep_locks == 0){
+        printf("killing pid %u\n", cur_pid);
+        process_halt(SIG_KILL_STATUS);
+    }
+    printf("CPU %u stopped\n", this_cpu()->index);
+    while(1){
+        asm volatile ("cli; hlt");
+    }
 }
-
-/* 
- * overflow_exception
- *   DESCRIPTION: Prints prompt that overflow exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints overflow exception to the screen and freeze by using while loop
- */
-void overflow_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x04]);
-    while(1);
-}
-
-/* 
- * bound_range_exceed_exception
- *   DESCRIPTION: Prints prompt that bound range exceeded exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints bound range exceeded exception to the screen and freeze by using while loop
- */
-void bound_range_exceed_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x05]);
-    while(1);
-}
-
-/* 
- * invalid_opcode_exception
- *   DESCRIPTION: Prints prompt that invalid opcode exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints invalid opcode exception to the screen and freeze by using while loop
- */
-void invalid_opcode_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x06]);
-    while(1);
-}
-
-/* 
- * device_not_available_exception
- *   DESCRIPTION: Prints prompt that device not available exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints device not available exception to the screen and freeze by using while loop
- */
-void device_not_available_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x07]);
-    while(1);
-}
-
-/* 
- * double_fault_exception
- *   DESCRIPTION: Prints prompt that double fault exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints double fault exception to the screen and freeze by using while loop
- */
-void double_fault_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x08]);
-    while(1);
-}
-
-/* 
- * coprocessor_segment_overrun
- *   DESCRIPTION: Prints prompt that coprocessor segment overrun exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints coprocessor segment overrun exception to the screen and freeze by using while loop
- */
-void coprocessor_segment_overrun(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x09]);
-    while(1);
-}
-
-/* 
- * invalid_TSS_exception
- *   DESCRIPTION: Prints prompt that invalid TSS exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints invalid TSS exception to the screen and freeze by using while loop
- */
-void invalid_TSS_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x0A]);
-    while(1);
-}
-
-/* 
- * segment_not_present
- *   DESCRIPTION: Prints prompt that segment not present exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints segment not present exception to the screen and freeze by using while loop
- */
-void segment_not_present(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x0B]);
-    while(1);
-}
-
-/* 
- * stack_fault_exception
- *   DESCRIPTION: Prints prompt that stack fault exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints stack fault exception to the screen and freeze by using while loop
- */
-void stack_fault_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x0C]);
-    while(1);
-}
-
-/* 
- * general_protection_fault
- *   DESCRIPTION: Prints prompt that general protection fault was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints general protection fault to the screen and freeze by using while loop
- */
-void general_protection_fault(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x0D]);
-    while(1);
-}
-
-/* 
- * page_fault_exception
- *   DESCRIPTION: Prints prompt that page fault exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints page fault exception to the screen and freeze by using while loop
- */
-void page_fault_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x0E]);
-    while(1);
-}
-
-/* Skip exception vector number 15 (Intel Reserved) */
-
-/* 
- * FPU_floating_point_error
- *   DESCRIPTION: Prints prompt that FPU floating point error exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints FPU floating point error exception to the screen and freeze by using while loop
- */
-void FPU_floating_point_error(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x10]);
-    while(1);
-}
-
-/* 
- * alignment_check_exception
- *   DESCRIPTION: Prints prompt that alignment check exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints alignment check exception to the screen and freeze by using while loop
- */
-void alignment_check_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x11]);
-    while(1);
-}
-
-/* 
- * machine_check_exception
- *   DESCRIPTION: Prints prompt that machine check exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints machine check exception to the screen and freeze by using while loop
- */
-void machine_check_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x12]);
-    while(1);
-}
-
-/* 
- * SIMD_floating_point_exception
- *   DESCRIPTION: Prints prompt that SIMD floating point exception was raised
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: Prints SIMD floating point exception to the screen and freeze by using while loop
- */
-void SIMD_floating_point_exception(void){
-    printf("Exception\n");
-    printf("%s\n", exceptionNames[0x13]);
-    while(1);
-}
-
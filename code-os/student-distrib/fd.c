@@ -0,0 +1,360 @@
+/* fd.c - Per-process file descriptor tables and the open files they share
+ * vim:ts=4 noexpandtab
+ */
+
+#include "fd.h"
+#include "lib.h"
+
+#define FD_WORD(fd)             ((fd) >> 5)
+#define FD_BIT(fd)              (1U << ((fd) & 31))
+#define FD_CHUNK_INDEX(fd)      (((fd) - NUM_FILE_DES) / FD_CHUNK)
+#define FD_CHUNK_MASK           ((1U << FD_CHUNK) - 1)
+
+static file_array_struct open_files[OPEN_FILE_MAX];
+static spinlock_t open_file_lock = SPINLOCK_INIT;   // slot allocation and refcounts
+
+static file_array_struct* fd_pool[FD_POOL_CHUNKS][FD_CHUNK];
+static uint32_t fd_pool_used;               // bit per chunk handed out
+static spinlock_t fd_pool_lock = SPINLOCK_INIT;
+
+static file_array_struct** fd_slot(pcb_struct* pcb, int32_t fd);
+static void fd_unmap(pcb_struct* pcb, int32_t fd);
+static int32_t file_put_unless_last(file_array_struct* file);
+
+/*
+ * first_zero
+ *   DESCRIPTION: Lowest clear bit of a word
+ *   INPUTS: word - not all ones
+ *   OUTPUTS: none
+ *   RETURN VALUE: its index
+ *   SIDE EFFECTS: none
+ */
+static inline uint32_t first_zero(uint32_t word){
+    uint32_t bit;
+    asm ("bsfl %1, %0" : "=r"(bit) : "rm"(~word));
+    return bit;
+}
+
+/*
+ * file_alloc
+ *   DESCRIPTION: Make a new open file
+ *   INPUTS: fileop - its driver, inode - handed to the driver
+ *   OUTPUTS: none
+ *   RETURN VALUE: the file with one reference and position 0, NULL if the table is full
+ *   SIDE EFFECTS: none
+ */
+file_array_struct* file_alloc(fileop_table_t* fileop, uint32_t inode){
+    file_array_struct* file;
+    uint32_t flags;
+    int i;
+
+    spin_lock_irqsave(&open_file_lock, flags);
+    for(i = 0; i < OPEN_FILE_MAX; i++){
+        file = &open_files[i];
+        if(file->refcount == 0){
+            file->refcount = 1;
+            file->fileop_ptr = fileop;
+            file->inode_number = inode;
+            file->file_position = 0;
+            file->flags = 0;
+            file->readahead = 0;
+            spin_unlock_irqrestore(&open_file_lock, flags);
+            return file;
+        }
+    }
+    spin_unlock_irqrestore(&open_file_lock, flags);
+    return NULL;
+}
+
+/*
+ * file_get
+ *   DESCRIPTION: Take another reference to an open file
+ *   INPUTS: file - the file
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void file_get(file_array_struct* file){
+    uint32_t flags;
+
+    spin_lock_irqsave(&open_file_lock, flags);
+    file->refcount++;
+    spin_unlock_irqrestore(&open_file_lock, flags);
+}
+
+/*
+ * file_put
+ *   DESCRIPTION: Drop a reference to an open file
+ *   INPUTS: file - the file
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The last one frees the slot (without the driver's close)
+ */
+void file_put(file_array_struct* file){
+    uint32_t flags;
+
+    spin_lock_irqsave(&open_file_lock, flags);
+    file->refcount--;
+    spin_unlock_irqrestore(&open_file_lock, flags);
+}
+
+/*
+ * file_put_unless_last
+ *   DESCRIPTION: Drop a reference to an open file unless it is the last one
+ *   INPUTS: file - the file
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it is the last (still held, for the caller to close
+ *                 the file and then file_put), 0 if it was dropped
+ *   SIDE EFFECTS: Decided under the lock, so of two descriptors closed at
+ *                 once exactly one sees the last reference
+ */
+static int32_t file_put_unless_last(file_array_struct* file){
+    int32_t last;
+    uint32_t flags;
+
+    spin_lock_irqsave(&open_file_lock, flags);
+    last = (file->refcount == 1);
+    if(!last){
+        file->refcount--;
+    }
+    spin_unlock_irqrestore(&open_file_lock, flags);
+    return last;
+}
+
+/*
+ * file_is_open
+ *   DESCRIPTION: Tell whether any process has a file open
+ *   INPUTS: fileop - its driver, inode - its inode
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if an open file refers to it, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int32_t file_is_open(fileop_table_t* fileop, uint32_t inode){
+    file_array_struct* file;
+    uint32_t flags;
+    int i;
+
+    spin_lock_irqsave(&open_file_lock, flags);
+    for(i = 0; i < OPEN_FILE_MAX; i++){
+        file = &open_files[i];
+        if(file->refcount != 0 && file->fileop_ptr == fileop && file->inode_number == inode){
+            spin_unlock_irqrestore(&open_file_lock, flags);
+            return 1;
+        }
+    }
+    spin_unlock_irqrestore(&open_file_lock, flags);
+    return 0;
+}
+
+/*
+ * fd_init
+ *   DESCRIPTION: Empty a new process's descriptor table
+ *   INPUTS: pcb - the process, limit - its fd_limit
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void fd_init(pcb_struct* pcb, uint32_t limit){
+    int i;
+
+    for(i = 0; i < NUM_FILE_DES; i++){
+        pcb->file_array[i] = NULL;
+    }
+    for(i = 0; i < FD_CHUNKS_PER_PROC; i++){
+        pcb->fd_chunk[i] = NULL;
+    }
+    for(i = 0; i < FD_MAX / 32; i++){
+        pcb->fd_used[i] = 0;
+    }
+    pcb->fd_limit = limit;
+}
+
+/*
+ * fd_inherit
+ *   DESCRIPTION: Give a new process the descriptors of its parent
+ *   INPUTS: child - the new process (after fd_init), parent - its parent
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Each one refers to the parent's open file. Any that do not
+ *                 fit under the child's limit or in the pool are left out.
+ */
+void fd_inherit(pcb_struct* child, pcb_struct* parent){
+    file_array_struct* file;
+    int32_t fd;
+
+    for(fd = fd_next_open(parent, 0); fd != -1; fd = fd_next_open(parent, fd + 1)){
+        file = fd_get(parent, fd);
+        file_get(file);
+        if(fd_install(child, fd, file) == -1){
+            file_put(file);                 // the parent still has it open
+        }
+    }
+}
+
+/*
+ * fd_get
+ *   DESCRIPTION: Look up an open descriptor
+ *   INPUTS: pcb - the process, fd - descriptor
+ *   OUTPUTS: none
+ *   RETURN VALUE: its open file, NULL if fd is out of range or not open
+ *   SIDE EFFECTS: none
+ */
+file_array_struct* fd_get(pcb_struct* pcb, int32_t fd){
+    if(fd < 0 || fd >= FD_MAX || !(pcb->fd_used[FD_WORD(fd)] & FD_BIT(fd))){
+        return NULL;
+    }
+    return *fd_slot(pcb, fd);
+}
+
+/*
+ * fd_install
+ *   DESCRIPTION: Point a free descriptor at an open file
+ *   INPUTS: pcb - the process, fd - the descriptor, -1 for the lowest free one
+ *           file - the file; the descriptor takes over the caller's reference
+ *   OUTPUTS: none
+ *   RETURN VALUE: the descriptor, -1 if it is taken, at or past the process's
+ *                 limit, or the pool is empty (the reference stays the caller's)
+ *   SIDE EFFECTS: Takes a chunk from the pool for the first descriptor in its range
+ */
+int32_t fd_install(pcb_struct* pcb, int32_t fd, file_array_struct* file){
+    uint32_t chunk, flags;
+    int i;
+
+    if(fd == -1){
+        for(i = 0; i < FD_MAX / 32; i++){
+            if(pcb->fd_used[i] != 0xFFFFFFFF){
+                fd = i * 32 + first_zero(pcb->fd_used[i]);
+                break;
+            }
+        }
+    } else if(fd >= 0 && fd < FD_MAX && (pcb->fd_used[FD_WORD(fd)] & FD_BIT(fd))){
+        return -1;
+    }
+    if(fd < 0 || fd >= (int32_t)pcb->fd_limit){
+        return -1;
+    }
+
+    if(fd >= NUM_FILE_DES && pcb->fd_chunk[FD_CHUNK_INDEX(fd)] == NULL){
+        spin_lock_irqsave(&fd_pool_lock, flags);
+        if(fd_pool_used == 0xFFFFFFFF){
+            spin_unlock_irqrestore(&fd_pool_lock, flags);
+            return -1;
+        }
+        chunk = first_zero(fd_pool_used);
+        fd_pool_used |= 1U << chunk;
+        spin_unlock_irqrestore(&fd_pool_lock, flags);
+        pcb->fd_chunk[FD_CHUNK_INDEX(fd)] = fd_pool[chunk];
+    }
+
+    *fd_slot(pcb, fd) = file;
+    pcb->fd_used[FD_WORD(fd)] |= FD_BIT(fd);
+    return fd;
+}
+
+/*
+ * fd_close
+ *   DESCRIPTION: Close a descriptor
+ *   INPUTS: pcb - the process, fd - descriptor
+ *   OUTPUTS: none
+ *   RETURN VALUE: what the driver's close returned (0 if other descriptors
+ *                 keep the file open), -1 if fd is not open
+ *   SIDE EFFECTS: Gives an emptied chunk back to the pool
+ */
+int32_t fd_close(pcb_struct* pcb, int32_t fd){
+    file_array_struct* file = fd_get(pcb, fd);
+    int32_t ret = 0;
+    int32_t last;
+
+    if(file == NULL){
+        return -1;
+    }
+    // the driver still finds the file through fd while it closes it
+    last = file_put_unless_last(file);
+    if(last){
+        ret = file->fileop_ptr->close(fd);
+    }
+    fd_unmap(pcb, fd);
+    if(last){
+        file_put(file);
+    }
+    return ret;
+}
+
+/*
+ * fd_next_open
+ *   DESCRIPTION: Walk the open descriptors
+ *   INPUTS: pcb - the process, fd - where to start looking
+ *   OUTPUTS: none
+ *   RETURN VALUE: lowest open descriptor >= fd, -1 if there is none
+ *   SIDE EFFECTS: none
+ */
+int32_t fd_next_open(pcb_struct* pcb, int32_t fd){
+    for(; fd < FD_MAX; fd++){
+        if(pcb->fd_used[FD_WORD(fd)] & FD_BIT(fd)){
+            return fd;
+        }
+    }
+    return -1;
+}
+
+/*
+ * fd_set_limit
+ *   DESCRIPTION: Change how many descriptors a process may have
+ *   INPUTS: pcb - the process, limit - NUM_FILE_DES to FD_MAX
+ *   OUTPUTS: none
+ *   RETURN VALUE: the old limit, -1 if out of range or below an open descriptor
+ *   SIDE EFFECTS: none
+ */
+int32_t fd_set_limit(pcb_struct* pcb, int32_t limit){
+    int32_t old = pcb->fd_limit;
+
+    if(limit < NUM_FILE_DES || limit > FD_MAX || fd_next_open(pcb, limit) != -1){
+        return -1;
+    }
+    pcb->fd_limit = limit;
+    return old;
+}
+
+/*
+ * fd_slot
+ *   DESCRIPTION: Where a descriptor's file pointer is kept
+ *   INPUTS: pcb - the process, fd - descriptor whose chunk (if any) is present
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to the entry
+ *   SIDE EFFECTS: none
+ */
+static file_array_struct** fd_slot(pcb_struct* pcb, int32_t fd){
+    if(fd < NUM_FILE_DES){
+        return &pcb->file_array[fd];
+    }
+    return &pcb->fd_chunk[FD_CHUNK_INDEX(fd)][(fd - NUM_FILE_DES) % FD_CHUNK];
+}
+
+/*
+ * fd_unmap
+ *   DESCRIPTION: Mark a descriptor free
+ *   INPUTS: pcb - the process, fd - an open descriptor
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Gives an emptied chunk back to the pool
+ */
+static void fd_unmap(pcb_struct* pcb, int32_t fd){
+    uint32_t chunk, first, flags;
+
+    *fd_slot(pcb, fd) = NULL;
+    pcb->fd_used[FD_WORD(fd)] &= ~FD_BIT(fd);
+    if(fd < NUM_FILE_DES){
+        return;
+    }
+
+    // FD_CHUNK divides 32, so a chunk's bits never straddle two words
+    first = NUM_FILE_DES + FD_CHUNK_INDEX(fd) * FD_CHUNK;
+    if(pcb->fd_used[FD_WORD(first)] & (FD_CHUNK_MASK << (first & 31))){
+        return;
+    }
+    chunk = (pcb->fd_chunk[FD_CHUNK_INDEX(fd)] - &fd_pool[0][0]) / FD_CHUNK;
+    pcb->fd_chunk[FD_CHUNK_INDEX(fd)] = NULL;
+    spin_lock_irqsave(&fd_pool_lock, flags);
+    fd_pool_used &= ~(1U << chunk);
+    spin_unlock_irqrestore(&fd_pool_lock, flags);
+}
@@ -0,0 +1,134 @@
+/* fd.h - Per-process file descriptor tables and the open files they share
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FD_H
+#define _FD_H
+
+#include "types.h"
+#include "systemcall.h"
+
+/* A descriptor points to an open file (file_array_struct), which holds the
+ * driver, inode and position. open makes a new one; dup, dup2 and execute
+ * make more descriptors point to an existing one, which then share the
+ * position. The driver's close runs when the last descriptor goes.
+ *
+ * Descriptors 0 to NUM_FILE_DES-1 live in the PCB. Higher ones come in
+ * chunks of FD_CHUNK entries from a pool shared by all processes, taken when
+ * a process first opens a descriptor in the chunk's range and given back when
+ * the last one in it closes. pcb->fd_used has a bit per open descriptor, so
+ * the lowest free one is a bit scan away. A process may open descriptors
+ * below its fd_limit, which its children inherit; the fdlimit system call
+ * raises it as far as FD_MAX. */
+
+#define FD_POOL_CHUNKS          32          // chunks for all processes together
+#define FD_DEFAULT_LIMIT        NUM_FILE_DES    // what the ECE391 programs (syserr) expect
+#define OPEN_FILE_MAX           128         // open files for all processes together
+
+/*
+ * file_alloc
+ *   DESCRIPTION: Make a new open file
+ *   INPUTS: fileop - its driver, inode - handed to the driver
+ *   OUTPUTS: none
+ *   RETURN VALUE: the file with one reference and position 0, NULL if the table is full
+ *   SIDE EFFECTS: none
+ */
+file_array_struct* file_alloc(fileop_table_t* fileop, uint32_t inode);
+
+/*
+ * file_get, file_put
+ *   DESCRIPTION: Take or drop a reference to an open file
+ *   INPUTS: file - the file
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The last file_put frees the slot. It does not run the
+ *                 driver's close, fd_close does that.
+ */
+void file_get(file_array_struct* file);
+void file_put(file_array_struct* file);
+
+/*
+ * file_is_open
+ *   DESCRIPTION: Tell whether any process has a file open
+ *   INPUTS: fileop - its driver, inode - its inode
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if an open file refers to it, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int32_t file_is_open(fileop_table_t* fileop, uint32_t inode);
+
+/*
+ * fd_init
+ *   DESCRIPTION: Empty a new process's descriptor table
+ *   INPUTS: pcb - the process, limit - its fd_limit
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void fd_init(pcb_struct* pcb, uint32_t limit);
+
+/*
+ * fd_inherit
+ *   DESCRIPTION: Give a new process the descriptors of its parent
+ *   INPUTS: child - the new process (after fd_init), parent - its parent
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Each one refers to the parent's open file. Any that do not
+ *                 fit under the child's limit or in the pool are left out.
+ */
+void fd_inherit(pcb_struct* child, pcb_struct* parent);
+
+/*
+ * fd_get
+ *   DESCRIPTION: Look up an open descriptor
+ *   INPUTS: pcb - the process, fd - descriptor
+ *   OUTPUTS: none
+ *   RETURN VALUE: its open file, NULL if fd is out of range or not open
+ *   SIDE EFFECTS: none
+ */
+file_array_struct* fd_get(pcb_struct* pcb, int32_t fd);
+
+/*
+ * fd_install
+ *   DESCRIPTION: Point a free descriptor at an open file
+ *   INPUTS: pcb - the process, fd - the descriptor, -1 for the lowest free one
+ *           file - the file; the descriptor takes over the caller's reference
+ *   OUTPUTS: none
+ *   RETURN VALUE: the descriptor, -1 if it is taken, at or past the process's
+ *                 limit, or the pool is empty (the reference stays the caller's)
+ *   SIDE EFFECTS: Takes a chunk from the pool for the first descriptor in its range
+ */
+int32_t fd_install(pcb_struct* pcb, int32_t fd, file_array_struct* file);
+
+/*
+ * fd_close
+ *   DESCRIPTION: Close a descriptor
+ *   INPUTS: pcb - the process, fd - descriptor
+ *   OUTPUTS: none
+ *   RETURN VALUE: what the driver's close returned (0 if other descriptors
+ *                 keep the file open), -1 if fd is not open
+ *   SIDE EFFECTS: Gives an emptied chunk back to the pool
+ */
+int32_t fd_close(pcb_struct* pcb, int32_t fd);
+
+/*
+ * fd_next_open
+ *   DESCRIPTION: Walk the open descriptors
+ *   INPUTS: pcb - the process, fd - where to start looking
+ *   OUTPUTS: none
+ *   RETURN VALUE: lowest open descriptor >= fd, -1 if there is none
+ *   SIDE EFFECTS: none
+ */
+int32_t fd_next_open(pcb_struct* pcb, int32_t fd);
+
+/*
+ * fd_set_limit
+ *   DESCRIPTION: Change how many descriptors a process may have
+ *   INPUTS: pcb - the process, limit - NUM_FILE_DES to FD_MAX
+ *   OUTPUTS: none
+ *   RETURN VALUE: the old limit, -1 if out of range or below an open descriptor
+ *   SIDE EFFECTS: none
+ */
+int32_t fd_set_limit(pcb_struct* pcb, int32_t limit);
+
+#endif /* _FD_H */
@@ -1,19 +1,107 @@
 #include "systemcall.h"
+#include "fd.h"
 #include "file_system.h"
+#include "ata.h"
+#include "bcache.h"
+#include "sched.h"
+
+static int32_t seek_position(file_array_struct* file, int32_t offset, int32_t whence, uint32_t end);
+
+/* A file system image on an IDE disk takes precedence over the boot module.
+ * Its boot block and index nodes are read into fs_image and written back to
+ * the disk whenever they change; data blocks are read and written on the
+ * disk through the buffer cache, and every block the disk has room for past the image's last one is
+ * free for new and growing files. Otherwise the boot module is copied into
+ * fs_image, which has room past the module's last block for more data
+ * blocks. A bit per inode and per data block records which are in use; both
+ * bitmaps are built here from the dentries and index nodes, which are the
+ * only record the image keeps. If the module does not fit, it is used in
+ * place and stays read-only. */
+static data_block fs_image[FS_IMAGE_BLOCKS] __attribute__((aligned(FILE_SYSTEM_BLOCK_SIZE)));
+static uint32_t inode_bitmap[FS_IMAGE_BLOCKS / 32];        // bit per index node in use
+static uint32_t block_bitmap[FS_MAX_DATA_BLOCKS / 32];     // bit per data block in use
+static int fs_writable;
+static int32_t fs_drive = -1;                               // ATA drive holding the image, -1 for memory
+static sleep_lock_t fs_lock = SLEEP_LOCK_INIT;              // bitmaps, dentries, index nodes and written data
+
+#define FS_BIT_SET(map, n)      ((map)[(n) >> 5] |= 1U << ((n) & 31))
+#define FS_BIT_CLEAR(map, n)    ((map)[(n) >> 5] &= ~(1U << ((n) & 31)))
+#define FS_BIT_TEST(map, n)     ((map)[(n) >> 5] & (1U << ((n) & 31)))
+#define FS_BLOCKS(length)       (((length) + FILE_SYSTEM_BLOCK_SIZE - 1) / FILE_SYSTEM_BLOCK_SIZE)
+#define FS_SECTORS              (FILE_SYSTEM_BLOCK_SIZE / ATA_SECTOR_SIZE)     // disk sectors per block
+#define FS_DISK_BLOCK(block)    (1 + boot_block_ptr->inode_count + (block))     // data block's place on the disk
+
+static int32_t fs_alloc(uint32_t* bitmap, uint32_t count);
+static int32_t truncate_data(uint32_t inode, uint32_t length);
+static int32_t fs_disk_probe(uint32_t drive);
+static int32_t fs_block_read(uint32_t block, uint32_t offset, uint8_t* buf, uint32_t length);
+static int32_t fs_block_write(uint32_t block, uint32_t offset, const uint8_t* buf, uint32_t length);
+static void fs_readahead(index_node* inode, uint32_t index);
+static int32_t fs_read(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length, uint32_t* next_index);
+static void fs_sync(void* ptr);
 
 /* 
  * file_system_init
- *  DESCRIPTION: Function to iniitialize the read-only file system
+ *  DESCRIPTION: Function to iniitialize the file system from an IDE disk (ata_init first) or the boot module
  *  INPUTS: none
  *  OUTPUTS: none
  *  RETURN VALUE: none
- *  SIDE EFFECT: For the current file system, set the pointer to the boot block, pointer to the first index node, and pointer
- *               to the first data block 
+ *  SIDE EFFECT: Reads the disk's boot block and index nodes, or copies the module into fs_image if it fits,
+ *               sets the pointer to the boot block, pointer to the first index node, and pointer to the
+ *               first data block (NULL on a disk), and builds the inode and data block bitmaps
  */
 void file_system_init(){
-    boot_block_ptr = (boot_block*) file_system_ptr;                                     // set the boot block pointer of current file system
-    index_nodes_ptr = (index_node*) (boot_block_ptr + 1);                               // set ptr to first index node ( + 1 to offset the boot block)
-    data_blocks_ptr = (data_block*) (index_nodes_ptr + (boot_block_ptr->inode_count));  // set ptr to first data block of 4096 bytes each
+    boot_block* module = (boot_block*) file_system_ptr;
+    uint32_t module_blocks = 0;
+    uint32_t i, j, disk_blocks;
+
+    for(i = 0; i < ATA_NUM_DRIVES && fs_drive == -1; i++){
+        if(fs_disk_probe(i) == 0) fs_drive = i;
+    }
+
+    if(fs_drive != -1){
+        // every block the disk has after the index nodes is a data block now, used or not
+        boot_block_ptr = (boot_block*) fs_image;
+        disk_blocks = ata_sectors(fs_drive) / FS_SECTORS - 1 - boot_block_ptr->inode_count;
+        boot_block_ptr->data_block_count = (disk_blocks < FS_MAX_DATA_BLOCKS) ? disk_blocks : FS_MAX_DATA_BLOCKS;
+        index_nodes_ptr = (index_node*) (boot_block_ptr + 1);
+        data_blocks_ptr = NULL;
+        fs_writable = 1;
+    } else {
+        // work on a copy with free blocks after it when there is room, else on the module itself
+        if(module != NULL){
+            module_blocks = 1 + module->inode_count + module->data_block_count;     // boot block, index nodes, data blocks
+        }
+        if(module_blocks <= FS_IMAGE_BLOCKS){
+            memcpy(fs_image, module, module_blocks * FILE_SYSTEM_BLOCK_SIZE);
+            boot_block_ptr = (boot_block*) fs_image;
+            fs_writable = 1;
+        } else {
+            boot_block_ptr = module;
+            fs_writable = 0;
+        }
+        index_nodes_ptr = (index_node*) (boot_block_ptr + 1);                               // set ptr to first index node ( + 1 to offset the boot block)
+        data_blocks_ptr = (data_block*) (index_nodes_ptr + (boot_block_ptr->inode_count));  // set ptr to first data block of 4096 bytes each
+        if(!fs_writable) return;
+
+        // every block after the index nodes is a data block now, used or not
+        boot_block_ptr->data_block_count = FS_IMAGE_BLOCKS - 1 - boot_block_ptr->inode_count;
+    }
+
+    // in use: the inodes regular files name, and the blocks those inodes list
+    for(i = 0; i < boot_block_ptr->directory_entry_count && i < MAX_FILES; i++){
+        dentry_t* dentry = &boot_block_ptr->dir_entries[i];
+        index_node* inode;
+
+        if(dentry->file_type != REGULAR_FILE_TYPE || dentry->inode_number >= boot_block_ptr->inode_count) continue;
+        FS_BIT_SET(inode_bitmap, dentry->inode_number);
+        inode = &index_nodes_ptr[dentry->inode_number];
+        for(j = 0; j < FS_BLOCKS(inode->file_length) && j < MAX_DATA_BLOCKS; j++){
+            if(inode->data_block_num[j] < boot_block_ptr->data_block_count){
+                FS_BIT_SET(block_bitmap, inode->data_block_num[j]);
+            }
+        }
+    }
 }
 
 /*
@@ -34,8 +122,8 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry){
     // Fail and return -1 since input length is too long 
     if(input_file_length > MAX_FILE_NAME) return -1;//input_file_length = MAX_FILE_NAME;
 
-    // Loop through all directory entries (63 + 1 since we want to go through files 0 - 63)
-    for(current_dentry_index = 0; current_dentry_index < (MAX_FILES + 1); current_dentry_index++){
+    // Loop through the directory entries in use (unlink and create keep them at the front)
+    for(current_dentry_index = 0; current_dentry_index < boot_block_ptr->directory_entry_count && current_dentry_index < MAX_FILES; current_dentry_index++){
 
         int dentry_file_length;
         // Get the file length of current directory entry (since file name need not be NUL terminated, if strlen returns greater than 32, set length to 32)
@@ -73,18 +161,41 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry){
  *               file_type, and inode_number for the file.
  */
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry){
-    // If index is less than 0 or greater than maximum number of files (63), return failure (invalid index)
-    if(index < 0 || index > MAX_FILES) return -1;
+    // If index is past the last directory entry in use, return failure (invalid index)
+    if(index >= boot_block_ptr->directory_entry_count || index >= MAX_FILES) return -1;
 
     // If valid index, then copy file name (to be padded with 0s so up to 32 bytes), file type, and inode number
     strncpy((int8_t*) dentry->file_name, (int8_t*) boot_block_ptr->dir_entries[index].file_name, MAX_FILE_NAME);
     dentry->file_type = boot_block_ptr->dir_entries[index].file_type;
-    dentry->file_type = boot_block_ptr->dir_entries[index].inode_number;
+    dentry->inode_number = boot_block_ptr->dir_entries[index].inode_number;
 
     // After copy, return success
     return 0;
 }
 
+/* 
+ * read_dentry_by_inode
+ *  DESCRIPTION: Function to find the directory entry of a regular file by its index node number
+ *  INPUTS: inode - index node number of the file
+ *          dentry - dentry_t block containing file_name, file_type, and inode_number to be filled
+ *  OUTPUTS: none
+ *  RETURN VALUE: -1 on failure (no regular file uses that inode), 0 on success
+ *  SIDE EFFECT: Fill in the dentry_t block passed in as the second argument
+ */
+int32_t read_dentry_by_inode(uint32_t inode, dentry_t* dentry){
+    uint32_t i;
+
+    for(i = 0; i < boot_block_ptr->directory_entry_count && i < MAX_FILES; i++){
+        if(boot_block_ptr->dir_entries[i].file_type == REGULAR_FILE_TYPE &&
+           boot_block_ptr->dir_entries[i].inode_number == inode){
+            return read_dentry_by_index(i, dentry);
+        }
+    }
+
+    // No regular file has that inode
+    return -1;
+}
+
 /* 
  * read_data
  *  DESCRIPTION: Function to read from file and store in buffer
@@ -99,14 +210,24 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry){
  *               Read until end of file or end of buffer provided.
  */
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){ 
-    // printf("Read_data: %d\n", length);
-    // variable for looping through entire length to read
-    int i; 
-    // variables to represent the data block we look at and the specific data within each block
-    // data_block* current_data_block_ptr;
-    // uint32_t*   current_data_block_ptr;
-    data_block* current_data_block_ptr;
-    uint8_t target_data;
+    return fs_read(inode, offset, buf, length, NULL);
+}
+
+/* 
+ * fs_read
+ *  DESCRIPTION: Helper for read_data and file_pread
+ *  INPUTS: inode, offset, buf, length - as read_data takes them
+ *          next_index - the open file's data block index a sequential read would come to next,
+ *                       NULL to read ahead only from the start of the file
+ *  OUTPUTS: none
+ *  RETURN VALUE: as read_data returns
+ *  SIDE EFFECT: Holds fs_lock, so write_data, file_truncate and file_unlink cannot change the
+ *               length or free a block while it is being read. Updates *next_index.
+ */
+static int32_t fs_read(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length, uint32_t* next_index){
+    // the chunk copied out of the data block we look at
+    uint32_t chunk_length;
+    int32_t ret;
 
     // declare and initialize the index into the index node to find data block number
     uint32_t data_block_inode_index = offset / FILE_SYSTEM_BLOCK_SIZE;
@@ -124,59 +245,55 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
         return -1; 
     } 
 
+    sleep_lock(&fs_lock);
     // if the offset into the file is already at or past the file length, return 0 (can't read anymore)
     if(offset >= current_index_node->file_length){ 
+        sleep_unlock(&fs_lock);
         return 0; 
     }
 
-    // printf("begin reading");
-
-    // starting offset of current read_data iteration is within file length, attempt to read the entire desired length
-    for(i = 0; i < length; i++){  
-        // check if the index into length that we want to read plus original offset is past file length, if so, return bytes read 
-        if((i + offset) < current_index_node->file_length){
-            
-          // printf("Byte: %d", i);
-
-          // if the byte_offset has accumulated to be past the file system block size, then reset it and move to the next data block  
-          if(byte_offset_in_block >= FILE_SYSTEM_BLOCK_SIZE){
-            byte_offset_in_block = 0;
-            data_block_inode_index++;
-          }
-          
-          // if(MAX_DATA_BLOCKS <= data_block_inode_index){                          //check if current block is valid
-          //   return bytes_read_count;
-          // }
-
-          // check that the block number is valid; if it is not, return -1
-          if(boot_block_ptr->data_block_count <= current_index_node->data_block_num[data_block_inode_index]){    
-              return -1;
-          }
-
-          // find the current data block to read from
-          current_data_block_ptr = (data_block*) (data_blocks_ptr + current_index_node->data_block_num[data_block_inode_index]);
-            
-          // retrieve the target byte from the current data block 
-          target_data = current_data_block_ptr->data_byte[byte_offset_in_block];  
-        
-          // printf("%c", target_data);
-
-          // copy the target data into the buffer accordingly (using i as index)
-        //   memcpy((uint8_t*) buf, (uint8_t*) current_data_block.data_byte[byte_offset_in_block],1);
-          buf[i] = target_data;
-          // memcpy(buf, target_data, 1);
-
-          // increment bytes read and offset 
-          //   buf++;
-          bytes_read_count++;
-          byte_offset_in_block++;                                                  
-        } else{
-            // printf("Exiting at i = %d", i);
-          // if we have read to the end of the file, return bytes we have read into the buffer
-          return bytes_read_count;
+    // never read past the end of the file
+    if(length > current_index_node->file_length - offset){
+        length = current_index_node->file_length - offset;
+    }
+
+    // copy one data block (or the part of it we need) at a time
+    while(bytes_read_count < length){
+        // check that the block number is valid; if it is not, return -1
+        if(boot_block_ptr->data_block_count <= current_index_node->data_block_num[data_block_inode_index]){    
+            sleep_unlock(&fs_lock);
+            return -1;
         }
+
+        // take the rest of this block, or only what is left to read
+        chunk_length = FILE_SYSTEM_BLOCK_SIZE - byte_offset_in_block;
+        if(chunk_length > length - bytes_read_count){
+            chunk_length = length - bytes_read_count;
+        }
+
+        // block copy into the buffer; a disk error ends the read early
+        ret = fs_block_read(current_index_node->data_block_num[data_block_inode_index], byte_offset_in_block,
+                            buf + bytes_read_count, chunk_length);
+        if(ret == -1){
+            sleep_unlock(&fs_lock);
+            return (bytes_read_count > 0) ? bytes_read_count : -1;
+        }
+
+        // a cache miss at the start of the file or just after the block this file read last: read on ahead
+        if(ret == 1 && (data_block_inode_index == 0 || (next_index != NULL && data_block_inode_index == *next_index))){
+            fs_readahead(current_index_node, data_block_inode_index + 1);
+        }
+        if(next_index != NULL){
+            *next_index = data_block_inode_index + 1;
+        }
+
+        // move on to the start of the next data block
+        bytes_read_count += chunk_length;
+        byte_offset_in_block = 0;
+        data_block_inode_index++;
     } 
 
+    sleep_unlock(&fs_lock);
     return bytes_read_count;
 
 // /* SMALL FILE READ WORKING VERSION */
@@ -214,18 +331,15 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
  *               file into the buffer until the end of file or end of buffer provided, whichever comes first
  */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes){ 
-    //testing
-    // printf("File_read: %d\n", nbytes);
-
-    // retrieve the current pcb pointer and file array pointer
+    // retrieve the current pcb pointer and the descriptor's entry
     pcb_struct* current_pcb = get_pcb_ptr();
-    file_array_struct* current_file_array = current_pcb->file_array;
+    file_array_struct* current_file = fd_get(current_pcb, fd);
 
     // declare variable to store bytes read of current iteration
     int32_t bytes_read;
 
-    // call read data to read into buffer
-    bytes_read = read_data(current_file_array[fd].inode_number, current_file_array[fd].file_position, buf, nbytes);
+    // read at the current position
+    bytes_read = file_pread(fd, buf, nbytes, current_file->file_position);
 
     // check if we read any bytes (if read_data failed sanity check, return -1)
     if(bytes_read < 0){
@@ -233,11 +347,44 @@ int32_t file_read(int32_t fd, void* buf, int32_t nbytes){
     }
     
     // update file position
-    current_file_array[fd].file_position += bytes_read;
+    current_file->file_position += bytes_read;
 
     return bytes_read;
 }
 
+/* 
+ * file_pread
+ *  DESCRIPTION: Function to read data from a given offset of a file, leaving its position alone
+ *  INPUTS: fd - file descriptor (index into file array to find file to read from)
+ *          buf - buffer that stores data read from the file
+ *          nbytes - number of bytes to read from the file 
+ *          offset - byte offset into the file to start at
+ *  OUTPUTS: none
+ *  RETURN VALUE: number of bytes read from the file (0 if offset is at or beyond end of file), -1 on failure
+ *  SIDE EFFECT: none
+ */
+int32_t file_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
+    file_array_struct* current_file = fd_get(get_pcb_ptr(), fd);
+
+    return fs_read(current_file->inode_number, offset, buf, nbytes, &current_file->readahead);
+}
+
+/* 
+ * file_lseek
+ *  DESCRIPTION: Function to move the position of an open file
+ *  INPUTS: fd - file descriptor (index into file array to find file to seek in)
+ *          offset - bytes to move by
+ *          whence - SEEK_SET, SEEK_CUR or SEEK_END (offset from the start, the position or the end of the file)
+ *  OUTPUTS: none
+ *  RETURN VALUE: the new position, -1 if whence is unknown or the position would be negative
+ *  SIDE EFFECT: Every descriptor sharing the open file sees the new position. Past the end is allowed; reads there return 0.
+ */
+int32_t file_lseek(int32_t fd, int32_t offset, int32_t whence){
+    file_array_struct* current_file = fd_get(get_pcb_ptr(), fd);
+
+    return seek_position(current_file, offset, whence, index_nodes_ptr[current_file->inode_number].file_length);
+}
+
 /*
  * directory_read()
  *  DESCRIPTION: Function to read all file names (one file at a time) from consecutive directory entries in the file system
@@ -252,40 +399,330 @@ int32_t file_read(int32_t fd, void* buf, int32_t nbytes){
  */
 int32_t directory_read(int32_t fd, void* buf, int32_t nbytes){
 
-    // retrieve the current pcb pointer and file array pointer
+    // retrieve the current pcb pointer and the descriptor's entry
     pcb_struct* current_pcb = get_pcb_ptr();
-    file_array_struct* current_file_array = current_pcb->file_array;
+    file_array_struct* current_file = fd_get(current_pcb, fd);
+
+    // declare variable to store file name length that we will return
+    int32_t file_name_length;
+
+    // read the entry at the current position
+    file_name_length = directory_pread(fd, buf, nbytes, current_file->file_position);
+
+    // update file position unless we were past the last entry
+    if(file_name_length > 0){
+        current_file->file_position++;
+    }
+
+    return file_name_length;
+}
+
+/*
+ * directory_pread()
+ *  DESCRIPTION: Function to read the file name of a given directory entry, leaving the directory's position alone
+ *  INPUTS: fd - file descriptor of the open directory
+ *          buf - buffer to store the file name (up to 32 bytes)
+ *          nbytes - number of bytes to read 
+ *          offset - directory entry index (the position directory_read would be at)
+ *  OUTPUTS: none
+ *  RETURN VALUE: number of bytes read (0 if offset is at or beyond end of directory entries)
+ *  SIDE EFFECT: none
+ */
+int32_t directory_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
 
     // variable for storing current directory entry 
     dentry_t current_directory_entry;
 
-    // // declare variable to store bytes read of current iteration
-    // int32_t bytes_read;
-
     // declare variable to store file name length that we will return
     int32_t file_name_length;
 
-    // retrieve directory entry information and return value using read_dentry_by_index
-    int32_t read_dentry_return;
-    read_dentry_return = read_dentry_by_index(current_file_array[fd].file_position, &current_directory_entry);
-
-    // Check the return value; if it is -1, then it means the index is <0 or >63
-    if(read_dentry_return == -1){
-        return 0;                           // return 0 and don't update file position
+    // retrieve directory entry information using read_dentry_by_index; -1 means the index is past the last entry
+    if(read_dentry_by_index(offset, &current_directory_entry) == -1){
+        return 0;
     }
 
     // Get the length of the file_name that we will return (if greater than 32, set to 32)
     file_name_length = strlen((int8_t*) current_directory_entry.file_name);
     if(file_name_length > MAX_FILE_NAME) file_name_length = MAX_FILE_NAME;
 
-    // If return value is not -1, it means we have successfully copied into current_directory_entry, copy file name into buffer
+    // copy file name into buffer
     strncpy((int8_t*) buf, (int8_t*) current_directory_entry.file_name, MAX_FILE_NAME);
 
-    // update file position
-    current_file_array[fd].file_position++;
+    return file_name_length;
+}
 
+/*
+ * directory_lseek()
+ *  DESCRIPTION: Function to move the position of an open directory
+ *  INPUTS: fd - file descriptor of the open directory
+ *          offset - entries to move by
+ *          whence - SEEK_SET, SEEK_CUR or SEEK_END (offset from the first entry, the position or past the last entry)
+ *  OUTPUTS: none
+ *  RETURN VALUE: the new position (an entry index), -1 if whence is unknown or the position would be negative
+ *  SIDE EFFECT: SEEK_SET with offset 0 rewinds the directory for another pass
+ */
+int32_t directory_lseek(int32_t fd, int32_t offset, int32_t whence){
+    file_array_struct* current_file = fd_get(get_pcb_ptr(), fd);
 
-    return file_name_length;
+    return seek_position(current_file, offset, whence, boot_block_ptr->directory_entry_count);
+}
+
+/*
+ * directory_getdents()
+ *  DESCRIPTION: Function to read as many directory entries as fit in a buffer, with their type, inode and length
+ *  INPUTS: fd - file descriptor of the open directory
+ *          buf - buffer to fill with dirent_t records
+ *          nbytes - size of buf in bytes
+ *  OUTPUTS: none
+ *  RETURN VALUE: bytes filled (a multiple of sizeof(dirent_t)), 0 past the last entry, -1 if not even one record fits
+ *  SIDE EFFECT: Moves the directory's position past the entries returned, so directory_read and getdents share it
+ */
+int32_t directory_getdents(int32_t fd, dirent_t* buf, int32_t nbytes){
+    file_array_struct* current_file = fd_get(get_pcb_ptr(), fd);
+    uint32_t entry_count = boot_block_ptr->directory_entry_count;
+    dentry_t* dentry;
+    int32_t count = 0;
+
+    if(entry_count > MAX_FILES) entry_count = MAX_FILES;
+    if(current_file->file_position >= entry_count){
+        return 0;
+    }
+    if(nbytes < (int32_t)sizeof(dirent_t)){
+        return -1;
+    }
+
+    // copy straight out of the boot block, one record per entry until buf is full
+    while(current_file->file_position < entry_count && (count + 1) * (int32_t)sizeof(dirent_t) <= nbytes){
+        dentry = &boot_block_ptr->dir_entries[current_file->file_position];
+        strncpy((int8_t*) buf[count].file_name, (int8_t*) dentry->file_name, MAX_FILE_NAME);
+        buf[count].file_type = dentry->file_type;
+        buf[count].inode_number = dentry->inode_number;
+        buf[count].file_length = (dentry->file_type == REGULAR_FILE_TYPE) ? index_nodes_ptr[dentry->inode_number].file_length : 0;
+        current_file->file_position++;
+        count++;
+    }
+
+    return count * sizeof(dirent_t);
+}
+
+/*
+ * file_stat
+ *  DESCRIPTION: Function to describe a file for stat and fstat
+ *  INPUTS: file_type - the file's type, inode - its index node number (used for regular files)
+ *          buf - stat_t to fill
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, -1 if a regular file's inode number is out of range
+ *  SIDE EFFECT: Fills buf with the type, inode number, and the length and block count from the index node
+ */
+int32_t file_stat(uint32_t file_type, uint32_t inode, stat_t* buf){
+    uint32_t file_length = 0;
+
+    if(file_type == REGULAR_FILE_TYPE){
+        if(inode >= boot_block_ptr->inode_count) return -1;
+        file_length = index_nodes_ptr[inode].file_length;
+    }
+
+    buf->file_type = file_type;
+    buf->inode_number = inode;
+    buf->file_length = file_length;
+    buf->block_count = (file_length + FILE_SYSTEM_BLOCK_SIZE - 1) / FILE_SYSTEM_BLOCK_SIZE;    // round up to whole blocks
+    return 0;
+}
+
+/*
+ * fs_alloc
+ *  DESCRIPTION: Helper to take the lowest free index node or data block (fs_lock held)
+ *  INPUTS: bitmap - inode_bitmap or block_bitmap
+ *          count - how many the bitmap covers
+ *  OUTPUTS: none
+ *  RETURN VALUE: its number, -1 if all are in use
+ *  SIDE EFFECT: marks it in use
+ */
+static int32_t fs_alloc(uint32_t* bitmap, uint32_t count){
+    uint32_t i;
+
+    for(i = 0; i < count; i++){
+        if(bitmap[i >> 5] == 0xFFFFFFFF){
+            i |= 31;                        // skip a full word
+            continue;
+        }
+        if(!FS_BIT_TEST(bitmap, i)){
+            FS_BIT_SET(bitmap, i);
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * truncate_data
+ *  DESCRIPTION: Helper for file_truncate, file_create, file_unlink and write_data (fs_lock held)
+ *  INPUTS: inode - index node number of the file, length - new length in bytes
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, -1 if there were not enough free blocks to extend it, or a disk error (nothing changes then)
+ *  SIDE EFFECT: Zeroes the tail of the new last block when shrinking, so later growth reads back as zeros;
+ *               writes the index node back to the disk
+ */
+static int32_t truncate_data(uint32_t inode, uint32_t length){
+    index_node* current_index_node = &index_nodes_ptr[inode];
+    uint32_t old_blocks = FS_BLOCKS(current_index_node->file_length);
+    uint32_t i;
+    int32_t block;
+
+    // longer: zeroed blocks up to the new end
+    for(i = old_blocks; i < FS_BLOCKS(length); i++){
+        block = fs_alloc(block_bitmap, boot_block_ptr->data_block_count);
+        if(block != -1 && fs_block_write(block, 0, NULL, FILE_SYSTEM_BLOCK_SIZE) == -1){
+            FS_BIT_CLEAR(block_bitmap, block);
+            block = -1;
+        }
+        if(block == -1){
+            while(i-- > old_blocks){
+                FS_BIT_CLEAR(block_bitmap, current_index_node->data_block_num[i]);
+            }
+            return -1;
+        }
+        current_index_node->data_block_num[i] = block;
+    }
+
+    // shorter: clear what is left of the last block and free the blocks past the end
+    if(length < current_index_node->file_length && length % FILE_SYSTEM_BLOCK_SIZE != 0){
+        if(fs_block_write(current_index_node->data_block_num[length / FILE_SYSTEM_BLOCK_SIZE], length % FILE_SYSTEM_BLOCK_SIZE,
+                          NULL, FILE_SYSTEM_BLOCK_SIZE - length % FILE_SYSTEM_BLOCK_SIZE) == -1){
+            return -1;
+        }
+    }
+    for(i = FS_BLOCKS(length); i < old_blocks; i++){
+        FS_BIT_CLEAR(block_bitmap, current_index_node->data_block_num[i]);
+    }
+
+    current_index_node->file_length = length;
+    fs_sync(current_index_node);
+    return 0;
+}
+
+/*
+ * fs_disk_probe
+ *  DESCRIPTION: Helper for file_system_init to look for a file system image at the start of a disk
+ *  INPUTS: drive - ATA_MASTER or ATA_SLAVE
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 if it has one, -1 if not (no drive, or the first block is not a boot block)
+ *  SIDE EFFECT: Reads its boot block and index nodes into fs_image
+ */
+static int32_t fs_disk_probe(uint32_t drive){
+    boot_block* boot = (boot_block*) fs_image;
+    uint32_t disk_blocks = ata_sectors(drive) / FS_SECTORS;
+
+    if(disk_blocks == 0 || ata_read(drive, 0, FS_SECTORS, boot) == -1) return -1;
+
+    // the boot disk (GRUB and the kernel) fails these
+    if(boot->directory_entry_count == 0 || boot->directory_entry_count > MAX_FILES) return -1;
+    if(boot->inode_count == 0 || 1 + boot->inode_count > FS_IMAGE_BLOCKS) return -1;
+    if(boot->data_block_count > FS_MAX_DATA_BLOCKS || 1 + boot->inode_count + boot->data_block_count > disk_blocks) return -1;
+    if(strncmp(boot->dir_entries[0].file_name, (int8_t*) ".", MAX_FILE_NAME) != 0
+       || boot->dir_entries[0].file_type != DIRECTORY_FILE_TYPE) return -1;
+
+    return ata_read(drive, FS_SECTORS, boot->inode_count * FS_SECTORS, &fs_image[1]);
+}
+
+/*
+ * fs_block_read
+ *  DESCRIPTION: Helper to copy part of a data block out
+ *  INPUTS: block - data block number (in range), offset - byte in it to start at
+ *          buf - where to copy to, length - bytes (offset + length at most a block)
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, 1 if it had to come from the disk (a cache miss), -1 on a disk error
+ *  SIDE EFFECT: none
+ */
+static int32_t fs_block_read(uint32_t block, uint32_t offset, uint8_t* buf, uint32_t length){
+    if(fs_drive == -1){
+        // large program loads take memcpy's streaming path
+        memcpy(buf, &data_blocks_ptr[block].data_byte[offset], length);
+        return 0;
+    }
+    return bcache_read(fs_drive, FS_DISK_BLOCK(block), offset, buf, length);
+}
+
+/*
+ * fs_block_write
+ *  DESCRIPTION: Helper to copy into part of a data block
+ *  INPUTS: block - data block number (in range), offset - byte in it to start at
+ *          buf - what to copy, NULL for zeros, length - bytes (offset + length at most a block)
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, -1 on a disk error
+ *  SIDE EFFECT: On a disk, writes through the buffer cache
+ */
+static int32_t fs_block_write(uint32_t block, uint32_t offset, const uint8_t* buf, uint32_t length){
+    if(fs_drive == -1){
+        if(buf == NULL){
+            memset(&data_blocks_ptr[block].data_byte[offset], 0, length);
+        } else {
+            memcpy(&data_blocks_ptr[block].data_byte[offset], buf, length);
+        }
+        return 0;
+    }
+    return bcache_write(fs_drive, FS_DISK_BLOCK(block), offset, buf, length);
+}
+
+/*
+ * fs_readahead
+ *  DESCRIPTION: Helper for fs_read to read the blocks of a file that come after one it missed in the cache
+ *  INPUTS: inode - the file's index node, index - first data_block_num entry to read ahead
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: Brings up to BCACHE_READAHEAD blocks (those before the end of the file) into the cache
+ */
+static void fs_readahead(index_node* inode, uint32_t index){
+    uint32_t blocks[BCACHE_READAHEAD];
+    uint32_t count;
+
+    for(count = 0; count < BCACHE_READAHEAD && index < FS_BLOCKS(inode->file_length); count++, index++){
+        if(inode->data_block_num[index] >= boot_block_ptr->data_block_count) break;
+        blocks[count] = FS_DISK_BLOCK(inode->data_block_num[index]);
+    }
+    bcache_readahead(fs_drive, blocks, count);
+}
+
+/*
+ * fs_sync
+ *  DESCRIPTION: Helper to write a changed boot block or index node back to the disk (fs_lock held)
+ *  INPUTS: ptr - anywhere in the changed block of fs_image
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: Nothing for an image in memory. A failed write leaves the disk behind fs_image until
+ *               the block changes again.
+ */
+static void fs_sync(void* ptr){
+    uint32_t index = ((uint8_t*) ptr - (uint8_t*) fs_image) / FILE_SYSTEM_BLOCK_SIZE;
+
+    if(fs_drive != -1){
+        ata_write(fs_drive, index * FS_SECTORS, FS_SECTORS, &fs_image[index]);     // never cached
+    }
+}
+
+/*
+ * seek_position
+ *  DESCRIPTION: Helper for file_lseek and directory_lseek
+ *  INPUTS: file - the open file, offset and whence - as lseek takes them
+ *          end - the position SEEK_END counts from
+ *  OUTPUTS: none
+ *  RETURN VALUE: the new position, -1 if whence is unknown or the position would be negative
+ *  SIDE EFFECT: sets file->file_position
+ */
+static int32_t seek_position(file_array_struct* file, int32_t offset, int32_t whence, uint32_t end){
+    int32_t base;
+
+    switch(whence){
+        case SEEK_SET: base = 0; break;
+        case SEEK_CUR: base = file->file_position; break;
+        case SEEK_END: base = end; break;
+        default: return -1;
+    }
+    if((offset < 0 && base + offset < 0) || (offset > 0 && base + offset < base)){
+        return -1;
+    }
+    file->file_position = base + offset;
+    return file->file_position;
 }
 
 /* 
@@ -314,16 +751,212 @@ int32_t file_close(int32_t fd){
 
 /* 
  * file_write
- *  DESCRIPTION: Function to write to the file 
+ *  DESCRIPTION: Function to write to the file at its position
  *  INPUTS: fd - file descriptor (index into file array to find file to write into)
  *          buf - contains data to write into file
  *          nbytes - number of bytes to write into file
  *  OUTPUTS: none
- *  RETURN VALUE: -1 always (because we have a read only file system; cannot write)
- *  SIDE EFFECT: None, because we have a read only file system
+ *  RETURN VALUE: number of bytes written, -1 on failure (read-only image, or no free data block for the first byte)
+ *  SIDE EFFECT: Writes through write_data and moves the position past what was written
  */
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes){
-    return -1;                  // return -1 to indicate fail because we have a read only file system
+    file_array_struct* current_file = fd_get(get_pcb_ptr(), fd);
+    int32_t bytes_written;
+
+    bytes_written = write_data(current_file->inode_number, current_file->file_position, buf, nbytes);
+    if(bytes_written > 0){
+        current_file->file_position += bytes_written;
+    }
+    return bytes_written;
+}
+
+/* 
+ * write_data
+ *  DESCRIPTION: Function to write into a file, growing it as needed
+ *  INPUTS: inode - index node number of the file to write to
+ *          offset - position offset in the file to begin writing at (may be past the end)
+ *          buf - data to write
+ *          length - number of bytes to write
+ *  OUTPUTS: none
+ *  RETURN VALUE: number of bytes written (fewer than length if the data blocks ran out or the disk failed),
+ *                -1 on failure
+ *  SIDE EFFECT: Takes zeroed data blocks from the bitmap for any part of the file that had none, so a gap
+ *               left by writing past the end reads back as zeros; updates the file length and writes the
+ *               index node back to the disk
+ */
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length){
+    index_node* current_index_node;
+    uint32_t block_index, byte_offset_in_block, chunk_length, i, blocks_end, length_requested;
+    uint32_t bytes_written_count = 0;
+    int32_t block;
+
+    if(!fs_writable || inode >= boot_block_ptr->inode_count) return -1;
+    if(offset >= MAX_DATA_BLOCKS * FILE_SYSTEM_BLOCK_SIZE) return -1;
+    if(length > MAX_DATA_BLOCKS * FILE_SYSTEM_BLOCK_SIZE - offset){
+        length = MAX_DATA_BLOCKS * FILE_SYSTEM_BLOCK_SIZE - offset;
+    }
+    if(length == 0) return 0;             // nothing to write, and the file must not grow
+    current_index_node = &index_nodes_ptr[inode];
+    length_requested = length;
+
+    sleep_lock(&fs_lock);
+    // give the file blocks up to the one the write ends in
+    for(i = FS_BLOCKS(current_index_node->file_length); i < FS_BLOCKS(offset + length); i++){
+        block = fs_alloc(block_bitmap, boot_block_ptr->data_block_count);
+        if(block == -1) break;
+        if(fs_block_write(block, 0, NULL, FILE_SYSTEM_BLOCK_SIZE) == -1){
+            FS_BIT_CLEAR(block_bitmap, block);
+            break;
+        }
+        current_index_node->data_block_num[i] = block;
+    }
+    blocks_end = i;
+    // blocks ran out: write only as far as the ones it has
+    if(i < FS_BLOCKS(offset + length)){
+        length = (i * FILE_SYSTEM_BLOCK_SIZE > offset) ? i * FILE_SYSTEM_BLOCK_SIZE - offset : 0;
+    }
+
+    block_index = offset / FILE_SYSTEM_BLOCK_SIZE;
+    byte_offset_in_block = offset % FILE_SYSTEM_BLOCK_SIZE;
+    while(bytes_written_count < length){
+        chunk_length = FILE_SYSTEM_BLOCK_SIZE - byte_offset_in_block;
+        if(chunk_length > length - bytes_written_count){
+            chunk_length = length - bytes_written_count;
+        }
+        if(fs_block_write(current_index_node->data_block_num[block_index], byte_offset_in_block,
+                          buf + bytes_written_count, chunk_length) == -1){
+            break;
+        }
+        bytes_written_count += chunk_length;
+        byte_offset_in_block = 0;
+        block_index++;
+    }
+
+    if(bytes_written_count > 0 && offset + bytes_written_count > current_index_node->file_length){
+        current_index_node->file_length = offset + bytes_written_count;
+        fs_sync(current_index_node);
+    }
+    // give back blocks taken past what was written (all of them if nothing was)
+    for(i = FS_BLOCKS(current_index_node->file_length); i < blocks_end; i++){
+        FS_BIT_CLEAR(block_bitmap, current_index_node->data_block_num[i]);
+    }
+    sleep_unlock(&fs_lock);
+    return (bytes_written_count == 0 && length_requested > 0) ? -1 : (int32_t) bytes_written_count;
+}
+
+/* 
+ * file_truncate
+ *  DESCRIPTION: Function to set the length of a file
+ *  INPUTS: inode - index node number of the file
+ *          length - new length in bytes, shorter or longer
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, -1 on failure (read-only image, bad inode, too long, or no free data blocks)
+ *  SIDE EFFECT: Frees the data blocks past the new end, or takes zeroed ones to extend the file
+ */
+int32_t file_truncate(uint32_t inode, uint32_t length){
+    int32_t ret;
+
+    if(!fs_writable || inode >= boot_block_ptr->inode_count) return -1;
+    if(length > MAX_DATA_BLOCKS * FILE_SYSTEM_BLOCK_SIZE) return -1;
+
+    sleep_lock(&fs_lock);
+    ret = truncate_data(inode, length);
+    sleep_unlock(&fs_lock);
+    return ret;
+}
+
+/* 
+ * file_create
+ *  DESCRIPTION: Function to make an empty regular file, or empty the one already there (fs_lookup_lock held)
+ *  INPUTS: fname - name of the file (1 to 32 characters)
+ *  OUTPUTS: none
+ *  RETURN VALUE: the file's index node number, -1 on failure (read-only image, bad name, the name taken by
+ *                something other than a regular file, directory full, or no free index node)
+ *  SIDE EFFECT: Adds a dentry after the last one and takes an index node from the bitmap, or frees the
+ *               data blocks of the existing file. The caller holds the lock until it has the file open,
+ *               so file_unlink cannot free the index node in between.
+ */
+int32_t file_create(const uint8_t* fname){
+    dentry_t existing;
+    dentry_t* dentry;
+    uint32_t name_length = strlen((int8_t*) fname);
+    int32_t inode;
+
+    if(!fs_writable || name_length == 0 || name_length > MAX_FILE_NAME) return -1;
+
+    if(read_dentry_by_name(fname, &existing) == 0){
+        if(existing.file_type != REGULAR_FILE_TYPE || truncate_data(existing.inode_number, 0) == -1){
+            return -1;
+        }
+        return existing.inode_number;
+    }
+    if(boot_block_ptr->directory_entry_count >= MAX_FILES) return -1;
+    inode = fs_alloc(inode_bitmap, boot_block_ptr->inode_count);
+    if(inode == -1) return -1;
+    index_nodes_ptr[inode].file_length = 0;
+    fs_sync(&index_nodes_ptr[inode]);
+
+    dentry = &boot_block_ptr->dir_entries[boot_block_ptr->directory_entry_count];
+    memset(dentry, 0, sizeof(dentry_t));
+    strncpy(dentry->file_name, (int8_t*) fname, MAX_FILE_NAME);
+    dentry->file_type = REGULAR_FILE_TYPE;
+    dentry->inode_number = inode;
+    boot_block_ptr->directory_entry_count++;
+    fs_sync(boot_block_ptr);
+    return inode;
+}
+
+/* 
+ * file_unlink
+ *  DESCRIPTION: Function to remove a regular file
+ *  INPUTS: fname - name of the file
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, -1 on failure (read-only image, no such name, not a regular file, or open)
+ *  SIDE EFFECT: Removes its dentry (the ones after it move up one) and frees its index node and data blocks
+ */
+int32_t file_unlink(const uint8_t* fname){
+    dentry_t dentry;
+    uint32_t i;
+
+    if(!fs_writable) return -1;
+
+    sleep_lock(&fs_lock);
+    // checked under the lock open holds from its lookup until the file is open
+    if(read_dentry_by_name(fname, &dentry) == -1 || dentry.file_type != REGULAR_FILE_TYPE
+       || file_is_open(&file_fileop_table, dentry.inode_number)){
+        sleep_unlock(&fs_lock);
+        return -1;
+    }
+    for(i = 0; strncmp(boot_block_ptr->dir_entries[i].file_name, dentry.file_name, MAX_FILE_NAME) != 0; i++);
+    for(; i + 1 < boot_block_ptr->directory_entry_count; i++){
+        boot_block_ptr->dir_entries[i] = boot_block_ptr->dir_entries[i + 1];
+    }
+    boot_block_ptr->directory_entry_count--;
+    memset(&boot_block_ptr->dir_entries[boot_block_ptr->directory_entry_count], 0, sizeof(dentry_t));
+    fs_sync(boot_block_ptr);
+
+    truncate_data(dentry.inode_number, 0);
+    FS_BIT_CLEAR(inode_bitmap, dentry.inode_number);
+    sleep_unlock(&fs_lock);
+    return 0;
+}
+
+/* 
+ * fs_lookup_lock, fs_lookup_unlock
+ *  DESCRIPTION: Hold the file system still across a name lookup and what is done with its result
+ *  INPUTS: none
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: open and create hold it from the name lookup until the file is open, so file_unlink
+ *               cannot free the index node in between. No file system call but file_create may be
+ *               made while held.
+ */
+void fs_lookup_lock(void){
+    sleep_lock(&fs_lock);
+}
+
+void fs_lookup_unlock(void){
+    sleep_unlock(&fs_lock);
 }
 
 /* 
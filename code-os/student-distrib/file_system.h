@@ -10,9 +10,12 @@
 #define RTC_FILE_TYPE 0                // file type 0 for a file giving user-level access to RTC
 #define DIRECTORY_FILE_TYPE 1          // file type 1 for directory files
 #define REGULAR_FILE_TYPE 2            // file type 2 for regular files 
+#define DEVICE_FILE_TYPE 3             // kernel device files (trace, proc/...), which have no dentry; stat only
 
 #define FILE_SYSTEM_BLOCK_SIZE 4096                       // file system divided into 4kB blocks, or 4096 byte blocks
 #define MAX_DATA_BLOCKS ((FILE_SYSTEM_BLOCK_SIZE - 4)/4)  // max number of data blocks in each index node (subtract 4 bytes for length in bytes of file)
+#define FS_IMAGE_BLOCKS 256                               // blocks in the writable RAM copy of the file system (1MB), a multiple of 32
+#define FS_MAX_DATA_BLOCKS 16384                          // data blocks used on a disk (64MB), a multiple of 32
 
 /* Define directory_entry struct (64B each) to include the file name, file type, and index node number */
 typedef struct {
@@ -42,6 +45,22 @@ typedef struct {
     uint8_t data_byte[FILE_SYSTEM_BLOCK_SIZE];  //maximum of 4096 bytes of data in each data block
 } data_block;
 
+/* Define dirent_t struct, one directory entry as getdents returns it (44B each) */
+typedef struct {
+    int8_t file_name[MAX_FILE_NAME];             //File name up to 32 characters, NUL padded (not terminated at 32)
+    uint32_t file_type;
+    uint32_t inode_number;
+    uint32_t file_length;                        //bytes, 0 unless a regular file
+} dirent_t;
+
+/* Define stat_t struct, what stat and fstat report about a file */
+typedef struct {
+    uint32_t file_type;                          //one of the *_FILE_TYPE values above
+    uint32_t inode_number;
+    uint32_t file_length;                        //bytes, 0 unless a regular file
+    uint32_t block_count;                        //data blocks the file's inode lists
+} stat_t;
+
 /* Define global variables */  
 /////////////////////////////// SET THIS IN KERNEL BEFORE CALLING file_system_init 
 extern uint32_t* file_system_ptr;                  //pointer to the beginning of the entire file system (set in kernel.c before calling file_system_init)
@@ -52,12 +71,12 @@ data_block* data_blocks_ptr;                       //pointer to first data block
 
 /* 
  * file_system_init
- *  DESCRIPTION: Function to iniitialize the read-only file system
+ *  DESCRIPTION: Function to iniitialize the file system from the boot module
  *  INPUTS: none
  *  OUTPUTS: none
  *  RETURN VALUE: none
- *  SIDE EFFECT: For the current file system, set the pointer to the boot block, pointer to the first index node, and pointer
- *               to the first data block 
+ *  SIDE EFFECT: Copies the module into a writable RAM image if it fits, sets the pointer to the boot block, pointer to
+ *               the first index node, and pointer to the first data block, and builds the inode and data block bitmaps
  */
 void file_system_init();
 
@@ -85,6 +104,17 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
  */
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
 
+/* 
+ * read_dentry_by_inode
+ *  DESCRIPTION: Function to find the directory entry of a regular file by its index node number
+ *  INPUTS: inode - index node number of the file
+ *          dentry - dentry_t block containing file_name, file_type, and inode_number to be filled
+ *  OUTPUTS: none
+ *  RETURN VALUE: -1 on failure (no regular file uses that inode), 0 on success
+ *  SIDE EFFECT: Fill in the dentry_t block passed in as the second argument
+ */
+int32_t read_dentry_by_inode(uint32_t inode, dentry_t* dentry);
+
 /* 
  * read_data
  *  DESCRIPTION: Function to read from file and store in buffer
@@ -124,16 +154,76 @@ int32_t file_close(int32_t fd);
 
 /* 
  * file_write
- *  DESCRIPTION: Function to write to the file 
+ *  DESCRIPTION: Function to write to the file at its position
  *  INPUTS: fd - file descriptor (index into file array to find file to write into)
  *          buf - contains data to write into file
  *          nbytes - number of bytes to write into file
  *  OUTPUTS: none
- *  RETURN VALUE: -1 always (because we have a read only file system; cannot write)
- *  SIDE EFFECT: None, because we have a read only file system
+ *  RETURN VALUE: number of bytes written, -1 on failure (read-only image, or no free data block for the first byte)
+ *  SIDE EFFECT: Writes through write_data and moves the position past what was written
  */
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes);
 
+/* 
+ * write_data
+ *  DESCRIPTION: Function to write into a file, growing it as needed
+ *  INPUTS: inode - index node number of the file to write to
+ *          offset - position offset in the file to begin writing at (may be past the end)
+ *          buf - data to write
+ *          length - number of bytes to write
+ *  OUTPUTS: none
+ *  RETURN VALUE: number of bytes written (fewer than length if the data blocks ran out), -1 on failure
+ *  SIDE EFFECT: Takes zeroed data blocks from the bitmap for any part of the file that had none, so a gap
+ *               left by writing past the end reads back as zeros; updates the file length
+ */
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+
+/* 
+ * file_truncate
+ *  DESCRIPTION: Function to set the length of a file
+ *  INPUTS: inode - index node number of the file
+ *          length - new length in bytes, shorter or longer
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, -1 on failure (read-only image, bad inode, too long, or no free data blocks)
+ *  SIDE EFFECT: Frees the data blocks past the new end, or takes zeroed ones to extend the file
+ */
+int32_t file_truncate(uint32_t inode, uint32_t length);
+
+/* 
+ * file_create
+ *  DESCRIPTION: Function to make an empty regular file, or empty the one already there (fs_lookup_lock held)
+ *  INPUTS: fname - name of the file (1 to 32 characters)
+ *  OUTPUTS: none
+ *  RETURN VALUE: the file's index node number, -1 on failure (read-only image, bad name, the name taken by
+ *                something other than a regular file, directory full, or no free index node)
+ *  SIDE EFFECT: Adds a dentry after the last one and takes an index node from the bitmap, or frees the
+ *               data blocks of the existing file
+ */
+int32_t file_create(const uint8_t* fname);
+
+/* 
+ * file_unlink
+ *  DESCRIPTION: Function to remove a regular file
+ *  INPUTS: fname - name of the file
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, -1 on failure (read-only image, no such name, not a regular file, or open)
+ *  SIDE EFFECT: Removes its dentry (the ones after it move up one) and frees its index node and data blocks
+ */
+int32_t file_unlink(const uint8_t* fname);
+
+/* 
+ * fs_lookup_lock, fs_lookup_unlock
+ *  DESCRIPTION: Hold the file system still across a name lookup and what is done with its result
+ *  INPUTS: none
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: open and create hold it from the name lookup until the file is open, so file_unlink
+ *               cannot free the index node in between. No file system call but file_create may be
+ *               made while held.
+ */
+void fs_lookup_lock(void);
+void fs_lookup_unlock(void);
+
 /* 
  * file_read
  *  DESCRIPTION: Function to read data from a file (calls read_data function within)
@@ -147,6 +237,31 @@ int32_t file_write(int32_t fd, const void* buf, int32_t nbytes);
  */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes);
 
+/* 
+ * file_pread
+ *  DESCRIPTION: Function to read data from a given offset of a file, leaving its position alone
+ *  INPUTS: fd - file descriptor (index into file array to find file to read from)
+ *          buf - buffer that stores data read from the file
+ *          nbytes - number of bytes to read from the file 
+ *          offset - byte offset into the file to start at
+ *  OUTPUTS: none
+ *  RETURN VALUE: number of bytes read from the file (0 if offset is at or beyond end of file), -1 on failure
+ *  SIDE EFFECT: none
+ */
+int32_t file_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+
+/* 
+ * file_lseek
+ *  DESCRIPTION: Function to move the position of an open file
+ *  INPUTS: fd - file descriptor (index into file array to find file to seek in)
+ *          offset - bytes to move by
+ *          whence - SEEK_SET, SEEK_CUR or SEEK_END (offset from the start, the position or the end of the file)
+ *  OUTPUTS: none
+ *  RETURN VALUE: the new position, -1 if whence is unknown or the position would be negative
+ *  SIDE EFFECT: Every descriptor sharing the open file sees the new position. Past the end is allowed; reads there return 0.
+ */
+int32_t file_lseek(int32_t fd, int32_t offset, int32_t whence);
+
 ////////////////////// CHECKPOINT 2 don't have to implement file descriptor and file array yet ////////////////////////////////////////
 /* 
  * directory_open()
@@ -195,6 +310,54 @@ int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes);
  */
 int32_t directory_read(int32_t fd, void* buf, int32_t nbytes);
 
+/*
+ * directory_pread()
+ *  DESCRIPTION: Function to read the file name of a given directory entry, leaving the directory's position alone
+ *  INPUTS: fd - file descriptor of the open directory
+ *          buf - buffer to store the file name (up to 32 bytes)
+ *          nbytes - number of bytes to read 
+ *          offset - directory entry index (the position directory_read would be at)
+ *  OUTPUTS: none
+ *  RETURN VALUE: number of bytes read (0 if offset is at or beyond end of directory entries)
+ *  SIDE EFFECT: none
+ */
+int32_t directory_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+
+/*
+ * directory_lseek()
+ *  DESCRIPTION: Function to move the position of an open directory
+ *  INPUTS: fd - file descriptor of the open directory
+ *          offset - entries to move by
+ *          whence - SEEK_SET, SEEK_CUR or SEEK_END (offset from the first entry, the position or past the last entry)
+ *  OUTPUTS: none
+ *  RETURN VALUE: the new position (an entry index), -1 if whence is unknown or the position would be negative
+ *  SIDE EFFECT: SEEK_SET with offset 0 rewinds the directory for another pass
+ */
+int32_t directory_lseek(int32_t fd, int32_t offset, int32_t whence);
+
+/*
+ * directory_getdents()
+ *  DESCRIPTION: Function to read as many directory entries as fit in a buffer, with their type, inode and length
+ *  INPUTS: fd - file descriptor of the open directory
+ *          buf - buffer to fill with dirent_t records
+ *          nbytes - size of buf in bytes
+ *  OUTPUTS: none
+ *  RETURN VALUE: bytes filled (a multiple of sizeof(dirent_t)), 0 past the last entry, -1 if not even one record fits
+ *  SIDE EFFECT: Moves the directory's position past the entries returned, so directory_read and getdents share it
+ */
+int32_t directory_getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+
+/*
+ * file_stat
+ *  DESCRIPTION: Function to describe a file for stat and fstat
+ *  INPUTS: file_type - the file's type, inode - its index node number (used for regular files)
+ *          buf - stat_t to fill
+ *  OUTPUTS: none
+ *  RETURN VALUE: 0 on success, -1 if a regular file's inode number is out of range
+ *  SIDE EFFECT: Fills buf with the type, inode number, and the length and block count from the index node
+ */
+int32_t file_stat(uint32_t file_type, uint32_t inode, stat_t* buf);
+
 
 
 
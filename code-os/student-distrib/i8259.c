@@ -4,6 +4,7 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "apic.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask = 0xFF; /* IRQs 0-7  */
@@ -42,6 +43,11 @@ void enable_irq(uint32_t irq_num) {
     if (irq_num > MAX_IRQ_NUM) {
         return;
     }
+    //the IOAPIC takes over once apic_init has run
+    if (apic_enabled) {
+        ioapic_enable_irq(irq_num);
+        return;
+    }
     //slave PIC's IRQ
     if (irq_num >= PIC_IRQ_NUM) {
         slave_mask &= ~(1 << (irq_num - PIC_IRQ_NUM));
@@ -62,6 +68,10 @@ void disable_irq(uint32_t irq_num) {
     if (irq_num > MAX_IRQ_NUM) {
         return;
     }
+    if (apic_enabled) {
+        ioapic_disable_irq(irq_num);
+        return;
+    }
     //slave PIC's IRQ
     if (irq_num >= PIC_IRQ_NUM) {
         slave_mask |= (1 << (irq_num - PIC_IRQ_NUM));
@@ -81,6 +91,11 @@ void send_eoi(uint32_t irq_num) {
     if (irq_num > 15) {
         return;
     }
+    //one store to the local APIC instead of port I/O
+    if (apic_enabled) {
+        lapic_eoi();
+        return;
+    }
     //slave PIC's IRQ
     if (irq_num > 7) {
         //send EOI to slave PIC
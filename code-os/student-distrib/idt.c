@@ -5,9 +5,11 @@
 #include "keyboard.h"
 #include "rtc.h"
 #include "asm_linkage.h"
-
+#include "trace.h"
 #include "systemcall.h" 
 
+volatile uint32_t irq_counts[NUM_IRQS];
+
 /*
  * idt_init()
  *  DESCRIPTION: Function to iniitialize and populate the IDT with entries 
@@ -89,6 +91,11 @@ void idt_init(){
     idt[0x28].present = 1;              // Set present bit to 1 (to signify valid descriptor)
     idt[0x28].reserved3 = 0;            // interrupt, so set to 0
 
+    // ATA setup (vector 0x2E, IRQ14 on secondary PIC for the primary IDE channel)
+    SET_IDT_ENTRY(idt[0x2E], ata_handler_asm);
+    idt[0x2E].present = 1;              // Set present bit to 1 (to signify valid descriptor)
+    idt[0x2E].reserved3 = 0;            // interrupt, so set to 0
+
     // System Call setup (vector 0x80)
     SET_IDT_ENTRY(idt[0x80], system_call_handler_asm);
     idt[0x80].present = 1;              // Set present bit to 1 (to signify valid descriptor)
@@ -98,4 +105,38 @@ void idt_init(){
     SET_IDT_ENTRY(idt[0x20], pit_handler_asm);
     idt[0x20].present = 1;              // Set present bit to 1 (to signify valid descriptor)
     idt[0x20].reserved3 = 0;            // interrupt, so set to 0
+
+    // LAPIC timer (vector 0x30), wakeup IPI (vector 0x31) and spurious (vector 0xFF), used when apic_init finds an APIC
+    SET_IDT_ENTRY(idt[0x30], lapic_timer_handler_asm);
+    idt[0x30].present = 1;
+    idt[0x30].reserved3 = 0;
+    SET_IDT_ENTRY(idt[0x31], sched_ipi_asm);
+    idt[0x31].present = 1;
+    idt[0x31].reserved3 = 0;
+    SET_IDT_ENTRY(idt[0xFF], apic_spurious_asm);
+    idt[0xFF].present = 1;
+    idt[0xFF].reserved3 = 0;
+}
+
+/*
+ * irq_enter(), irq_exit()
+ *  DESCRIPTION: Bookkeeping hooks called by the hardware interrupt linkage (asm_linkage.S)
+ *               before and after the device handler runs
+ *  INPUTS: irq - IRQ line of the interrupt being handled
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: Counts the interrupt and records irq entry/exit tracepoints
+ *               (except for the timer, which would flood the trace ring)
+ */
+void irq_enter(uint32_t irq){
+    irq_counts[irq]++;
+    if(irq != TIMER_IRQ){
+        TRACE(TRACE_IRQ_ENTER, irq, 0);
+    }
+}
+
+void irq_exit(uint32_t irq){
+    if(irq != TIMER_IRQ){
+        TRACE(TRACE_IRQ_EXIT, irq, 0);
+    }
 }
@@ -4,13 +4,24 @@
 #include "x86_desc.h"
 #include "lib.h"
 #include "lib.h"
-#include "exception_handler.h"
 #include "asm_linkage.h"
 #include "asm_linkage.h"
 // #include "system_call.h"
 // #include "keyboard.h"
 // #include "rtc.h"
 
+/* Interrupted context pushed by the CPU, as handed to device handlers by asm_linkage.S */
+typedef struct {
+    uint32_t eip;
+    uint32_t cs;
+    uint32_t eflags;
+    uint32_t esp;               // esp and ss only when IRQ_FROM_USER
+    uint32_t ss;
+} irq_frame_t;
+
+/* Nonzero if the interrupt arrived while running user code (CPL 3) */
+#define IRQ_FROM_USER(frame)    (((frame)->cs & 0x3) == 0x3)
+
 /*
  * idt_init()
  *  DESCRIPTION: Function to iniitialize and populate the IDT with entries 
@@ -22,4 +33,23 @@
  */
 void idt_init();
 
+/*
+ * irq_enter(), irq_exit()
+ *  DESCRIPTION: Bookkeeping hooks called by the hardware interrupt linkage (asm_linkage.S)
+ *               before and after the device handler runs
+ *  INPUTS: irq - IRQ line of the interrupt being handled
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: Counts the interrupt and records irq entry/exit tracepoints
+ *               (except for the timer, which would flood the trace ring)
+ */
+#define NUM_IRQS        16      // lines on the two cascaded 8259s
+#define TIMER_IRQ       0       // PIT
+
+/* Interrupts taken per IRQ line since boot (counted by irq_enter) */
+extern volatile uint32_t irq_counts[NUM_IRQS];
+
+void irq_enter(uint32_t irq);
+void irq_exit(uint32_t irq);
+
 #endif
@@ -0,0 +1,79 @@
+/* io_ring.c - Submission and completion rings (io_setup, io_enter)
+ * vim:ts=4 noexpandtab
+ */
+
+#include "io_ring.h"
+#include "lib.h"
+
+#define USER_PAGE_START     ADDRESS_128MB
+#define USER_PAGE_END       (ADDRESS_128MB + ADDRESS_4MB)
+
+/*
+ * io_ring_setup
+ *   DESCRIPTION: The io_setup system call
+ *   INPUTS: pcb - the caller, ring - in its user page, NULL to drop the ring it has
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the ring is not all inside the user page
+ *   SIDE EFFECTS: Starts the ring empty
+ */
+int32_t io_ring_setup(pcb_struct* pcb, io_ring_t* ring){
+    uint32_t addr = (uint32_t)ring;
+
+    if(ring == NULL){
+        pcb->io_ring = 0;
+        return 0;
+    }
+    if(addr < USER_PAGE_START || addr > USER_PAGE_END - sizeof(io_ring_t) || (addr & 3) != 0){
+        return -1;
+    }
+    ring->sq_head = ring->sq_tail = 0;
+    ring->cq_head = ring->cq_tail = 0;
+    pcb->io_ring = addr;
+    return 0;
+}
+
+/*
+ * io_ring_enter
+ *   DESCRIPTION: Run queued requests and post their results
+ *   INPUTS: ring - the ring, to_submit - most requests to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of requests run, -1 if the ring's counters are
+ *                 inconsistent (more queued than it holds)
+ *   SIDE EFFECTS: Advances sq_head and cq_tail
+ */
+int32_t io_ring_enter(io_ring_t* ring, uint32_t to_submit){
+    uint32_t sq_tail = ring->sq_tail;
+    uint32_t submitted = 0;
+    io_sqe_t sqe;
+    io_cqe_t* cqe;
+    int32_t result;
+
+    if(sq_tail - ring->sq_head > IO_RING_ENTRIES || ring->cq_tail - ring->cq_head > IO_RING_ENTRIES){
+        return -1;
+    }
+
+    while(submitted < to_submit && ring->sq_head != sq_tail){
+        if(ring->cq_tail - ring->cq_head == IO_RING_ENTRIES){
+            break;                          // no room for the result
+        }
+        sqe = ring->sq[ring->sq_head & (IO_RING_ENTRIES - 1)];
+        ring->sq_head++;
+
+        switch(sqe.op){
+            case IO_OP_NOP:   result = 0; break;
+            case IO_OP_READ:  result = read(sqe.fd, sqe.buf, sqe.nbytes); break;
+            case IO_OP_WRITE: result = write(sqe.fd, sqe.buf, sqe.nbytes); break;
+            case IO_OP_OPEN:  result = (sqe.buf == NULL) ? -1 : open(sqe.buf); break;
+            case IO_OP_CLOSE: result = close(sqe.fd); break;
+            case IO_OP_PREAD: result = pread(sqe.fd, sqe.buf, sqe.nbytes, sqe.offset); break;
+            default:          result = -1; break;
+        }
+
+        cqe = &ring->cq[ring->cq_tail & (IO_RING_ENTRIES - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->result = result;
+        ring->cq_tail++;
+        submitted++;
+    }
+    return submitted;
+}
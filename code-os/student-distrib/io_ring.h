@@ -0,0 +1,75 @@
+/* io_ring.h - Submission and completion rings (io_setup, io_enter)
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IO_RING_H
+#define _IO_RING_H
+
+#include "types.h"
+#include "systemcall.h"
+
+/* A process hands io_setup a ring in its own user page. It queues requests
+ * by filling sq[sq_tail % IO_RING_ENTRIES] and advancing sq_tail, then one
+ * io_enter runs them in order, each as the system call it names would, and
+ * posts each result at cq[cq_tail % IO_RING_ENTRIES]. The process takes
+ * results from cq_head. Head and tail count up forever; only the kernel
+ * moves sq_head and cq_tail, only the process sq_tail and cq_head. A
+ * request is copied out of the ring before it runs, so changing the ring
+ * meanwhile cannot change a request half way. io_enter stops early when
+ * the completion ring is full. Requests run in the caller, so one that
+ * blocks (a terminal or rtc read) blocks io_enter. */
+
+#define IO_RING_ENTRIES         32          // a power of 2
+
+#define IO_OP_NOP               0           // result 0
+#define IO_OP_READ              1           // fd, buf, nbytes
+#define IO_OP_WRITE             2           // fd, buf, nbytes
+#define IO_OP_OPEN              3           // buf is the file name
+#define IO_OP_CLOSE             4           // fd
+#define IO_OP_PREAD             5           // fd, buf, nbytes, offset
+
+typedef struct {
+    uint32_t op;                // IO_OP_*
+    int32_t fd;
+    void* buf;
+    int32_t nbytes;
+    uint32_t offset;
+    uint32_t user_data;         // handed back in the completion
+} io_sqe_t;
+
+typedef struct {
+    uint32_t user_data;
+    int32_t result;             // what the system call returned; -1 for an unknown op
+} io_cqe_t;
+
+typedef struct {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    io_sqe_t sq[IO_RING_ENTRIES];
+    io_cqe_t cq[IO_RING_ENTRIES];
+} io_ring_t;
+
+/*
+ * io_ring_setup
+ *   DESCRIPTION: The io_setup system call
+ *   INPUTS: pcb - the caller, ring - in its user page, NULL to drop the ring it has
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the ring is not all inside the user page
+ *   SIDE EFFECTS: Starts the ring empty
+ */
+int32_t io_ring_setup(pcb_struct* pcb, io_ring_t* ring);
+
+/*
+ * io_ring_enter
+ *   DESCRIPTION: Run queued requests and post their results
+ *   INPUTS: ring - the ring, to_submit - most requests to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of requests run, -1 if the ring's counters are
+ *                 inconsistent (more queued than it holds)
+ *   SIDE EFFECTS: Advances sq_head and cq_tail
+ */
+int32_t io_ring_enter(io_ring_t* ring, uint32_t to_submit);
+
+#endif /* _IO_RING_H */
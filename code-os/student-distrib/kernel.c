@@ -15,6 +15,13 @@
 #include "file_system.h"
 #include "systemcall.h"
 #include "terminal.h"
+#include "pit.h"
+#include "apic.h"
+#include "smp.h"
+#include "sched.h"
+#include "signal.h"
+#include "ata.h"
+#include "bcache.h"
 
 
 #define RUN_TESTS
@@ -48,8 +55,10 @@ void entry(unsigned long magic, unsigned long addr) {
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
 
     /* Are mem_* valid? */
-    if (CHECK_FLAG(mbi->flags, 0))
+    if (CHECK_FLAG(mbi->flags, 0)) {
         printf("mem_lower = %uKB, mem_upper = %uKB\n", (unsigned)mbi->mem_lower, (unsigned)mbi->mem_upper);
+        phys_mem_kb = 1024 + mbi->mem_upper;    // mem_upper counts from 1MB
+    }
 
     /* Is boot_device valid? */
     if (CHECK_FLAG(mbi->flags, 1))
@@ -158,6 +167,13 @@ void entry(unsigned long magic, unsigned long addr) {
     // Initialize paging
     paging_init();
 
+    // Route interrupts through the IOAPIC/LAPIC when the firmware lists them (the 8259 stays otherwise)
+    if (apic_init() == 0)
+        printf("APIC: %d CPU(s)\n", apic_cpu_count);
+
+    // Enable SSE2 for large memcpy/memset (no-op on CPUs without it)
+    sse_init();
+
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
 
@@ -167,6 +183,16 @@ void entry(unsigned long magic, unsigned long addr) {
     // Initialize the rtc
     rtc_init();
 
+    // Start the 100 Hz timer tick (CPU time accounting, profiler), LAPIC timer if there is one
+    pit_init();
+
+    // Start the other processors; each idles until the scheduler queues a terminal on it
+    printf("SMP: %d CPU(s) online\n", smp_init());
+
+    // Find the IDE disks; file_system_init looks for a file system image on them
+    printf("ATA: %d drive(s)\n", ata_init());
+    bcache_init();
+
     // Initialize the file system
     file_system_init();
 
@@ -175,6 +201,9 @@ void entry(unsigned long magic, unsigned long addr) {
 
     //init terminal
     terminal_init();
+
+    // Start the timer that raises SIG_ALARM
+    signal_init();
     
 
     /* Enable interrupts */
@@ -191,9 +220,9 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Execute the first program ("shell") ... */
     if(!RTC_test_enable){
         printf("\nTerminal 1:\n");
-        execute((const uint8_t*) "shell");
+        sched_start(&terminal_array[0]);
     }
 
-    /* Spin (nicely, so we don't chew up cycles) */
-    asm volatile (".1: hlt; jmp .1;");
+    /* Run tasks as they are queued, halting in between */
+    cpu_idle();
 }
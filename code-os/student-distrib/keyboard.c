@@ -2,6 +2,8 @@
 #include "terminal.h"
 #include "i8259.h"
 #include "lib.h"
+#include "sched.h"
+#include "signal.h"
 
 #define KEYBOARD_IRQ 1          // IRQ number for keyboard
 #define KEY_NUM 58              // 58 of keys as keys after 0x3A, such as F1, F2, are not used
@@ -39,6 +41,12 @@
 #define F3_KEY 0x3D            // scancode for F3
 #define F3_RELEASED 0xBD       // scancode for F3 released
 
+#define PAGE_UP_KEY 0x49        // scancode for page up
+#define PAGE_DOWN_KEY 0x51      // scancode for page down
+#define EXTENDED_PREFIX 0xE0    // comes before the scancodes of the gray keys
+#define RELEASED_BIT 0x80       // set in the scancode of a released key
+#define SCROLL_PAGE (NUM_ROWS/2)    // rows Shift+PgUp/PgDn scroll by
+
 unsigned char scancode_key[KEY_NUM][2] =                // store the characters for each key and its shifted key
 { {0x0,0x0} , {0x0,0x0} , {'1','!'} ,{'2','@'} ,{'3','#'} , // 0x0 means do nothing
   {'4','$'} , {'5','%'} , {'6','^'} , {'7','&'} ,
@@ -64,6 +72,7 @@ uint8_t CONTROL_PRESSED     = 0;            // 1 if CONTROL is pressed, 0 otherw
 uint8_t SHIFT_PRESSED       = 0;            // 1 if SHIFT is pressed, 0 otherwise
 uint8_t ESC_PRESSED         = 0;            // 1 if ESC is pressed, 0 otherwise
 uint8_t ALT_PRESSED         = 0;            // 1 if ALT is pressed, 0 otherwise
+uint8_t EXTENDED_PENDING    = 0;            // 1 if the last scancode was EXTENDED_PREFIX, 0 otherwise
 int i;
 
 /*
@@ -84,6 +93,7 @@ void keyboard_init(){
     SHIFT_PRESSED       = 0;            // 1 if SHIFT is pressed, 0 otherwise
     ESC_PRESSED         = 0;            // 1 if ESC is pressed, 0 otherwise
     ALT_PRESSED         = 0;            // 1 if ALT is pressed, 0 otherwise
+    EXTENDED_PENDING    = 0;            // 1 if the last scancode was EXTENDED_PREFIX, 0 otherwise
 }
 
 
@@ -97,7 +107,6 @@ void keyboard_init(){
  */
 
 uint8_t special_status_key(uint8_t key){
-    char*  buffer = current_terminal->command;
     switch(key){                            // determine the key pressed
         case ESC_KEY:
             ESC_PRESSED = 1;                // set ESC_PRESSED if esc is pressed
@@ -139,21 +148,7 @@ uint8_t special_status_key(uint8_t key){
             ALT_PRESSED = 0;                // set ALT_PRESSED if alt is released
             return 1;
         case BACKSPACE_KEY:
-            if(current_terminal->command_idx!=0){              // if buffer is not at 0
-                if(buffer[current_terminal->command_idx-1]=='\t'){
-                    putc('\b');                 // delete a character
-                    putc('\b');                 // delete a character
-                    putc('\b');                 // delete a character
-                    putc('\b');                 // delete a character
-                    // terminal_store_char('\b'); 
-                }
-                else{
-                    putc('\b');                 // delete a character
-                    // terminal_store_char('\b'); 
-                }
-                current_terminal->command_idx--;               // decrement the buffer index
-                buffer[current_terminal->command_idx] = '\0'; 
-            }                         
+            terminal_store_char(current_terminal, '\b');     // delete a character (raw mode: hand it to the reader)
             return 1;
         // case TAB_KEY:
         //     putc('\t');                     // print tab
@@ -178,99 +173,97 @@ uint8_t special_status_key(uint8_t key){
  *  SIDE EFFECT: Print the typed-key on the screen and store characters in buffer
  */
 void keyboard_handler(void) {
-    cli();
-    char*  buffer = current_terminal->command;
+    uint32_t flags;
+    spin_lock_irqsave(&console_lock, flags);   // the line buffer and screen are shared with terminal_read/write on other CPUs
+    char c;
     uint8_t scancode = inb(KEYBOARD_PORT);              // get the scancode from keyboard
+    if(scancode == EXTENDED_PREFIX){                    // a gray key's scancode follows
+        EXTENDED_PENDING = 1;
+        send_eoi(KEYBOARD_IRQ);     // end of interrupt
+        spin_unlock_irqrestore(&console_lock, flags);
+        return;
+    }
+    if(EXTENDED_PENDING){
+        EXTENDED_PENDING = 0;
+        // the keyboard wraps gray keys in a fake shift release and press while shift is held; keep the real state
+        if((scancode & ~RELEASED_BIT) == LEFT_SHIFT_KEY || (scancode & ~RELEASED_BIT) == RIGHT_SHIFT_KEY){
+            send_eoi(KEYBOARD_IRQ);     // end of interrupt
+            spin_unlock_irqrestore(&console_lock, flags);
+            return;
+        }
+    }
     if(special_status_key(scancode)==1){                // if the scancode is special key
         send_eoi(KEYBOARD_IRQ);     // end of interrupt
-        sti();
+        spin_unlock_irqrestore(&console_lock, flags);
         return;                                         // don't print it
     }
     if(ALT_PRESSED){                    //switch terminals ALT+F1 or F2 or F3
         if(scancode == F1_KEY){
             switch_terminal(1);
             send_eoi(KEYBOARD_IRQ);     // end of interrupt
-            sti();
+            spin_unlock_irqrestore(&console_lock, flags);
             return;
         }
         else if(scancode == F2_KEY){
             switch_terminal(2);
             send_eoi(KEYBOARD_IRQ);     // end of interrupt
-            sti();
+            spin_unlock_irqrestore(&console_lock, flags);
             return;
         }
         else if(scancode == F3_KEY){
             switch_terminal(3);
             send_eoi(KEYBOARD_IRQ);     // end of interrupt
-            sti();
+            spin_unlock_irqrestore(&console_lock, flags);
             return;
         }
     }
 
+    if(SHIFT_PRESSED && (scancode == PAGE_UP_KEY || scancode == PAGE_DOWN_KEY)){     // Shift+PgUp/PgDn: scrollback
+        terminal_scroll(current_terminal, (scancode == PAGE_UP_KEY) ? SCROLL_PAGE : -SCROLL_PAGE);
+        send_eoi(KEYBOARD_IRQ);     // end of interrupt
+        spin_unlock_irqrestore(&console_lock, flags);
+        return;
+    }
+
     if(scancode>=KEY_NUM){
         send_eoi(KEYBOARD_IRQ);     // end of interrupt
-        sti();
+        spin_unlock_irqrestore(&console_lock, flags);
         return;                     // if not print, do nothing
     }
     if(CONTROL_PRESSED){                                
         if(scancode_key[scancode][0]=='l'){             // if control+l is pressed
-            clear();                                    // clear video memory
+            terminal_scroll(current_terminal, -current_terminal->scroll_view);  // back to the live screen
+            screen_clear(&current_terminal->screen);    // clear video memory
             send_eoi(KEYBOARD_IRQ);     // end of interrupt
-            sti();
+            spin_unlock_irqrestore(&console_lock, flags);
             return;
         }
-    }
-    if(current_terminal->command_idx >= BUFFER_SIZE-1){
-        if(scancode_key[scancode][0] == '\n'){
-            // terminal_store_char('\n');
-            buffer[current_terminal->command_idx] = '\n';
-            current_terminal->command_idx++;                     // next line -> buffer starts over
-            current_terminal->enter_flag = 1;
-            putc('\n');                 // print new line
+        if(scancode_key[scancode][0]=='c'){             // if control+c is pressed
+            if(current_terminal->number_of_processes > 1){      // not the terminal's own shell
+                signal_send(current_terminal->curr_pcb_ptr, SIG_INTERRUPT);     // interrupt its program
+            }
+            send_eoi(KEYBOARD_IRQ);     // end of interrupt
+            spin_unlock_irqrestore(&console_lock, flags);
+            return;
         }
-        send_eoi(KEYBOARD_IRQ);     // end of interrupt
-        sti();
-        return;                     // print nothing when buffer is full
     }
-    if(scancode_key[scancode][0] == '\n'){
-        // terminal_store_char('\n');
-        buffer[current_terminal->command_idx] = '\n';          // store the char into buffer
-        current_terminal->command_idx++;                     // next line -> buffer starts over
-        current_terminal->enter_flag = 1;
-        putc('\n');                 // print new line
-        send_eoi(KEYBOARD_IRQ);     // end of interrupt
-        sti();
-        return;
-    }
-    
     if('a' <= scancode_key[scancode][0] && scancode_key[scancode][0] <= 'z'){       // if the key is letter
         if(SHIFT_PRESSED){
-            buffer[current_terminal->command_idx] = scancode_key[scancode][1^CAPS_LOCK_STAT];          // store the char into buffer
-            // terminal_store_char(buffer[buffer_idx]);
-            putc(buffer[current_terminal->command_idx]);                         // only print opposite case 
-            current_terminal->command_idx++;                                                           // increase buffer index
+            c = scancode_key[scancode][1^CAPS_LOCK_STAT];   // only print opposite case
         }
         else if(CAPS_LOCK_STAT){
-            buffer[current_terminal->command_idx] = scancode_key[scancode][1];          // store the char into buffer
-            // terminal_store_char(buffer[buffer_idx]);
-            putc(buffer[current_terminal->command_idx]);                         // only print upper case 
-            current_terminal->command_idx++;                                            // increase buffer index
+            c = scancode_key[scancode][1];                  // only print upper case
         }
         else{
-            buffer[current_terminal->command_idx] = scancode_key[scancode][0];          // store the char into buffer
-            // terminal_store_char(buffer[buffer_idx]);
-            putc(buffer[current_terminal->command_idx]);                         // only print lower case 
-            current_terminal->command_idx++;                                            // increase buffer index
+            c = scancode_key[scancode][0];                  // only print lower case
         }
     }
     else{
-        if(scancode_key[scancode][0]!= 0x0){
-            buffer[current_terminal->command_idx] = scancode_key[scancode][SHIFT_PRESSED];          // store the char into buffer
-            // terminal_store_char(buffer[buffer_idx]);
-            putc(buffer[current_terminal->command_idx]);                         // only print character according to shift status 
-            current_terminal->command_idx++;                                                       // increase buffer index
-        }
+        c = scancode_key[scancode][SHIFT_PRESSED];          // character according to shift status
+    }
+    if(c != 0x0){
+        terminal_store_char(current_terminal, c);           // edit the line, or hand it to the reader in raw mode
     }
     send_eoi(KEYBOARD_IRQ);     // end of interrupt
-    sti();
+    spin_unlock_irqrestore(&console_lock, flags);
 }
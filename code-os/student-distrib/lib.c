@@ -4,13 +4,25 @@
 #include "lib.h"
 
 #define VIDEO       0xB8000
-#define NUM_COLS    80
-#define NUM_ROWS    25
 #define ATTRIB      0x7
 
-static int screen_x;
-static int screen_y;
+/* Large copies/fills take the SSE2 streaming path (see sse_init) */
+#define SSE_COPY_THRESHOLD      2048        // bytes; below this rep movsl/stosl wins
+#define SSE_BLOCK_SIZE          64          // bytes moved per loop iteration (4 xmm)
+#define SSE_ALIGN               16          // movntdq needs a 16-byte aligned target
+#define SSE_SAVE_SIZE           64          // room for the 4 xmm registers we borrow
+#define SSE_CHUNK_BLOCKS        64          // blocks (4kB) moved per interrupts-off stretch
+#define CPUID_FEATURES_LEAF     1
+#define CPUID_EDX_SSE2          0x04000000  // CPUID.1:EDX bit 26
+#define CR0_MP                  0x00000002
+#define CR0_CLEAR_EM_TS         0xFFFFFFF3  // clear CR0.EM (bit 2) and CR0.TS (bit 3)
+#define CR4_OSFXSR_OSXMMEXCPT   0x00000600  // CR4 bits 9 and 10
+
 static char* video_mem = (char *)VIDEO;
+static screen_t boot_screen = { (char *)VIDEO, 0, 0, 1, NULL };
+screen_t* console = &boot_screen;
+spinlock_t console_lock = SPINLOCK_INIT;
+static int32_t sse_enabled = 0;
 
 /* void enable_cursor(uint8_t cursor_start, uint8_t cursor_end)
  * Enable the cursor with spanline limited from start to end row
@@ -85,14 +97,22 @@ void update_cursor(int x, int y){
  * Return Value: none
  * Function: Clears video memory */
 void clear(void) {
-    int32_t i;
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
-    }
-    screen_x = 0;
-    screen_y = 0;
-    update_cursor(screen_x, screen_y);
+    uint32_t flags;
+    spin_lock_irqsave(&console_lock, flags);
+    screen_clear(console);
+    spin_unlock_irqrestore(&console_lock, flags);
+}
+
+/* void screen_clear(screen_t* screen);
+ * Inputs: screen - screen to clear
+ * Return Value: none
+ * Function: Blank a screen and home its cursor; the caller holds console_lock */
+void screen_clear(screen_t* screen) {
+    memset_word(screen->video, (ATTRIB << 8) | ' ', NUM_ROWS * NUM_COLS);
+    screen->x = 0;
+    screen->y = 0;
+    if (screen->shown)
+        update_cursor(screen->x, screen->y);
 }
 
 
@@ -222,6 +242,117 @@ format_char_switch:
     return (buf - format);
 }
 
+/* static void buf_putc(int8_t* buf, uint32_t size, uint32_t* len, int8_t c);
+ * Inputs: buf/size = destination buffer and its capacity (including NUL)
+ *         len = characters produced so far, c = character to append
+ * Return Value: none
+ * Function: appends c if it still fits; len counts every character so the
+ *           caller can tell the output was truncated */
+static void buf_putc(int8_t* buf, uint32_t size, uint32_t* len, int8_t c) {
+    if (*len + 1 < size)
+        buf[*len] = c;
+    (*len)++;
+}
+
+/* int32_t snprintf(int8_t* buf, uint32_t size, int8_t* format, ...);
+ * Inputs: int8_t* buf = destination buffer
+ *         uint32_t size = capacity of buf, including the terminating NUL
+ *         int8_t* format = format string, same conversions as printf()
+ * Return Value: number of characters written to buf (excluding the NUL)
+ * Function: printf() into a buffer, used by the kernel pseudo-files to render
+ *           text. A decimal field width may precede d, u, x and s (for
+ *           example "%6u" or "%-10s"): numbers are right-justified, strings
+ *           left-justified. Output beyond size - 1 characters is dropped. */
+int32_t snprintf(int8_t* buf, uint32_t size, int8_t* format, ...) {
+    int8_t* fmt = format;
+    int32_t* esp = (void *)&format;
+    uint32_t len = 0;
+    esp++;
+
+    while (*fmt != '\0') {
+        if (*fmt != '%') {
+            buf_putc(buf, size, &len, *fmt++);
+            continue;
+        }
+        fmt++;
+        {
+            int32_t alternate = 0;
+            uint32_t width = 0;
+            int8_t conv_buf[36];
+            int8_t* out = conv_buf;
+            uint32_t out_len;
+            int8_t conv;
+
+            if (*fmt == '#') {
+                alternate = 1;
+                fmt++;
+            }
+            if (*fmt == '-')                        // strings are always left-justified
+                fmt++;
+            while (*fmt >= '0' && *fmt <= '9')
+                width = width * 10 + (*fmt++ - '0');
+
+            conv = *fmt;
+            if (conv != '\0')
+                fmt++;
+
+            switch (conv) {
+                case 'x':
+                    itoa(*((uint32_t *)esp), conv_buf, 16);
+                    if (alternate)
+                        width = 8;                  // %#x: 8 digits, zero padded
+                    esp++;
+                    break;
+                case 'u':
+                    itoa(*((uint32_t *)esp), conv_buf, 10);
+                    esp++;
+                    break;
+                case 'd':
+                    if (*esp < 0) {
+                        conv_buf[0] = '-';
+                        itoa(-*esp, &conv_buf[1], 10);
+                    } else {
+                        itoa(*esp, conv_buf, 10);
+                    }
+                    esp++;
+                    break;
+                case 'c':
+                    conv_buf[0] = (int8_t)*esp;
+                    conv_buf[1] = '\0';
+                    esp++;
+                    break;
+                case 's':
+                    out = *((int8_t **)esp);
+                    esp++;
+                    break;
+                case '%':
+                    conv_buf[0] = '%';
+                    conv_buf[1] = '\0';
+                    break;
+                default:
+                    conv_buf[0] = '\0';
+                    break;
+            }
+            out_len = strlen(out);
+            if (conv == 's') {
+                while (*out != '\0')
+                    buf_putc(buf, size, &len, *out++);
+                for (; out_len < width; out_len++)
+                    buf_putc(buf, size, &len, ' ');
+            } else {
+                for (; out_len < width; width--)
+                    buf_putc(buf, size, &len, alternate ? '0' : ' ');
+                while (*out != '\0')
+                    buf_putc(buf, size, &len, *out++);
+            }
+        }
+    }
+
+    if (size > 0)
+        buf[(len < size) ? len : size - 1] = '\0';
+    return (len < size) ? len : size - 1;
+}
+
 /* int32_t puts(int8_t* s);
  *   Inputs: int_8* s = pointer to a string of characters
  *   Return Value: Number of bytes written
@@ -240,56 +371,67 @@ int32_t puts(int8_t* s) {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
+    uint32_t flags;
+    spin_lock_irqsave(&console_lock, flags);
+    screen_putc(console, c);
+    spin_unlock_irqrestore(&console_lock, flags);
+}
+
+/* void screen_putc(screen_t* screen, uint8_t c);
+ * Inputs: screen - screen to draw on, c = character to print
+ * Return Value: void
+ *  Function: Output a character to a screen; the caller holds console_lock */
+void screen_putc(screen_t* screen, uint8_t c) {
+    char* video = screen->video;
+
     if(c == '\n' || c == '\r') {                                        // if the character is new line or \r
-        screen_y++;                                                     // increase the y for cursor
-        screen_x = 0;
+        screen->y++;                                                    // increase the y for cursor
+        screen->x = 0;
     }
     else if(c == '\t'){                                                 // if the character is tab
         int i;                                                          // print 4 spaces
         for(i=0;i<4;i++){
-            putc(' ');
+            screen_putc(screen, ' ');
         }
+        return;
     }
     else if(c == '\b'){                                                 // if the character is backspace
-        if(screen_x==0){                                                
-            if(screen_y==0){                                            // if cursor is at (0,0), do nothing
-                return;     
+        if(screen->x==0){
+            if(screen->y==0){                                           // if cursor is at (0,0), do nothing
+                return;
             }
             else{                                                       // if cursor is at start of a line,
-                screen_x = NUM_COLS;                                    // return to last char at previous line
-                screen_y--;
+                screen->x = NUM_COLS;                                   // return to last char at previous line
+                screen->y--;
             }
         }
-        screen_x--;                                                     // go back to previous character
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) =' ';         // delete the word from video memory
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB; 
-        update_cursor(screen_x, screen_y);                              // update the cursor
+        screen->x--;                                                    // go back to previous character
+        *(uint8_t *)(video + ((NUM_COLS * screen->y + screen->x) << 1)) =' ';           // delete the word from video memory
+        *(uint8_t *)(video + ((NUM_COLS * screen->y + screen->x) << 1) + 1) = ATTRIB;
+        if(screen->shown)
+            update_cursor(screen->x, screen->y);                        // update the cursor
         return;
-    } 
+    }
     else {
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;          // write the character to video memory
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB; 
-        screen_x++;                                         // increment the cursor's x
-        screen_y = (screen_y + (screen_x / NUM_COLS));      // if reached end, increment cursor's y
-        screen_x %= NUM_COLS;                               // turn x's to start if go to next line
+        *(uint8_t *)(video + ((NUM_COLS * screen->y + screen->x) << 1)) = c;            // write the character to video memory
+        *(uint8_t *)(video + ((NUM_COLS * screen->y + screen->x) << 1) + 1) = ATTRIB;
+        screen->x++;                                        // increment the cursor's x
+        screen->y = (screen->y + (screen->x / NUM_COLS));   // if reached end, increment cursor's y
+        screen->x %= NUM_COLS;                              // turn x's to start if go to next line
     }
-    if(screen_y==NUM_ROWS){                                 // if reached last line
-        int x,y;                
-        for(y=0;y<NUM_ROWS;y++){                            // loop through all the positions above last line
-            for(x=0;x<NUM_COLS;x++){
-                if(y==NUM_ROWS-1){                          // clear the last line with spaces
-                    *(uint8_t *)(video_mem + ((NUM_COLS * y + x) << 1)) = ' ';
-                    *(uint8_t *)(video_mem + ((NUM_COLS * y + x) << 1) + 1) = ATTRIB;
-                }
-                else{                                       // update the lines above with words from next lines
-                    *(uint8_t *)(video_mem + ((NUM_COLS * y + x) << 1)) = video_mem[(NUM_COLS * (y+1) + x) << 1];
-                    *(uint8_t *)(video_mem + ((NUM_COLS * y + x) << 1) + 1) = ATTRIB;
-                }
-            }
+    if(screen->y==NUM_ROWS){                                // if reached last line
+        if(screen->history != NULL){                        // keep the top row before it goes
+            scrollback_t* history = screen->history;
+            memcpy(history->rows[history->saved++ & (SCROLLBACK_LINES - 1)], video, NUM_COLS << 1);
         }
-        screen_y--;                                         // set cursor's y to second line counting from last line
+        // shift rows 1..24 up by one row in a single block move
+        memmove(video, video + (NUM_COLS << 1), ((NUM_ROWS - 1) * NUM_COLS) << 1);
+        // clear the last line with spaces
+        memset_word(video + (((NUM_ROWS - 1) * NUM_COLS) << 1), (ATTRIB << 8) | ' ', NUM_COLS);
+        screen->y--;                                        // set cursor's y to second line counting from last line
     }
-    update_cursor(screen_x,screen_y);                       // update the cursor
+    if(screen->shown)
+        update_cursor(screen->x,screen->y);                 // update the cursor
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -360,14 +502,134 @@ uint32_t strlen(const int8_t* s) {
     return len;
 }
 
-/* void* memset(void* s, int32_t c, uint32_t n);
+/* void sse_init(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: turns on SSE (CR0.EM/TS clear, CR4.OSFXSR/OSXMMEXCPT set) when
+ *           CPUID reports SSE2, so large copies can take the streaming path */
+void sse_init(void) {
+    uint32_t features;
+    asm volatile ("cpuid"
+            : "=d"(features)
+            : "a"(CPUID_FEATURES_LEAF)
+            : "ebx", "ecx"
+    );
+    if (!(features & CPUID_EDX_SSE2))
+        return;                                         // plain rep movs/stos only
+
+    asm volatile ("                 \n\
+            movl    %%cr0, %%eax    \n\
+            andl    %0, %%eax       \n\
+            orl     %1, %%eax       \n\
+            movl    %%eax, %%cr0    \n\
+            movl    %%cr4, %%eax    \n\
+            orl     %2, %%eax       \n\
+            movl    %%eax, %%cr4    \n\
+            "
+            :
+            : "i"(CR0_CLEAR_EM_TS), "i"(CR0_MP), "i"(CR4_OSFXSR_OSXMMEXCPT)
+            : "eax", "memory", "cc"
+    );
+    sse_enabled = 1;
+}
+
+/* static void sse_copy_blocks(void* dest, const void* src, uint32_t blocks);
+ * Inputs:      void* dest = 16-byte aligned destination
+ *         const void* src = source, any alignment
+ *         uint32_t blocks = number of 64-byte blocks to copy (> 0)
+ * Return Value: none
+ * Function: streams 64-byte blocks with movntdq so big copies into video or
+ *           user memory do not evict the kernel's working set. The xmm
+ *           registers used are saved and restored with interrupts off, so
+ *           no handler or future task on this CPU can observe them; that
+ *           is done per SSE_CHUNK_BLOCKS, so interrupts wait at most 4kB. */
+static void sse_copy_blocks(void* dest, const void* src, uint32_t blocks) {
+    uint8_t xmm_save[SSE_SAVE_SIZE];
+    uint32_t flags, chunk;
+
+    while (blocks > 0) {
+        chunk = (blocks > SSE_CHUNK_BLOCKS) ? SSE_CHUNK_BLOCKS : blocks;
+        blocks -= chunk;
+        cli_and_save(flags);
+        asm volatile ("                         \n\
+            movdqu  %%xmm0, 0(%3)           \n\
+            movdqu  %%xmm1, 16(%3)          \n\
+            movdqu  %%xmm2, 32(%3)          \n\
+            movdqu  %%xmm3, 48(%3)          \n\
+            1:                              \n\
+            movdqu  0(%%esi), %%xmm0        \n\
+            movdqu  16(%%esi), %%xmm1       \n\
+            movdqu  32(%%esi), %%xmm2       \n\
+            movdqu  48(%%esi), %%xmm3       \n\
+            movntdq %%xmm0, 0(%%edi)        \n\
+            movntdq %%xmm1, 16(%%edi)       \n\
+            movntdq %%xmm2, 32(%%edi)       \n\
+            movntdq %%xmm3, 48(%%edi)       \n\
+            addl    $64, %%esi              \n\
+            addl    $64, %%edi              \n\
+            subl    $1, %%ecx               \n\
+            jnz     1b                      \n\
+            sfence                          \n\
+            movdqu  0(%3), %%xmm0           \n\
+            movdqu  16(%3), %%xmm1          \n\
+            movdqu  32(%3), %%xmm2          \n\
+            movdqu  48(%3), %%xmm3          \n\
+            "
+            : "+S"(src), "+D"(dest), "+c"(chunk)
+            : "r"(xmm_save)
+            : "memory", "cc"
+        );
+        restore_flags(flags);
+    }
+}
+
+/* static void sse_set_blocks(void* s, uint32_t pattern, uint32_t blocks);
+ * Inputs:         void* s = 16-byte aligned destination
+ *        uint32_t pattern = byte value replicated into all four bytes
+ *         uint32_t blocks = number of 64-byte blocks to fill (> 0)
+ * Return Value: none
+ * Function: fills 64-byte blocks with non-temporal stores (xmm0 is saved
+ *           and restored with interrupts off, a chunk at a time, as in
+ *           sse_copy_blocks) */
+static void sse_set_blocks(void* s, uint32_t pattern, uint32_t blocks) {
+    uint8_t xmm_save[SSE_SAVE_SIZE];
+    uint32_t flags, chunk;
+
+    while (blocks > 0) {
+        chunk = (blocks > SSE_CHUNK_BLOCKS) ? SSE_CHUNK_BLOCKS : blocks;
+        blocks -= chunk;
+        cli_and_save(flags);
+        asm volatile ("                         \n\
+            movdqu  %%xmm0, 0(%3)           \n\
+            movd    %%eax, %%xmm0           \n\
+            pshufd  $0, %%xmm0, %%xmm0      \n\
+            1:                              \n\
+            movntdq %%xmm0, 0(%%edi)        \n\
+            movntdq %%xmm0, 16(%%edi)       \n\
+            movntdq %%xmm0, 32(%%edi)       \n\
+            movntdq %%xmm0, 48(%%edi)       \n\
+            addl    $64, %%edi              \n\
+            subl    $1, %%ecx               \n\
+            jnz     1b                      \n\
+            sfence                          \n\
+            movdqu  0(%3), %%xmm0           \n\
+            "
+            : "+D"(s), "+c"(chunk), "+a"(pattern)
+            : "r"(xmm_save)
+            : "memory", "cc"
+        );
+        restore_flags(flags);
+    }
+}
+
+/* static void* memset_movs(void* s, int32_t c, uint32_t n);
  * Inputs:    void* s = pointer to memory
- *          int32_t c = value to set memory to
+ *          int32_t c = value to set memory to (low byte only)
  *         uint32_t n = number of bytes to set
- * Return Value: new string
- * Function: set n consecutive bytes of pointer s to value c */
-void* memset(void* s, int32_t c, uint32_t n) {
-    c &= 0xFF;
+ * Return Value: s
+ * Function: byte head to a dword boundary, rep stosl body, byte tail */
+static __attribute__((noinline)) void* memset_movs(void* s, int32_t c, uint32_t n) {
+    void* dst = s;
     asm volatile ("                 \n\
             .memset_top:            \n\
             testl   %%ecx, %%ecx    \n\
@@ -395,13 +657,36 @@ void* memset(void* s, int32_t c, uint32_t n) {
             jmp     .memset_bottom  \n\
             .memset_done:           \n\
             "
-            :
-            : "a"(c << 24 | c << 16 | c << 8 | c), "D"(s), "c"(n)
+            : "+D"(dst), "+c"(n)
+            : "a"(c << 24 | c << 16 | c << 8 | c)
             : "edx", "memory", "cc"
     );
     return s;
 }
 
+/* void* memset(void* s, int32_t c, uint32_t n);
+ * Inputs:    void* s = pointer to memory
+ *          int32_t c = value to set memory to
+ *         uint32_t n = number of bytes to set
+ * Return Value: new string
+ * Function: set n consecutive bytes of pointer s to value c */
+void* memset(void* s, int32_t c, uint32_t n) {
+    uint32_t head, blocks;
+
+    c &= 0xFF;
+    if (!sse_enabled || n < SSE_COPY_THRESHOLD)
+        return memset_movs(s, c, n);
+
+    // bring the destination up to a 16-byte boundary for movntdq
+    head = (SSE_ALIGN - ((uint32_t)s & (SSE_ALIGN - 1))) & (SSE_ALIGN - 1);
+    memset_movs(s, c, head);
+    blocks = (n - head) / SSE_BLOCK_SIZE;
+    sse_set_blocks((uint8_t*)s + head, c << 24 | c << 16 | c << 8 | c, blocks);
+    head += blocks * SSE_BLOCK_SIZE;
+    memset_movs((uint8_t*)s + head, c, n - head);
+    return s;
+}
+
 /* void* memset_word(void* s, int32_t c, uint32_t n);
  * Description: Optimized memset_word
  * Inputs:    void* s = pointer to memory
@@ -443,13 +728,15 @@ void* memset_dword(void* s, int32_t c, uint32_t n) {
     return s;
 }
 
-/* void* memcpy(void* dest, const void* src, uint32_t n);
+/* static void* memcpy_movs(void* dest, const void* src, uint32_t n);
  * Inputs:      void* dest = destination of copy
  *         const void* src = source of copy
- *              uint32_t n = number of byets to copy
+ *              uint32_t n = number of bytes to copy
  * Return Value: pointer to dest
- * Function: copy n bytes of src to dest */
-void* memcpy(void* dest, const void* src, uint32_t n) {
+ * Function: byte head to a dword boundary, rep movsl body, byte tail.
+ *           Copies in ascending order, so it is also safe for dest < src. */
+static __attribute__((noinline)) void* memcpy_movs(void* dest, const void* src, uint32_t n) {
+    void* dst = dest;
     asm volatile ("                 \n\
             .memcpy_top:            \n\
             testl   %%ecx, %%ecx    \n\
@@ -481,35 +768,70 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
             jmp     .memcpy_bottom  \n\
             .memcpy_done:           \n\
             "
+            : "+S"(src), "+D"(dst), "+c"(n)
             :
-            : "S"(src), "D"(dest), "c"(n)
             : "eax", "edx", "memory", "cc"
     );
     return dest;
 }
 
+/* void* memcpy(void* dest, const void* src, uint32_t n);
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy
+ *              uint32_t n = number of byets to copy
+ * Return Value: pointer to dest
+ * Function: copy n bytes of src to dest. Copies of SSE_COPY_THRESHOLD bytes
+ *           or more use SSE2 streaming stores when available. */
+void* memcpy(void* dest, const void* src, uint32_t n) {
+    uint32_t head, blocks;
+
+    if (!sse_enabled || n < SSE_COPY_THRESHOLD)
+        return memcpy_movs(dest, src, n);
+
+    // bring the destination up to a 16-byte boundary for movntdq
+    head = (SSE_ALIGN - ((uint32_t)dest & (SSE_ALIGN - 1))) & (SSE_ALIGN - 1);
+    memcpy_movs(dest, src, head);
+    blocks = (n - head) / SSE_BLOCK_SIZE;
+    sse_copy_blocks((uint8_t*)dest + head, (const uint8_t*)src + head, blocks);
+    head += blocks * SSE_BLOCK_SIZE;
+    memcpy_movs((uint8_t*)dest + head, (const uint8_t*)src + head, n - head);
+    return dest;
+}
+
 /* void* memmove(void* dest, const void* src, uint32_t n);
  * Description: Optimized memmove (used for overlapping memory areas)
  * Inputs:      void* dest = destination of move
  *         const void* src = source of move
  *              uint32_t n = number of byets to move
  * Return Value: pointer to dest
- * Function: move n bytes of src to dest */
+ * Function: move n bytes of src to dest. Anything that can be copied front
+ *           to back (dest below src, or no overlap) goes through memcpy;
+ *           only a true backward overlap copies from the end, a dword at a
+ *           time after peeling off the n % 4 trailing bytes. */
 void* memmove(void* dest, const void* src, uint32_t n) {
+    void* dst = dest;
+
+    if ((uint32_t)dest <= (uint32_t)src || (uint32_t)dest >= (uint32_t)src + n)
+        return memcpy(dest, src, n);
+
     asm volatile ("                             \n\
             movw    %%ds, %%dx                  \n\
             movw    %%dx, %%es                  \n\
-            cld                                 \n\
-            cmp     %%edi, %%esi                \n\
-            jae     .memmove_go                 \n\
             leal    -1(%%esi, %%ecx), %%esi     \n\
             leal    -1(%%edi, %%ecx), %%edi     \n\
+            movl    %%ecx, %%edx                \n\
+            andl    $0x3, %%ecx                 \n\
+            shrl    $2, %%edx                   \n\
             std                                 \n\
-            .memmove_go:                        \n\
             rep     movsb                       \n\
+            subl    $3, %%esi                   \n\
+            subl    $3, %%edi                   \n\
+            movl    %%edx, %%ecx                \n\
+            rep     movsl                       \n\
+            cld                                 \n\
             "
+            : "+D"(dst), "+S"(src), "+c"(n)
             :
-            : "D"(dest), "S"(src), "c"(n)
             : "edx", "memory", "cc"
     );
     return dest;
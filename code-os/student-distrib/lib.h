@@ -53,6 +53,44 @@ uint16_t get_cursor_position(void);
 void update_cursor(int x, int y);
 
 int32_t printf(int8_t *format, ...);
+int32_t snprintf(int8_t* buf, uint32_t size, int8_t* format, ...);
+
+#define NUM_COLS    80
+#define NUM_ROWS    25
+#define SCROLLBACK_LINES    256     // rows a terminal keeps after they scroll off, a power of 2
+
+/* Rows that scrolled off the top of a screen, as they were in video memory
+ * (character and attribute per cell). Saving one is a single row copy. */
+typedef struct {
+    uint16_t rows[SCROLLBACK_LINES][NUM_COLS];
+    uint32_t saved;             // rows ever saved; the newest is at (saved - 1) % SCROLLBACK_LINES
+} scrollback_t;
+
+/* A text screen: NUM_COLS x NUM_ROWS character cells with its own cursor.
+ * Each terminal owns one; video points at the VGA text page while the
+ * terminal is displayed and at its backing page otherwise. */
+typedef struct {
+    char* video;
+    int x;
+    int y;
+    int shown;                  // 1 if video is on the monitor (moves the hardware cursor)
+    scrollback_t* history;      // where rows that scroll off go, NULL to drop them
+} screen_t;
+
+/* Screen that putc/printf/clear draw on (the displayed terminal's) */
+extern screen_t* console;
+
+/* void screen_putc(screen_t* screen, uint8_t c);
+ * Inputs: screen - screen to draw on, c = character to print
+ * Return Value: void
+ *  Function: Output a character to a screen; the caller holds console_lock */
+void screen_putc(screen_t* screen, uint8_t c);
+
+/* void screen_clear(screen_t* screen);
+ * Inputs: screen - screen to clear
+ * Return Value: none
+ * Function: Blank a screen and home its cursor; the caller holds console_lock */
+void screen_clear(screen_t* screen);
 
 /* void putc(uint8_t c);
  * Inputs: uint_8* c = character to print
@@ -69,6 +107,12 @@ uint32_t strlen(const int8_t* s);
  * Function: Clears video memory */
 void clear(void);
 
+/* void sse_init(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: enables SSE2 (if present) for the large-copy paths of
+ *           memcpy/memmove/memset; call once at boot before interrupts */
+void sse_init(void);
 void* memset(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
 void* memset_dword(void* s, int32_t c, uint32_t n);
@@ -149,7 +193,7 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-    asm volatile ("outl %l1, (%w0)"     \
+    asm volatile ("outl %k1, (%w0)"     \
             :                           \
             : "d"(port), "a"(data)      \
             : "memory", "cc"            \
@@ -207,4 +251,53 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Spinlock for data shared between CPUs. cli only keeps this CPU's
+ * interrupt handlers out; anything another CPU can touch needs one of
+ * these, taken with the _irqsave form if an interrupt handler uses it too. */
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT   { 0 }
+
+/* Spin until the lock is ours. xchg is locked implicitly; the inner loop
+ * only reads, so waiting CPUs do not bounce the cache line */
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t taken = 1;
+    while (1) {
+        asm volatile ("xchgl %0, %1"
+                : "+r"(taken), "+m"(lock->locked)
+                :
+                : "memory"
+        );
+        if (!taken)
+            return;
+        while (lock->locked)
+            asm volatile ("pause");
+        taken = 1;
+    }
+}
+
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile ("" : : : "memory");   // stores above stay inside the lock
+    lock->locked = 0;
+}
+
+/* Take a lock that an interrupt handler may also take: interrupts stay off
+ * on this CPU while it is held */
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+    cli_and_save(flags);                \
+    spin_lock(lock);                    \
+} while (0)
+
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                    \
+    spin_unlock(lock);                  \
+    restore_flags(flags);               \
+} while (0)
+
+/* Guards every screen_t and the terminal line buffers echoed onto them */
+extern spinlock_t console_lock;
+
 #endif /* _LIB_H */
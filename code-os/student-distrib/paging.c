@@ -4,6 +4,8 @@
 #define KERNAL_ADDRESS 0x400000 // 4MB
 #define VIDEO_MEM 0xb8000 //The text screen video memory for colour monitors resides at 0xB8000 (according to OS dev)
 
+uint32_t phys_mem_kb = 0;
+
 
 
 /*
@@ -160,3 +162,84 @@ void paging_init(){
 
         : : : "eax", "cc", "memory" );
 }
+
+/*
+ * paging_map_firmware()
+ *  DESCRIPTION: Identity map or unmap the BIOS areas that hold the MP and ACPI tables
+ *  INPUTS: present - 1 to map them read only, 0 to unmap them again
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: changes pte entries and flushes the TLB
+ */
+void paging_map_firmware(uint32_t present){
+    uint32_t addr;
+
+    for(addr = FIRMWARE_EBDA_START; addr < FIRMWARE_ROM_END; addr += B_IN_4KB){
+        if(addr == FIRMWARE_EBDA_END){
+            addr = FIRMWARE_ROM_START;      // leave video memory and the terminal buffers alone
+        }
+        pte[addr >> PAGE_FRAME_BITS].bit_addr_31_12 = addr >> PAGE_FRAME_BITS;
+        pte[addr >> PAGE_FRAME_BITS].read_write     = 0;
+        pte[addr >> PAGE_FRAME_BITS].present        = present;
+    }
+    flush_tlb();
+}
+
+/*
+ * paging_map_low_page()
+ *  DESCRIPTION: Identity map or unmap one 4KB page of the first 4MB for the kernel
+ *  INPUTS: addr - page address, below 4MB
+ *          present - 1 to map it read/write, 0 to unmap it
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: changes a pte entry and flushes the TLB
+ */
+void paging_map_low_page(uint32_t addr, uint32_t present){
+    pte[addr >> PAGE_FRAME_BITS].bit_addr_31_12 = addr >> PAGE_FRAME_BITS;
+    pte[addr >> PAGE_FRAME_BITS].read_write     = 1;
+    pte[addr >> PAGE_FRAME_BITS].present        = present;
+    flush_tlb();
+}
+
+/*
+ * paging_map_4mb()
+ *  DESCRIPTION: Identity map the 4MB region holding a physical address for the kernel
+ *  INPUTS: phys_addr - any address inside the region
+ *          mmio - 1 for device registers (caching disabled), 0 for memory
+ *  OUTPUTS: none
+ *  RETURN VALUE: 1 if the mapping was added, 0 if it was already there, -1 if the slot is taken
+ *  SIDE EFFECT: changes a pde entry and flushes the TLB
+ */
+int32_t paging_map_4mb(uint32_t phys_addr, uint32_t mmio){
+    uint32_t i = phys_addr / MB_4;
+
+    if(pde[i].kb.present){
+        // fine if it is already an identity 4MB page (e.g. LAPIC and IOAPIC share one)
+        return (pde[i].kb.page_size && pde[i].kb.bit_addr_31_12 == (i * MB_4) >> PAGE_FRAME_BITS) ? 0 : -1;
+    }
+    pde[i].kb.bit_addr_31_12           = (i * MB_4) >> PAGE_FRAME_BITS;
+    pde[i].kb.avl_11_8                 = 0;
+    pde[i].kb.page_size                = 1;
+    pde[i].kb.avl_6                    = 0;
+    pde[i].kb.accessed                 = 0;
+    pde[i].kb.page_cache_disable       = mmio;
+    pde[i].kb.page_write_through       = mmio;
+    pde[i].kb.user_supervisor          = 0;
+    pde[i].kb.read_write               = 1;
+    pde[i].kb.present                  = 1;
+    flush_tlb();
+    return 1;
+}
+
+/*
+ * paging_unmap_4mb()
+ *  DESCRIPTION: Remove a mapping added by paging_map_4mb (when it returned 1)
+ *  INPUTS: phys_addr - any address inside the region
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: changes a pde entry and flushes the TLB
+ */
+void paging_unmap_4mb(uint32_t phys_addr){
+    pde[phys_addr / MB_4].kb.present = 0;
+    flush_tlb();
+}
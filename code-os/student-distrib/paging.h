@@ -12,6 +12,9 @@
 #define TERMINAL2_ADDR  0xBA000
 #define TERMINAL3_ADDR  0xBB000
 
+// physical memory reported by the boot loader (0 if it did not say), set in kernel.c
+extern uint32_t phys_mem_kb;
+
 typedef struct __attribute__((packed)) page_directory_entry_4kb{
     // 1 if the page is in physical memory
     uint32_t present                : 1;
@@ -99,6 +102,59 @@ page_directory_entry pde[NUM_MAX] __attribute__((aligned (B_IN_4KB)));  // initi
 page_table_entry pte[NUM_MAX] __attribute__((aligned (B_IN_4KB)));  // initialize page table entry
 page_table_entry user_pte[NUM_MAX] __attribute__((aligned (B_IN_4KB)));  // initialize page table entry
 
+#define FIRMWARE_EBDA_START 0x80000     // extended BIOS data area lives below 640KB
+#define FIRMWARE_EBDA_END   0xA0000
+#define FIRMWARE_ROM_START  0xE0000     // BIOS ROM, where the MP and ACPI pointers live
+#define FIRMWARE_ROM_END    0x100000
+
 extern void paging_init();
 
+/*
+ * paging_map_firmware()
+ *  DESCRIPTION: Identity map or unmap the BIOS areas that hold the MP and ACPI tables
+ *               (FIRMWARE_EBDA_* and FIRMWARE_ROM_*)
+ *  INPUTS: present - 1 to map them read only, 0 to unmap them again
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: changes pte entries and flushes the TLB
+ */
+extern void paging_map_firmware(uint32_t present);
+
+/*
+ * paging_map_low_page()
+ *  DESCRIPTION: Identity map or unmap one 4KB page of the first 4MB for the kernel
+ *               (e.g. the AP start-up trampoline)
+ *  INPUTS: addr - page address, below 4MB
+ *          present - 1 to map it read/write, 0 to unmap it
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: changes a pte entry and flushes the TLB
+ */
+extern void paging_map_low_page(uint32_t addr, uint32_t present);
+
+/*
+ * paging_map_4mb()
+ *  DESCRIPTION: Identity map the 4MB region holding a physical address for the kernel
+ *  INPUTS: phys_addr - any address inside the region
+ *          mmio - 1 for device registers (caching disabled), 0 for memory
+ *  OUTPUTS: none
+ *  RETURN VALUE: 1 if the mapping was added, 0 if the region was already identity
+ *                mapped, -1 if its page directory slot is used for something else
+ *  SIDE EFFECT: changes a pde entry and flushes the TLB
+ */
+extern int32_t paging_map_4mb(uint32_t phys_addr, uint32_t mmio);
+
+/*
+ * paging_unmap_4mb()
+ *  DESCRIPTION: Remove a mapping added by paging_map_4mb (when it returned 1)
+ *  INPUTS: phys_addr - any address inside the region
+ *  OUTPUTS: none
+ *  RETURN VALUE: none
+ *  SIDE EFFECT: changes a pde entry and flushes the TLB
+ */
+extern void paging_unmap_4mb(uint32_t phys_addr);
+
+/* reload cr3 (paging_function.S) */
+extern void flush_tlb();
+
 #endif 
@@ -1,28 +1,268 @@
 #include "pit.h"
 #include "i8259.h"
 #include "lib.h"
+#include "profile.h"
+#include "systemcall.h"
+#include "apic.h"
+#include "smp.h"
+#include "sched.h"
+#include "timer.h"
+
+volatile uint32_t pit_ticks = 0;
+
+//interrupts per tick: 1 normally, more while the profiler speeds the timer up
+static uint32_t pit_tick_divider = 1;
+//rate every CPU's timer should run at; each LAPIC timer is reprogrammed by its own CPU
+static volatile uint32_t timer_hz = pit_default_hz;
+
+//count loaded by pit_oneshot
+static uint32_t pit_oneshot_count;
+
+static void pit_tick(cpu_t* cpu, irq_frame_t* frame);
+static void timer_idle_stop(cpu_t* cpu, uint32_t fired);
+static void pit_oneshot(uint32_t ticks);
+static uint32_t pit_oneshot_elapsed();
 
 //void pit_init()
 //Input: N/A
 //Output: N/A
-//Effect: Initialize PIT values, turn on IRQ 0 and set frequency to default 100hz
+//Effect: Start the 100hz timer tick: the LAPIC timer when apic_init succeeded,
+//        otherwise PIT channel 0 on IRQ 0
 extern void pit_init(){
-    cli();
-    outb(pit_mode,pit_port_cmd);
-    outb((uint8_t)hundread_hz_rate,pit_port_channel_0_data);
-    outb((uint8_t)(hundread_hz_rate>>8),pit_port_channel_0_data);
-    sti();
+    if(apic_enabled){
+        lapic_timer_init(pit_default_hz);
+        return;
+    }
+    pit_set_rate(pit_default_hz);
     enable_irq(pit_irq_line);
 }
-//void pit_handler()
-//Input: N/A
+
+//void timer_set_rate(uint32_t hz)
+//Input: hz - timer interrupts per second
 //Output: N/A
-//Effect: handle PIT interrupts/ use for scheduling
-extern void pit_handler(){
-    //do something related to schedling
-    //call process switch
-    
+//Effect: Speed up or slow down whichever timer drives the tick; pit_ticks keeps
+//        counting at pit_default_hz
+extern void timer_set_rate(uint32_t hz){
+    pit_tick_divider = (hz > pit_default_hz) ? hz / pit_default_hz : 1;
+    timer_hz = hz;
+    if(apic_enabled){
+        lapic_timer_set_rate(hz);       // the other CPUs follow on their next tick
+        this_cpu()->timer_hz = hz;
+    } else{
+        pit_set_rate(hz);
+    }
+}
+
+//void pit_set_rate(uint32_t hz)
+//Input: hz - interrupts per second, at least pit_min_hz
+//Output: N/A
+//Effect: Reload the channel 0 divisor (the new rate starts with the next count)
+extern void pit_set_rate(uint32_t hz){
+    uint32_t flags;
+    uint32_t divisor;
+
+    if(hz < pit_min_hz){
+        hz = pit_min_hz;
+    }
+    divisor = pit_base_freq / hz;
+
+    cli_and_save(flags);
+    outb(pit_mode,pit_port_cmd);
+    outb((uint8_t)divisor,pit_port_channel_0_data);
+    outb((uint8_t)(divisor>>8),pit_port_channel_0_data);
+    restore_flags(flags);
+}
+
+//void pit_wait_us(uint32_t us)
+//Input: us - microseconds to wait, at most pit_max_wait_us
+//Output: N/A
+//Effect: Busy-wait using PIT channel 2 (the speaker channel), which leaves
+//        channel 0 and its interrupt alone; used to calibrate the LAPIC timer
+extern void pit_wait_us(uint32_t us){
+    uint32_t count = us * (pit_base_freq / 1000) / 1000;
+    uint8_t gate;
+
+    if(count > 0xFFFF){
+        count = 0xFFFF;
+    }
+    // gate channel 2 off with the speaker disconnected, load a one-shot count, then start it
+    gate = inb(pit_port_speaker) & ~(pit_speaker_gate | pit_speaker_data);
+    outb(gate, pit_port_speaker);
+    outb(pit_mode_oneshot_ch2, pit_port_cmd);
+    outb((uint8_t)count, pit_port_channel_2_data);
+    outb((uint8_t)(count >> 8), pit_port_channel_2_data);
+    outb(gate | pit_speaker_gate, pit_port_speaker);
+
+    while(!(inb(pit_port_speaker) & pit_speaker_out));
+    outb(gate, pit_port_speaker);
+}
+
+//void pit_handler(irq_frame_t* frame)
+//Input: frame - context the timer interrupted
+//Output: N/A
+//Effect: handle PIT interrupts/ use for scheduling (acknowledged first: the tick may switch tasks)
+extern void pit_handler(irq_frame_t* frame){
     send_eoi(pit_irq_line);
-    //switch_process();
+    timer_tick(frame);
+}
+
+//void timer_tick(irq_frame_t* frame)
+//Input: frame - context the timer interrupted
+//Output: N/A
+//Effect: work done on every timer interrupt of every CPU, PIT or LAPIC: profiler
+//        samples, then once per pit_tick_divider interrupts the tick itself and a
+//        scheduler tick (sched_tick), which may switch tasks. The interrupt must
+//        already be acknowledged.
+extern void timer_tick(irq_frame_t* frame){
+    cpu_t* cpu = this_cpu();
+
+    if(cpu->idle_ticks){
+        timer_idle_stop(cpu, 1);        // the one-shot of an idle CPU ran out
+    }
+    if(apic_enabled && cpu->timer_hz != timer_hz){
+        cpu->timer_hz = timer_hz;
+        lapic_timer_set_rate(timer_hz);
+    }
+    if(profile_enabled){
+        profile_sample(frame->eip, frame->cs);
+    }
+    if(++cpu->timer_subticks >= pit_tick_divider){
+        cpu->timer_subticks = 0;
+        pit_tick(cpu, frame);
+        sched_tick();
+    }
+}
+
+//void pit_tick(cpu_t* cpu, irq_frame_t* frame)
+//Input: cpu - CPU the tick is on, frame - context the timer interrupted
+//Output: N/A
+//Effect: advance pit_ticks and the timer wheel (boot processor only, so they stay at
+//        pit_default_hz) and charge the tick to the process running on this CPU as
+//        user or kernel time
+static void pit_tick(cpu_t* cpu, irq_frame_t* frame){
+    pcb_struct* pcb;
+
+    if(cpu->index == 0){
+        pit_ticks++;
+        timer_run(pit_ticks);
+    }
+    if(cpu->terminal != NULL && pid_array[cur_pid]){     // not while idle
+        pcb = get_pcb(cur_pid);
+        if(IRQ_FROM_USER(frame)){
+            pcb->user_ticks++;
+        } else{
+            pcb->kernel_ticks++;
+        }
+    }
+}
+
+//void timer_idle_enter()
+//Input: N/A
+//Output: N/A
+//Effect: called by an idle CPU with interrupts off right before hlt. Replaces the
+//        periodic tick with one interrupt at the next kernel timer on the boot
+//        processor, at most timer_idle_max_ticks away (as far as the PIT can count
+//        without an APIC). New work arrives with an interrupt or a wakeup IPI
+//        (smp_wakeup). Not while the profiler runs, which wants every interrupt.
+extern void timer_idle_enter(){
+    cpu_t* cpu = this_cpu();
+    uint32_t ticks = timer_idle_max_ticks;
+
+    if(profile_enabled || timer_hz != pit_default_hz || cpu->idle_ticks){
+        return;
+    }
+    if(cpu->index == 0){
+        ticks = timer_next(ticks);      // its tick turns the timer wheel
+    }
+    if(!apic_enabled && ticks > pit_max_oneshot_ticks){
+        ticks = pit_max_oneshot_ticks;
+    }
+    if(ticks < 2){
+        return;                         // due on the next tick anyway
+    }
+    if(apic_enabled){
+        lapic_timer_oneshot(pit_default_hz, ticks);
+    } else{
+        pit_oneshot(ticks);
+    }
+    cpu->idle_ticks = ticks;
+    // a timer armed since timer_next looked saw no idle_ticks, so sent no wakeup
+    if(cpu->index == 0 && timer_next(ticks) < ticks){
+        timer_idle_stop(cpu, 0);
+    }
+}
+
+//void timer_idle_exit()
+//Input: N/A
+//Output: N/A
+//Effect: called by an idle CPU with interrupts off after hlt returns: if something
+//        other than the one-shot woke it, restart the periodic tick and account for
+//        the ticks that passed
+extern void timer_idle_exit(){
+    cpu_t* cpu = this_cpu();
+
+    if(cpu->idle_ticks){
+        timer_idle_stop(cpu, 0);
+    }
+}
+
+//static void timer_idle_stop(cpu_t* cpu, uint32_t fired)
+//Input: cpu - calling CPU, fired - 1 when called from the one-shot's interrupt
+//Output: N/A
+//Effect: back to the periodic tick; the boot processor adds the ticks it skipped to
+//        pit_ticks (a fraction of a tick is lost when another interrupt woke it)
+static void timer_idle_stop(cpu_t* cpu, uint32_t fired){
+    uint32_t elapsed;
+
+    if(fired){
+        elapsed = cpu->idle_ticks;
+    } else{
+        elapsed = apic_enabled ? lapic_timer_elapsed(pit_default_hz) : pit_oneshot_elapsed();
+    }
+    // the interrupt that ends the one-shot (this one, or one still pending) counts the last tick
+    if(elapsed >= cpu->idle_ticks){
+        elapsed = cpu->idle_ticks - 1;
+    }
+
+    if(apic_enabled){
+        lapic_timer_init(pit_default_hz);
+    } else{
+        pit_set_rate(pit_default_hz);
+    }
+    if(cpu->index == 0){
+        timer_resume(elapsed);          // pit_ticks catches up before other CPUs date timers from it
+    } else{
+        cpu->idle_ticks = 0;
+    }
+}
+
+//static void pit_oneshot(uint32_t ticks)
+//Input: ticks - delay at pit_default_hz, at most pit_max_oneshot_ticks
+//Output: N/A
+//Effect: channel 0 interrupts once after the delay instead of periodically
+static void pit_oneshot(uint32_t ticks){
+    pit_oneshot_count = ticks * (pit_base_freq / pit_default_hz);
+    outb(pit_mode_oneshot,pit_port_cmd);
+    outb((uint8_t)pit_oneshot_count,pit_port_channel_0_data);
+    outb((uint8_t)(pit_oneshot_count>>8),pit_port_channel_0_data);
+}
+
+//static uint32_t pit_oneshot_elapsed()
+//Input: N/A
+//Output: whole ticks of the pit_oneshot delay that have passed (all of them once it fired)
+//Effect: latches channel 0's status and count
+static uint32_t pit_oneshot_elapsed(){
+    uint8_t status;
+    uint32_t count;
 
+    outb(pit_readback_ch0,pit_port_cmd);
+    status = inb(pit_port_channel_0_data);
+    count = inb(pit_port_channel_0_data);
+    count |= inb(pit_port_channel_0_data) << 8;
+    if(status & pit_status_out){
+        count = 0;                      // fired (the counter wraps and keeps going)
+    } else if(count > pit_oneshot_count){
+        count = pit_oneshot_count;      // not loaded yet
+    }
+    return (pit_oneshot_count - count) / (pit_base_freq / pit_default_hz);
 }
@@ -1,22 +1,62 @@
 #ifndef _PIT_H
 #define _PIT_H
 
+#include "types.h"
+#include "idt.h"
+
 //define pit ports
 #define pit_irq_line 0x00
 #define pit_port_cmd 0x43
 //we are using channel 0 for pit that connects the output to the PIC
 #define pit_port_channel_0_data 0x40
 
+//channel 2 (speaker) is used for busy-wait delays
+#define pit_port_channel_2_data 0x42
+#define pit_port_speaker 0x61
+#define pit_speaker_gate 0x01
+#define pit_speaker_data 0x02
+#define pit_speaker_out 0x20
+//channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+#define pit_mode_oneshot_ch2 0xB0
+#define pit_max_wait_us 54000
+
 //using channel 0 and mode 2
 //0b00110100 
 #define pit_mode 52
-//100 hz rate = divisor = 1193180 / hz// from OSDEV;
-#define hundread_hz_rate 11931
+//channel 0, lobyte/hibyte, mode 0: a single interrupt when the count runs out (tickless idle)
+#define pit_mode_oneshot 48
+//read-back command latching status and count of channel 0; status bit 7 is the OUT pin
+#define pit_readback_ch0 0xC2
+#define pit_status_out 0x80
+//input clock of the PIT, divisor = 1193180 / hz// from OSDEV;
+#define pit_base_freq 1193180
+//100 hz rate
+#define pit_default_hz 100
+//slowest rate the 16 bit divisor can reach
+#define pit_min_hz 19
+//longest one-shot channel 0 can count, in ticks
+#define pit_max_oneshot_ticks (0xFFFF / (pit_base_freq / pit_default_hz))
+//longest an idle CPU stops its tick for
+#define timer_idle_max_ticks pit_default_hz
+
 
+//timer ticks since pit_init, at pit_default_hz whatever the programmed rate
+extern volatile uint32_t pit_ticks;
 
 //initialize the pit
 extern void pit_init();
+//reprogram channel 0 to interrupt hz times per second
+extern void pit_set_rate(uint32_t hz);
+//change the rate of whichever timer drives the tick (LAPIC timer or PIT)
+extern void timer_set_rate(uint32_t hz);
+//busy-wait using channel 2
+extern void pit_wait_us(uint32_t us);
 //handles the pit
-extern void pit_handler();
+extern void pit_handler(irq_frame_t* frame);
+//per-interrupt timer work shared by the PIT and LAPIC timer handlers
+extern void timer_tick(irq_frame_t* frame);
+//idle CPU: stop the periodic tick before hlt / restart it when something else woke the CPU
+extern void timer_idle_enter();
+extern void timer_idle_exit();
 
 #endif
@@ -0,0 +1,152 @@
+/* poll.c - Waiting on several descriptors at once (poll)
+ * vim:ts=4 noexpandtab
+ */
+
+#include "poll.h"
+#include "lib.h"
+#include "fd.h"
+#include "sched.h"
+#include "terminal.h"
+#include "timer.h"
+
+/* One in each poll call's stack frame, for poll_notify and its timer */
+typedef struct {
+    volatile int event;                     // something changed since the last look
+    volatile int expired;                   // the timeout timer has run (and let go of this)
+} poll_waiter_t;
+
+static poll_waiter_t* poll_waiters[NUM_TERMINALS];     // by terminal, NULL if its task is not polling
+static spinlock_t poll_lock = SPINLOCK_INIT;
+static wait_queue_t poll_wait = WAIT_QUEUE_INIT;
+
+static int32_t poll_scan(pcb_struct* pcb, pollfd_t* fds, uint32_t nfds);
+static void poll_timeout(ktimer_t* timer);
+
+/*
+ * poll_fds
+ *   DESCRIPTION: The poll system call
+ *   INPUTS: pcb - the caller, fds - descriptors and the events wanted
+ *           nfds - how many (at most FD_MAX), timeout_ms - -1 to wait
+ *           for ever, 0 to only look
+ *   OUTPUTS: revents of each pollfd_t: the events wanted that are ready,
+ *            POLLNVAL if the descriptor is not open (negative ones are skipped)
+ *   RETURN VALUE: number of descriptors with revents set, 0 on a timeout,
+ *                 -1 for a bad fds or nfds
+ *   SIDE EFFECTS: Sleeps; other tasks run meanwhile
+ */
+int32_t poll_fds(pcb_struct* pcb, pollfd_t* fds, uint32_t nfds, int32_t timeout_ms){
+    uint32_t slot = running_terminal()->terminal_num;
+    poll_waiter_t waiter;
+    ktimer_t timer;
+    uint32_t flags;
+    int32_t ready;
+
+    if((fds == NULL && nfds > 0) || nfds > FD_MAX){
+        return -1;
+    }
+    ready = poll_scan(pcb, fds, nfds);
+    if(ready > 0 || timeout_ms == 0){
+        return ready;
+    }
+
+    waiter.event = 0;
+    waiter.expired = 0;
+    spin_lock_irqsave(&poll_lock, flags);
+    poll_waiters[slot] = &waiter;
+    spin_unlock_irqrestore(&poll_lock, flags);
+    if(timeout_ms > 0){
+        timer.func = poll_timeout;
+        timer.data = &waiter;
+        timer_add_after(&timer, TIMER_MS_TO_TICKS(timeout_ms));
+    }
+
+    // clear the flag before looking, so a change during the look is not missed
+    while(1){
+        waiter.event = 0;
+        ready = poll_scan(pcb, fds, nfds);
+        if(ready > 0 || waiter.expired){
+            break;
+        }
+        sched_wait(&poll_wait, &waiter.event);
+    }
+
+    spin_lock_irqsave(&poll_lock, flags);
+    poll_waiters[slot] = NULL;
+    spin_unlock_irqrestore(&poll_lock, flags);
+    if(timeout_ms > 0 && !timer_cancel(&timer)){
+        while(!waiter.expired);             // it may still be running on another CPU
+    }
+    return ready;
+}
+
+/*
+ * poll_notify
+ *   DESCRIPTION: Tell poll that a file may have become ready
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wakes every task in poll to look again; safe in interrupt context
+ */
+void poll_notify(void){
+    uint32_t flags;
+    int i;
+
+    spin_lock_irqsave(&poll_lock, flags);
+    for(i = 0; i < NUM_TERMINALS; i++){
+        if(poll_waiters[i] != NULL){
+            poll_waiters[i]->event = 1;
+        }
+    }
+    spin_unlock_irqrestore(&poll_lock, flags);
+    sched_wake(&poll_wait);
+}
+
+/*
+ * poll_scan
+ *   DESCRIPTION: Ask each descriptor what it is ready for
+ *   INPUTS: pcb - the caller, fds, nfds - as poll_fds takes them
+ *   OUTPUTS: revents of each
+ *   RETURN VALUE: number with revents set
+ *   SIDE EFFECTS: none
+ */
+static int32_t poll_scan(pcb_struct* pcb, pollfd_t* fds, uint32_t nfds){
+    file_array_struct* file;
+    int32_t ready = 0;
+    uint32_t i, mask;
+
+    for(i = 0; i < nfds; i++){
+        fds[i].revents = 0;
+        if(fds[i].fd < 0) continue;
+
+        file = fd_get(pcb, fds[i].fd);
+        if(file == NULL){
+            fds[i].revents = POLLNVAL;
+        } else if(file->fileop_ptr->poll != NULL){
+            fds[i].revents = file->fileop_ptr->poll(fds[i].fd) & fds[i].events;
+        } else {
+            mask = (file->fileop_ptr->read ? POLLIN : 0) | (file->fileop_ptr->write ? POLLOUT : 0);
+            fds[i].revents = mask & fds[i].events;
+        }
+        if(fds[i].revents != 0){
+            ready++;
+        }
+    }
+    return ready;
+}
+
+/*
+ * poll_timeout
+ *   DESCRIPTION: Callback of the poll timeout timers
+ *   INPUTS: timer - the expired timer, on the poller's stack
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The poller may return as soon as expired is set, so nothing
+ *                 of it is touched after that
+ */
+static void poll_timeout(ktimer_t* timer){
+    poll_waiter_t* waiter = timer->data;
+
+    waiter->event = 1;
+    waiter->expired = 1;
+    sched_wake(&poll_wait);
+}
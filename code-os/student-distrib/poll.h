@@ -0,0 +1,43 @@
+/* poll.h - Waiting on several descriptors at once (poll)
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _POLL_H
+#define _POLL_H
+
+#include "types.h"
+#include "systemcall.h"
+
+/* A driver says what an open file is ready for through the poll hook of its
+ * fileop_table_t; without one, a file is always ready for whatever it has
+ * read and write functions for. poll asks every descriptor in turn and
+ * returns if any is ready. Otherwise it sleeps until a driver calls
+ * poll_notify (a line was entered, the RTC ticked) or the timeout expires,
+ * then asks again. Every task in poll wakes on every notification; there
+ * are only NUM_TERMINALS of them. */
+
+/*
+ * poll_fds
+ *   DESCRIPTION: The poll system call
+ *   INPUTS: pcb - the caller, fds - descriptors and the events wanted
+ *           nfds - how many (at most FD_MAX), timeout_ms - -1 to wait
+ *           for ever, 0 to only look
+ *   OUTPUTS: revents of each pollfd_t: the events wanted that are ready,
+ *            POLLNVAL if the descriptor is not open (negative ones are skipped)
+ *   RETURN VALUE: number of descriptors with revents set, 0 on a timeout,
+ *                 -1 for a bad fds or nfds
+ *   SIDE EFFECTS: Sleeps; other tasks run meanwhile
+ */
+int32_t poll_fds(pcb_struct* pcb, pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+
+/*
+ * poll_notify
+ *   DESCRIPTION: Tell poll that a file may have become ready
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wakes every task in poll to look again; safe in interrupt context
+ */
+void poll_notify(void);
+
+#endif /* _POLL_H */
@@ -0,0 +1,230 @@
+#include "procfs.h"
+#include "lib.h"
+#include "idt.h"
+#include "pit.h"
+#include "paging.h"
+#include "systemcall.h"
+#include "fd.h"
+#include "terminal.h"
+#include "smp.h"
+#include "bcache.h"
+
+#define PROC_KERNEL_KB      4096        // kernel 4MB page, including the PCBs and kernel stacks
+#define PROC_LOW_KB         4096        // first 4MB: video memory and terminal buffers, otherwise unused
+#define PROC_PROCESS_KB     4096        // one 4MB user page per process
+
+static uint32_t proc_processes(int8_t* buf, uint32_t size);
+static uint32_t proc_meminfo(int8_t* buf, uint32_t size);
+static uint32_t proc_interrupts(int8_t* buf, uint32_t size);
+static uint32_t proc_sched(int8_t* buf, uint32_t size);
+static uint32_t proc_bcache(int8_t* buf, uint32_t size);
+
+/* Renderers, indexed by PROC_* (the inode number of the open file) */
+static uint32_t (*proc_render[PROC_NUM_FILES])(int8_t* buf, uint32_t size) = {
+    proc_processes,
+    proc_meminfo,
+    proc_interrupts,
+    proc_sched,
+    proc_bcache
+};
+
+/*
+ * proc_open, proc_close
+ *   DESCRIPTION: Open/close a proc/ file
+ *   INPUTS: filename / fd
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t proc_open(const uint8_t* filename){
+    return 0;
+}
+
+int32_t proc_close(int32_t fd){
+    return 0;
+}
+
+/*
+ * proc_read
+ *   DESCRIPTION: Render the open proc/ file and copy out the part at the file position
+ *   INPUTS: fd - file descriptor, buf - user buffer, nbytes - size of buf
+ *   OUTPUTS: text, see PROC_* in procfs.h
+ *   RETURN VALUE: number of bytes copied, 0 at the end of the file, -1 for a bad file
+ *   SIDE EFFECTS: Advances the file position
+ */
+int32_t proc_read(int32_t fd, void* buf, int32_t nbytes){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    int8_t text[PROC_BUF_SIZE];
+    uint32_t length;
+    uint32_t count;
+
+    if(buf == NULL || nbytes < 0 || file->inode_number >= PROC_NUM_FILES){
+        return -1;
+    }
+
+    length = proc_render[file->inode_number](text, PROC_BUF_SIZE);
+    if(file->file_position >= length){
+        return 0;
+    }
+    count = length - file->file_position;
+    if(count > nbytes){
+        count = nbytes;
+    }
+    memcpy(buf, text + file->file_position, count);
+    file->file_position += count;
+    return count;
+}
+
+/*
+ * proc_write
+ *   DESCRIPTION: proc/ files are read only
+ *   INPUTS: ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECTS: none
+ */
+int32_t proc_write(int32_t fd, const void* buf, int32_t nbytes){
+    return -1;
+}
+
+/*
+ * proc_processes
+ *   DESCRIPTION: Render the process table
+ *   INPUTS: buf - output buffer, size - capacity of buf
+ *   OUTPUTS: header, then "<pid> <ppid> <tty> <user ticks> <kernel ticks> <program>"
+ *            per process; ppid is "-" for the shell at the root of a terminal
+ *   RETURN VALUE: length of the text
+ *   SIDE EFFECTS: none
+ */
+static uint32_t proc_processes(int8_t* buf, uint32_t size){
+    uint32_t length;
+    uint32_t pid;
+    pcb_struct* pcb;
+    dentry_t dentry;
+    int8_t name[MAX_FILE_NAME + 1];
+    int8_t parent[12];
+
+    length = snprintf(buf, size, "PID PPID TTY  UTICKS  KTICKS PROGRAM\n");
+    for(pid = 0; pid < MAX_PID_NUM; pid++){
+        if(!pid_array[pid]){
+            continue;
+        }
+        pcb = get_pcb(pid);
+        if(pcb->pid_parent == (uint32_t)-1){
+            strcpy(parent, "-");
+        } else{
+            snprintf(parent, sizeof(parent), "%u", pcb->pid_parent);
+        }
+        if(read_dentry_by_inode(pcb->exe_inode, &dentry) == 0){
+            strncpy(name, dentry.file_name, MAX_FILE_NAME);
+            name[MAX_FILE_NAME] = '\0';
+        } else{
+            strcpy(name, "?");
+        }
+        length += snprintf(buf + length, size - length, "%3u %4s %3u %7u %7u %s\n",
+                pid, parent, pcb->terminal_num, pcb->user_ticks, pcb->kernel_ticks, name);
+    }
+    return length;
+}
+
+/*
+ * proc_meminfo
+ *   DESCRIPTION: Render physical memory use
+ *   INPUTS: buf - output buffer, size - capacity of buf
+ *   OUTPUTS: "<field>: <value> kB" lines
+ *   RETURN VALUE: length of the text
+ *   SIDE EFFECTS: none
+ */
+static uint32_t proc_meminfo(int8_t* buf, uint32_t size){
+    uint32_t processes = 0;
+    uint32_t used;
+    uint32_t pid;
+
+    for(pid = 0; pid < MAX_PID_NUM; pid++){
+        if(pid_array[pid]){
+            processes++;
+        }
+    }
+    used = PROC_LOW_KB + PROC_KERNEL_KB + processes * PROC_PROCESS_KB;
+
+    return snprintf(buf, size,
+            "MemTotal:  %8u kB\n"
+            "MemFree:   %8u kB\n"
+            "LowMem:    %8u kB\n"
+            "Kernel:    %8u kB\n"
+            "Processes: %8u kB (%u of %u)\n",
+            phys_mem_kb, (phys_mem_kb > used) ? phys_mem_kb - used : 0,
+            PROC_LOW_KB, PROC_KERNEL_KB,
+            processes * PROC_PROCESS_KB, processes, MAX_PID_NUM);
+}
+
+/*
+ * proc_interrupts
+ *   DESCRIPTION: Render interrupt counts
+ *   INPUTS: buf - output buffer, size - capacity of buf
+ *   OUTPUTS: "<irq> <count>" for every line that has fired
+ *   RETURN VALUE: length of the text
+ *   SIDE EFFECTS: none
+ */
+static uint32_t proc_interrupts(int8_t* buf, uint32_t size){
+    uint32_t length;
+    uint32_t irq;
+
+    length = snprintf(buf, size, "IRQ      COUNT\n");
+    for(irq = 0; irq < NUM_IRQS; irq++){
+        if(irq_counts[irq] != 0){
+            length += snprintf(buf + length, size - length, "%3u %10u\n", irq, irq_counts[irq]);
+        }
+    }
+    return length;
+}
+
+/*
+ * proc_sched
+ *   DESCRIPTION: Render scheduler state
+ *   INPUTS: buf - output buffer, size - capacity of buf
+ *   OUTPUTS: uptime in ticks, then one line per CPU: the pid and terminal it
+ *            is running (or idle) and how many terminals wait in its queue
+ *   RETURN VALUE: length of the text
+ *   SIDE EFFECTS: none
+ */
+static uint32_t proc_sched(int8_t* buf, uint32_t size){
+    uint32_t length;
+    uint32_t i;
+    cpu_t* cpu;
+
+    length = snprintf(buf, size,
+            "ticks:    %u (%u Hz)\n"
+            "cpus:     %u\n",
+            pit_ticks, pit_default_hz, cpu_count);
+    for(i = 0; i < cpu_count; i++){
+        cpu = &cpus[i];
+        if(cpu->terminal != NULL){
+            length += snprintf(buf + length, size - length, "cpu%u:     pid %u terminal %d level %d, %u queued, %u stolen\n",
+                    i, cpu->pid, cpu->terminal->terminal_num + 1, cpu->terminal->level, cpu->rq_count, cpu->steals);
+        } else{
+            length += snprintf(buf + length, size - length, "cpu%u:     idle, %u queued, %u stolen\n",
+                    i, cpu->rq_count, cpu->steals);
+        }
+    }
+    return length;
+}
+
+/*
+ * proc_bcache
+ *   DESCRIPTION: Render buffer cache counters
+ *   INPUTS: buf - output buffer, size - capacity of buf
+ *   OUTPUTS: "<field>: <value>" lines; all 0 when the file system is not on a disk
+ *   RETURN VALUE: length of the text
+ *   SIDE EFFECTS: none
+ */
+static uint32_t proc_bcache(int8_t* buf, uint32_t size){
+    return snprintf(buf, size,
+            "blocks:    %u of %u\n"
+            "hits:      %u\n"
+            "misses:    %u\n"
+            "readahead: %u\n"
+            "writes:    %u\n",
+            bcache_stats.cached, BCACHE_BLOCKS,
+            bcache_stats.hits, bcache_stats.misses, bcache_stats.readahead, bcache_stats.writes);
+}
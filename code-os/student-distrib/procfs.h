@@ -0,0 +1,52 @@
+#ifndef _PROCFS_H
+#define _PROCFS_H
+
+#include "types.h"
+
+/* Synthetic "proc/" files.
+ * They share one file operations table; the inode number stored in the file
+ * array picks which file is open. Every read renders the file afresh from
+ * live kernel state and returns the part at the current file position, so
+ * monitors can simply reopen (or keep reading) to poll. */
+
+#define PROC_PROCESSES      0           // pid, parent, terminal, CPU ticks, program per process
+#define PROC_MEMINFO        1           // physical memory use
+#define PROC_INTERRUPTS     2           // interrupts taken per IRQ line
+#define PROC_SCHED          3           // uptime, running pid, run queue length
+#define PROC_BCACHE         4           // disk buffer cache hits and misses
+#define PROC_NUM_FILES      5
+
+#define PROC_BUF_SIZE       1024        // largest rendered file
+
+/*
+ * proc_open, proc_close
+ *   DESCRIPTION: Open/close a proc/ file
+ *   INPUTS: filename / fd
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t proc_open(const uint8_t* filename);
+int32_t proc_close(int32_t fd);
+
+/*
+ * proc_read
+ *   DESCRIPTION: Render the open proc/ file and copy out the part at the file position
+ *   INPUTS: fd - file descriptor, buf - user buffer, nbytes - size of buf
+ *   OUTPUTS: text, see PROC_* above
+ *   RETURN VALUE: number of bytes copied, 0 at the end of the file, -1 for a bad file
+ *   SIDE EFFECTS: Advances the file position
+ */
+int32_t proc_read(int32_t fd, void* buf, int32_t nbytes);
+
+/*
+ * proc_write
+ *   DESCRIPTION: proc/ files are read only
+ *   INPUTS: ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECTS: none
+ */
+int32_t proc_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* _PROCFS_H */
@@ -0,0 +1,173 @@
+#include "profile.h"
+#include "lib.h"
+#include "pit.h"
+#include "x86_desc.h"
+#include "systemcall.h"
+#include "fd.h"
+
+#define PROFILE_LINE_SIZE   80              // longest rendered line, with room to spare
+#define PROFILE_HASH_MULT   0x9E3779B1      // Fibonacci hashing multiplier
+
+volatile uint32_t profile_enabled = 0;
+
+static profile_bucket_t profile_buckets[PROFILE_NUM_BUCKETS];
+static uint32_t profile_samples = 0;
+static uint32_t profile_dropped = 0;
+static spinlock_t profile_lock = SPINLOCK_INIT;    // every CPU's timer samples into the same table
+
+static void profile_image_name(const profile_bucket_t* bucket, int8_t* name);
+
+/*
+ * profile_sample
+ *   DESCRIPTION: Count one timer sample (called from timer_tick)
+ *   INPUTS: eip, cs - interrupted instruction pointer and code segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Bumps the bucket for (eip, pid, image), or the drop counter
+ *                 if the table is too full around that key
+ */
+void profile_sample(uint32_t eip, uint32_t cs){
+    uint32_t user = ((cs & 0x3) == 0x3);
+    uint32_t inode = user ? get_pcb(cur_pid)->exe_inode : 0;
+    uint32_t index = ((eip ^ (cur_pid << 24)) * PROFILE_HASH_MULT) >> (32 - PROFILE_BUCKET_BITS);
+    profile_bucket_t* bucket;
+    int i;
+
+    spin_lock(&profile_lock);
+    profile_samples++;
+    for(i = 0; i < PROFILE_MAX_PROBE; i++){
+        bucket = &profile_buckets[(index + i) & PROFILE_BUCKET_MASK];
+        if(bucket->count == 0){
+            bucket->eip = eip;
+            bucket->pid = cur_pid;
+            bucket->user = user;
+            bucket->inode = inode;
+            bucket->count = 1;
+            spin_unlock(&profile_lock);
+            return;
+        }
+        if(bucket->eip == eip && bucket->pid == cur_pid && bucket->user == user && bucket->inode == inode){
+            bucket->count++;
+            spin_unlock(&profile_lock);
+            return;
+        }
+    }
+    profile_dropped++;
+    spin_unlock(&profile_lock);
+}
+
+/*
+ * profile_open, profile_close
+ *   DESCRIPTION: Open/close the "profile" device file
+ *   INPUTS: filename / fd
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t profile_open(const uint8_t* filename){
+    return 0;
+}
+
+int32_t profile_close(int32_t fd){
+    return 0;
+}
+
+/*
+ * profile_read
+ *   DESCRIPTION: Render the histogram as text, one bucket per line
+ *   INPUTS: fd - profile file descriptor, buf - user buffer, nbytes - size of buf
+ *   OUTPUTS: "<eip> <pid> <image> <count>" lines, then a summary line
+ *   RETURN VALUE: number of bytes written (whole lines only), 0 at the end
+ *   SIDE EFFECTS: Advances the file position (a bucket index)
+ */
+int32_t profile_read(int32_t fd, void* buf, int32_t nbytes){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    int8_t line[PROFILE_LINE_SIZE];
+    int8_t name[MAX_FILE_NAME + 1];
+    profile_bucket_t bucket;
+    int32_t bytes_read = 0;
+    int32_t line_length;
+
+    while(file->file_position <= PROFILE_NUM_BUCKETS){
+        if(file->file_position == PROFILE_NUM_BUCKETS){
+            line_length = snprintf(line, PROFILE_LINE_SIZE, "# samples=%u dropped=%u\n",
+                    profile_samples, profile_dropped);
+        } else{
+            bucket = profile_buckets[file->file_position];
+            if(bucket.count == 0){
+                file->file_position++;
+                continue;
+            }
+            profile_image_name(&bucket, name);
+            line_length = snprintf(line, PROFILE_LINE_SIZE, "%#x %u %s %u\n",
+                    bucket.eip, (uint32_t)bucket.pid, name, bucket.count);
+        }
+        if(bytes_read + line_length > nbytes){
+            break;                              // only whole lines
+        }
+        memcpy((int8_t*)buf + bytes_read, line, line_length);
+        bytes_read += line_length;
+        file->file_position++;
+    }
+
+    return bytes_read;
+}
+
+/*
+ * profile_write
+ *   DESCRIPTION: Start or stop sampling
+ *   INPUTS: buf - pointer to an int32_t: 0 stops, 1 starts at PROFILE_DEFAULT_HZ,
+ *                 anything else starts at that many samples per second
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on bad input
+ *   SIDE EFFECTS: Starting clears the histogram and speeds up the timer;
+ *                 stopping puts the timer back to its default rate
+ */
+int32_t profile_write(int32_t fd, const void* buf, int32_t nbytes){
+    int32_t hz;
+    uint32_t flags;
+
+    if(buf == NULL || nbytes < sizeof(int32_t)){
+        return -1;
+    }
+    hz = *(int32_t*)buf;
+    if(hz < 0 || hz > PROFILE_MAX_HZ){
+        return -1;
+    }
+
+    spin_lock_irqsave(&profile_lock, flags);
+    if(hz == 0){
+        profile_enabled = 0;
+        timer_set_rate(pit_default_hz);
+    } else{
+        memset(profile_buckets, 0, sizeof(profile_buckets));
+        profile_samples = 0;
+        profile_dropped = 0;
+        timer_set_rate(hz == 1 ? PROFILE_DEFAULT_HZ : hz);
+        profile_enabled = 1;
+    }
+    spin_unlock_irqrestore(&profile_lock, flags);
+    return 0;
+}
+
+/*
+ * profile_image_name
+ *   DESCRIPTION: Name the image a sample's EIP belongs to
+ *   INPUTS: bucket - histogram bucket, name - buffer of MAX_FILE_NAME + 1 bytes
+ *   OUTPUTS: "bootimg" for kernel samples, otherwise the executable's file name
+ *            ("?" if it is no longer in the boot image)
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void profile_image_name(const profile_bucket_t* bucket, int8_t* name){
+    dentry_t dentry;
+
+    if(!bucket->user){
+        strcpy(name, "bootimg");
+    } else if(read_dentry_by_inode(bucket->inode, &dentry) == 0){
+        strncpy(name, dentry.file_name, MAX_FILE_NAME);
+        name[MAX_FILE_NAME] = '\0';
+    } else{
+        strcpy(name, "?");
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "types.h"
+
+/* Timer sampling profiler (PIT, or the LAPIC timer when apic.c found one).
+ * While enabled, every timer interrupt counts the interrupted EIP in a hash
+ * table keyed by (eip, pid, image). Start/stop it by writing a rate to the
+ * "profile" device file and read the histogram back as text; profsym.sh
+ * turns that text into per-function counts using bootimg and the user .exe
+ * files. */
+
+#define PROFILE_BUCKET_BITS 11
+#define PROFILE_NUM_BUCKETS (1 << PROFILE_BUCKET_BITS)     // distinct sample points kept
+#define PROFILE_BUCKET_MASK (PROFILE_NUM_BUCKETS - 1)
+#define PROFILE_MAX_PROBE   16              // linear probe limit before a sample is dropped
+#define PROFILE_MAX_HZ      10000           // fastest sampling rate accepted
+#define PROFILE_DEFAULT_HZ  1000            // rate used when 1 is written
+
+/* One histogram bucket; count == 0 marks an empty bucket */
+typedef struct {
+    uint32_t eip;
+    uint16_t pid;
+    uint16_t user;                          // 1 if sampled at CPL 3
+    uint32_t inode;                         // executable of pid for user samples
+    uint32_t count;
+} profile_bucket_t;
+
+/* 1 while the timer handler is taking samples */
+extern volatile uint32_t profile_enabled;
+
+/*
+ * profile_sample
+ *   DESCRIPTION: Count one timer sample (called from timer_tick)
+ *   INPUTS: eip, cs - interrupted instruction pointer and code segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Bumps the bucket for (eip, pid, image), or the drop counter
+ *                 if the table is too full around that key
+ */
+void profile_sample(uint32_t eip, uint32_t cs);
+
+/*
+ * profile_open, profile_close
+ *   DESCRIPTION: Open/close the "profile" device file
+ *   INPUTS: filename / fd
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t profile_open(const uint8_t* filename);
+int32_t profile_close(int32_t fd);
+
+/*
+ * profile_read
+ *   DESCRIPTION: Render the histogram as text, one bucket per line
+ *   INPUTS: fd - profile file descriptor, buf - user buffer, nbytes - size of buf
+ *   OUTPUTS: "<eip> <pid> <image> <count>" lines, image being "bootimg" for
+ *            kernel samples or the program name, then a "# samples=N dropped=N" line
+ *   RETURN VALUE: number of bytes written (whole lines only), 0 at the end
+ *   SIDE EFFECTS: Advances the file position (a bucket index)
+ */
+int32_t profile_read(int32_t fd, void* buf, int32_t nbytes);
+
+/*
+ * profile_write
+ *   DESCRIPTION: Start or stop sampling
+ *   INPUTS: buf - pointer to an int32_t: 0 stops, 1 starts at PROFILE_DEFAULT_HZ,
+ *                 anything else starts at that many samples per second
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on bad input
+ *   SIDE EFFECTS: Starting clears the histogram and speeds up the timer;
+ *                 stopping puts the timer back to its default rate
+ */
+int32_t profile_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* _PROFILE_H */
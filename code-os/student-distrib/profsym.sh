@@ -0,0 +1,33 @@
+#!/bin/bash
+#
+# Symbolize the output of the "prof" user program.
+#   usage: ./profsym.sh <saved prof output> [directory holding the user .exe files]
+# Kernel samples are looked up in ./bootimg, user samples in <name>.exe from
+# ../syscalls (both keep their symbols; the copies in fsdir are stripped).
+# Prints samples per function, busiest first.
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <prof output> [syscalls dir]"
+    exit 1
+fi
+
+HERE=$(dirname "$0")
+EXE_DIR=${2:-$HERE/../syscalls}
+
+grep -E '^[0-9A-F]{8} [0-9]+ [^ ]+ [0-9]+$' "$1" |
+while read eip pid image count; do
+    if [ "$image" = "bootimg" ]; then
+        elf=$HERE/bootimg
+    else
+        elf=$EXE_DIR/$image.exe
+    fi
+    if [ -f "$elf" ]; then
+        func=$(addr2line -f -e "$elf" "$eip" | head -n 1)
+    else
+        func="??"
+    fi
+    echo "$count $image $func"
+done |
+awk '{ n[$2 " " $3] += $1; total += $1 }
+     END { for (f in n) printf "%8d %5.1f%%  %s\n", n[f], 100 * n[f] / total, f }' |
+sort -rn
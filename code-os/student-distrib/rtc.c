@@ -1,12 +1,16 @@
 #include "rtc.h"
 #include "i8259.h"
 #include "lib.h"
+#include "sched.h"
+#include "poll.h"
 // #include <cmath> 
 //#include <stdio.h> 
 
 
 volatile int rtc_counter;
 volatile int rtc_interrupt;
+static wait_queue_t rtc_wait = WAIT_QUEUE_INIT;  // tasks in rtc_read
+static spinlock_t rtc_lock = SPINLOCK_INIT;    // CMOS index/data pair: rtc_write may run on any CPU
 
 
 //int rtc_inti()
@@ -54,9 +58,13 @@ void rtc_handler(){
         test_interrupts();
     }
     rtc_interrupt = 1;
+    sched_wake(&rtc_wait);
+    poll_notify();
     //read Reg C for irq to happen again:: from OSDev
+    spin_lock(&rtc_lock);
     outb(Reg_C, rtc_port_reg); // select register C
     inb(rtc_port_data);        // just throw away contents
+    spin_unlock(&rtc_lock);
     send_eoi(rtc_irq_line);
 }
 
@@ -81,6 +89,7 @@ int rtc_write(int32_t fd, const void* buf, int32_t nbytes){
 //Effect: changes the freq 
 int32_t rtc_change_freq(int32_t frequency){
     unsigned char rate;
+    uint32_t flags;
     
     //frequency =  32768 >> (rate-1);
     switch (frequency)
@@ -132,12 +141,12 @@ int32_t rtc_change_freq(int32_t frequency){
     }
     //from OSDEVC
     rate &= 0x0F;                   // to mask it under 15
-    cli();
+    spin_lock_irqsave(&rtc_lock, flags);
     outb(Reg_A, rtc_port_reg);		// set index to register A, disable NMI
     char prev=inb(rtc_port_data);	// get initial value of register A
     outb(Reg_A, rtc_port_reg);		// reset index to A
     outb(((prev & 0xF0) | rate),rtc_port_data); //write only our rate to A. Note, rate is the bottom 4 bits.
-    sti();
+    spin_unlock_irqrestore(&rtc_lock, flags);
 
 
     return 0;
@@ -155,22 +164,30 @@ int32_t rtc_change_freq(int32_t frequency){
     if (rtc_change_freq(2) == -1){
         return -1;
     } //set to default 2Hz
+    rtc_interrupt = 0;          //the first read waits for an interrupt at the new rate
     return 0;
  }
 
 // int32_t rtc_read()
 //Input: N/A
 //Output: 0 if sucess   
-//Effect: block the function for set amount of time
+//Effect: block until an interrupt, or return at once if there was one since
+//        the last read (the one poll reported)
  int32_t rtc_read(){
-    rtc_interrupt = 0;
     //block the function
-    while (rtc_interrupt == 0){
-        //printf("waiting");
-    }
+    sched_wait(&rtc_wait, &rtc_interrupt);
+    rtc_interrupt = 0;
     return 0;
  }
 
+// int32_t rtc_poll(int32_t fd)
+//Input: fd
+//Output: POLLIN if a read would return at once, and POLLOUT (setting the rate never blocks)
+//Effect: N/A
+ int32_t rtc_poll(int32_t fd){
+    return (rtc_interrupt ? POLLIN : 0) | POLLOUT;
+ }
+
 
 // close(int32_t fd)
 //Input: fd
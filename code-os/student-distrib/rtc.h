@@ -40,8 +40,10 @@ extern int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 
 //changes the rtc freq to 2
 extern int32_t rtc_open(const uint8_t* filename);
-//blocks a function for a period of time
+//blocks until an interrupt, unless there was one since the last read
 extern int32_t rtc_read();
+//POLLIN once there was an interrupt since the last read
+extern int32_t rtc_poll(int32_t fd);
 //closes the file
 extern int32_t rtc_close(int32_t fd);
 
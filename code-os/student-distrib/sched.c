@@ -0,0 +1,553 @@
+/* sched.c - Per-CPU run queues and task switching
+ * vim:ts=4 noexpandtab
+ */
+
+#include "sched.h"
+#include "systemcall.h"
+#include "trace.h"
+#include "pit.h"
+
+/* kernel stacks the terminals' shells are started on; later processes run
+ * on their own stacks below the PCBs */
+static uint8_t task_stacks[NUM_TERMINALS][SCHED_STACK_SIZE] __attribute__((aligned (16)));
+
+static void terminal_task(void);
+static void sched_finish_switch(void);
+static terminal_struct* sched_steal(cpu_t* thief);
+static void sched_wakeup(terminal_struct* task);
+static void sched_boost(cpu_t* cpu);
+static void sched_kick(cpu_t* cpu);
+static int task_top_level(terminal_struct* task);
+static int task_bottom_level(terminal_struct* task);
+static void rq_push(cpu_t* cpu, terminal_struct* task);
+static terminal_struct* rq_pop(cpu_t* cpu);
+static void rq_remove(cpu_t* cpu, terminal_struct* task);
+
+/*
+ * sched_start
+ *   DESCRIPTION: Make a terminal runnable: its task will execute a shell
+ *   INPUTS: term - terminal that has no task yet
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Builds the task's first frame and queues it on its CPU
+ */
+void sched_start(terminal_struct* term){
+    cpu_t* cpu = &cpus[term->terminal_num % cpu_count];
+    uint32_t* sp = (uint32_t*)(task_stacks[term->terminal_num] + SCHED_STACK_SIZE);
+    uint32_t flags;
+
+    // what context_switch pops: edi, esi, ebx, ebp, then it returns into terminal_task
+    *--sp = 0;                              // terminal_task's return address (it never returns)
+    *--sp = (uint32_t)terminal_task;
+    *--sp = 0;                              // ebp
+    *--sp = 0;                              // ebx
+    *--sp = 0;                              // esi
+    *--sp = 0;                              // edi
+    term->sched_esp = (uint32_t)sp;
+    term->sched_pid = 0;
+    term->on_cpu = 0;
+    term->last_ran = 0;
+    term->state = TASK_RUNNABLE;
+    term->level = 0;
+    term->slice = SCHED_QUANTUM(0);
+    term->wait_next = NULL;
+    term->cpu = cpu->index;
+
+    spin_lock_irqsave(&cpu->rq_lock, flags);
+    rq_push(cpu, term);
+    spin_unlock(&cpu->rq_lock);
+    sched_kick(cpu);
+    restore_flags(flags);
+}
+
+/*
+ * schedule
+ *   DESCRIPTION: Switch the calling CPU to the best task in its run queue,
+ *                or to one stolen from another CPU when nothing else is queued
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (returns when this context is picked again)
+ *   SIDE EFFECTS: Requeues the running task behind the others at its level
+ *                 unless it blocked; loads the next one's user page and kernel
+ *                 stack into this CPU, or idles if there is none
+ */
+void schedule(void){
+    cpu_t* cpu = this_cpu();
+    terminal_struct* prev = cpu->terminal;
+    terminal_struct* next;
+    terminal_struct* stolen;
+
+    spin_lock(&cpu->rq_lock);
+    if(prev != NULL && prev->state == TASK_RUNNABLE){
+        rq_push(cpu, prev);                 // stays on_cpu, so nobody steals it, until its context is saved
+    }
+    next = rq_pop(cpu);
+    if(next == prev){
+        // nothing else here (prev, if any, is runnable): look at the other CPUs
+        spin_unlock(&cpu->rq_lock);         // a thief holds one queue lock at a time
+        stolen = sched_steal(cpu);
+        spin_lock(&cpu->rq_lock);
+        if(stolen != NULL){
+            if(prev != NULL){
+                rq_push(cpu, prev);
+            }
+            next = stolen;
+        }
+    }
+    if(next != NULL){
+        next->cpu = cpu->index;
+    }
+    cpu->terminal = next;                   // under the lock: sched_wakeup looks at it
+    spin_unlock(&cpu->rq_lock);
+    if(next == prev){
+        return;                             // nothing else to run: keep going
+    }
+
+    TRACE(TRACE_SCHED, prev ? prev->terminal_num : -1, next ? next->terminal_num : -1);
+    if(prev != NULL){
+        prev->sched_pid = cpu->pid;
+        prev->last_ran = pit_ticks;
+    }
+    if(next != NULL){
+        next->on_cpu = 1;
+        cpu->pid = next->sched_pid;
+        process_load(cpu->pid);
+    }
+    cpu->switched_from = prev;
+    context_switch(prev ? &prev->sched_esp : &cpu->idle_esp, next ? next->sched_esp : cpu->idle_esp);
+    sched_finish_switch();                  // possibly on another CPU by now
+}
+
+/*
+ * sched_tick
+ *   DESCRIPTION: Charge a timer tick to the running task
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Demotes a task whose quantum ran out, boosts every task
+ *                 each SCHED_BOOST_TICKS, and calls schedule when the
+ *                 running task should give way
+ */
+void sched_tick(void){
+    cpu_t* cpu = this_cpu();
+    terminal_struct* task = cpu->terminal;
+    int top, bottom;
+
+    if(++cpu->boost_ticks >= SCHED_BOOST_TICKS){
+        cpu->boost_ticks = 0;
+        sched_boost(cpu);
+    }
+    if(task == NULL){
+        schedule();                         // idle: look for work on the other CPUs
+        return;
+    }
+
+    // nice may have changed since the task got its level
+    top = task_top_level(task);
+    bottom = task_bottom_level(task);
+    if(task->level < top){
+        task->level = top;
+    } else if(task->level > bottom){
+        task->level = bottom;
+    }
+
+    if(--task->slice <= 0){
+        if(task->level < bottom){
+            task->level++;                  // used its whole quantum: CPU bound
+        }
+        task->slice = SCHED_QUANTUM(task->level);
+        schedule();
+    } else if(cpu->rq_mask & ((1 << task->level) - 1)){
+        schedule();                         // something better was woken meanwhile
+    }
+}
+
+/*
+ * sched_wait
+ *   DESCRIPTION: Block the calling task until *cond is non-zero
+ *   INPUTS: wq - queue the waker will call sched_wake on
+ *           cond - condition the waker sets before sched_wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Lets other tasks run meanwhile; spins instead if there is no
+ *                 task yet (before the scheduler starts)
+ */
+void sched_wait(wait_queue_t* wq, volatile int* cond){
+    terminal_struct* task;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    task = this_cpu()->terminal;
+    if(task == NULL){
+        restore_flags(flags);
+        while(!*cond);
+        return;
+    }
+    while(!*cond){
+        // tested again under the queue lock: sched_wake takes it after cond is set
+        spin_lock(&wq->lock);
+        if(*cond){
+            spin_unlock(&wq->lock);
+            break;
+        }
+        task->state = TASK_BLOCKED;
+        task->wait_next = wq->head;
+        wq->head = task;
+        spin_unlock(&wq->lock);
+        schedule();
+    }
+    restore_flags(flags);
+}
+
+/*
+ * sched_wake
+ *   DESCRIPTION: Make every task waiting on a queue runnable again
+ *   INPUTS: wq - the queue
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Woken tasks go back to their top MLFQ level
+ */
+void sched_wake(wait_queue_t* wq){
+    sched_wake_cond(wq, NULL);
+}
+
+/*
+ * sched_wake_cond
+ *   DESCRIPTION: Set a waiter's condition and wake the queue in one step
+ *   INPUTS: wq - the queue, cond - the condition its waiter passed to sched_wait,
+ *           NULL for sched_wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: cond is set under the queue lock, which sched_wait tests it
+ *                 under, so neither is touched once the waiter can return
+ */
+void sched_wake_cond(wait_queue_t* wq, volatile int* cond){
+    terminal_struct* task;
+    terminal_struct* next;
+    uint32_t flags;
+
+    spin_lock_irqsave(&wq->lock, flags);
+    if(cond != NULL){
+        *cond = 1;
+    }
+    task = wq->head;
+    wq->head = NULL;
+    spin_unlock(&wq->lock);
+    while(task != NULL){
+        next = task->wait_next;             // before it can run and wait again
+        task->wait_next = NULL;
+        sched_wakeup(task);
+        task = next;
+    }
+    restore_flags(flags);
+}
+
+/*
+ * sleep_lock
+ *   DESCRIPTION: Take a sleep lock
+ *   INPUTS: lock - the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Blocks while another task holds it; counts it in the
+ *                 task's sleep_locks
+ */
+void sleep_lock(sleep_lock_t* lock){
+    terminal_struct* task;
+    uint32_t flags;
+
+    while(1){
+        spin_lock_irqsave(&lock->lock, flags);
+        if(lock->free){
+            lock->free = 0;
+            spin_unlock_irqrestore(&lock->lock, flags);
+            task = this_cpu()->terminal;
+            if(task != NULL){
+                task->sleep_locks++;
+            }
+            return;
+        }
+        spin_unlock_irqrestore(&lock->lock, flags);
+        // woken when it comes free; another waiter may get there first
+        sched_wait(&lock->wq, &lock->free);
+    }
+}
+
+/*
+ * sleep_unlock
+ *   DESCRIPTION: Give back a sleep lock
+ *   INPUTS: lock - held by the caller
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wakes the tasks waiting for it
+ */
+void sleep_unlock(sleep_lock_t* lock){
+    terminal_struct* task = this_cpu()->terminal;
+
+    if(task != NULL){
+        task->sleep_locks--;
+    }
+    lock->free = 1;
+    sched_wake(&lock->wq);
+}
+
+/*
+ * sched_wakeup
+ *   DESCRIPTION: Make a blocked task runnable on the CPU it last ran on
+ *   INPUTS: task - task taken off a wait queue
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Boosts it to its top level; queues it unless its CPU has
+ *                 not switched away from it yet (schedule requeues it then)
+ */
+static void sched_wakeup(terminal_struct* task){
+    cpu_t* cpu = &cpus[task->cpu];          // does not change while it is blocked
+    int queued = 0;
+
+    spin_lock(&cpu->rq_lock);
+    if(task->state == TASK_BLOCKED){
+        task->state = TASK_RUNNABLE;
+        task->level = task_top_level(task);
+        task->slice = SCHED_QUANTUM(task->level);
+        if(cpu->terminal != task){
+            rq_push(cpu, task);
+            queued = 1;
+        }
+    }
+    spin_unlock(&cpu->rq_lock);
+    if(queued){
+        sched_kick(cpu);
+    }
+}
+
+/*
+ * sched_kick
+ *   DESCRIPTION: Get a halted CPU to pick up a task just queued on cpu: cpu
+ *                itself if it is idle, otherwise an idle CPU that can steal it
+ *   INPUTS: cpu - CPU the task was queued on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may send a wakeup IPI; idle CPUs have no tick to notice
+ *                 the task by themselves
+ */
+static void sched_kick(cpu_t* cpu){
+    cpu_t* self = this_cpu();
+    uint32_t i;
+
+    if(cpu->terminal == NULL){
+        if(cpu != self){
+            smp_wakeup(cpu);                // the calling CPU looks at its queue on its way out
+        }
+        return;
+    }
+    for(i = 0; i < cpu_count; i++){
+        if(&cpus[i] != self && cpus[i].terminal == NULL && cpus[i].idle_ticks){
+            smp_wakeup(&cpus[i]);
+            return;
+        }
+    }
+}
+
+/*
+ * sched_boost
+ *   DESCRIPTION: Move every task of a CPU back to its top level
+ *   INPUTS: cpu - calling CPU
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Resets their quanta, so CPU-bound tasks cannot starve the rest
+ */
+static void sched_boost(cpu_t* cpu){
+    terminal_struct* moved[NUM_TERMINALS];
+    terminal_struct* task;
+    int level, count, i;
+
+    spin_lock(&cpu->rq_lock);
+    count = 0;
+    for(level = 1; level < SCHED_LEVELS; level++){
+        while((task = cpu->rq_head[level]) != NULL){
+            rq_remove(cpu, task);
+            moved[count++] = task;
+        }
+    }
+    for(i = 0; i < count; i++){
+        moved[i]->level = task_top_level(moved[i]);
+        moved[i]->slice = SCHED_QUANTUM(moved[i]->level);
+        rq_push(cpu, moved[i]);
+    }
+    if((task = cpu->terminal) != NULL){
+        task->level = task_top_level(task);
+        task->slice = SCHED_QUANTUM(task->level);
+    }
+    spin_unlock(&cpu->rq_lock);
+}
+
+/*
+ * task_top_level, task_bottom_level
+ *   DESCRIPTION: Highest/lowest MLFQ level the nice value of a task allows
+ *   INPUTS: task - the task; its newest process sets the nice value
+ *   OUTPUTS: none
+ *   RETURN VALUE: the level
+ *   SIDE EFFECTS: none
+ */
+static int task_top_level(terminal_struct* task){
+    pcb_struct* pcb = task->curr_pcb_ptr;
+
+    if(pcb == NULL || pcb->nice <= 0){
+        return 0;
+    }
+    return pcb->nice * SCHED_LEVELS / (NICE_MAX + 1);
+}
+
+static int task_bottom_level(terminal_struct* task){
+    pcb_struct* pcb = task->curr_pcb_ptr;
+
+    if(pcb == NULL || pcb->nice >= 0){
+        return SCHED_LEVELS - 1;
+    }
+    return (SCHED_LEVELS - 1) - (-pcb->nice) * SCHED_LEVELS / (-NICE_MIN + 1);
+}
+
+/*
+ * sched_finish_switch
+ *   DESCRIPTION: Complete a switch on the context that was switched to
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The task switched out can now be stolen
+ */
+static void sched_finish_switch(void){
+    cpu_t* cpu = this_cpu();
+
+    if(cpu->switched_from != NULL){
+        cpu->switched_from->on_cpu = 0;
+        cpu->switched_from = NULL;
+    }
+}
+
+/*
+ * sched_steal
+ *   DESCRIPTION: Take a task off the tail of the busiest other run queue,
+ *                lowest level first
+ *   INPUTS: thief - calling CPU, with nothing else queued
+ *   OUTPUTS: none
+ *   RETURN VALUE: the task, NULL if no CPU has two tasks more than the thief
+ *   SIDE EFFECTS: Moves the task to the thief; counts the steal
+ */
+static terminal_struct* sched_steal(cpu_t* thief){
+    uint32_t load = thief->rq_count + (thief->terminal != NULL);
+    uint32_t busiest = load + 1;
+    uint32_t other, i;
+    int level;
+    cpu_t* victim = NULL;
+    terminal_struct* task = NULL;
+    terminal_struct* hot = NULL;
+
+    // the counts are read unlocked: a stale one only costs a wasted look
+    for(i = 0; i < cpu_count; i++){
+        other = cpus[i].rq_count + (cpus[i].terminal != NULL);
+        if(&cpus[i] != thief && other > busiest){
+            victim = &cpus[i];
+            busiest = other;
+        }
+    }
+    if(victim == NULL){
+        return NULL;
+    }
+
+    spin_lock(&victim->rq_lock);
+    for(level = SCHED_LEVELS - 1; level >= 0 && task == NULL; level--){
+        for(task = victim->rq_tail[level]; task != NULL; task = task->rq_prev){
+            if(task->on_cpu){
+                continue;                   // just switched out, context not saved yet
+            }
+            if(pit_ticks - task->last_ran >= SCHED_CACHE_HOT_TICKS){
+                break;
+            }
+            if(hot == NULL){
+                hot = task;                 // only if there is nothing colder
+            }
+        }
+    }
+    if(task == NULL){
+        task = hot;
+    }
+    if(task != NULL){
+        rq_remove(victim, task);
+        thief->steals++;
+    }
+    spin_unlock(&victim->rq_lock);
+    return task;
+}
+
+/*
+ * terminal_task
+ *   DESCRIPTION: Body of a new task (the first context_switch returns here)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: never returns
+ *   SIDE EFFECTS: Runs the terminal's shell; halt restarts a base shell in
+ *                 place, so execute only comes back if no pid was free
+ */
+static void terminal_task(void){
+    sched_finish_switch();
+    sti();
+    while(execute((const uint8_t*) "shell") == -1){
+        asm volatile ("hlt");               // try again once a process has exited
+    }
+}
+
+/*
+ * rq_push, rq_pop, rq_remove
+ *   DESCRIPTION: Append a task at its level / take the oldest task of the
+ *                highest level or a given task off a run queue
+ *   INPUTS: cpu - owner of the queue, task - task to append or remove
+ *   OUTPUTS: none
+ *   RETURN VALUE: the task taken, NULL if the queue is empty (rq_pop)
+ *   SIDE EFFECTS: caller holds cpu->rq_lock
+ */
+static void rq_push(cpu_t* cpu, terminal_struct* task){
+    int level = task->level;
+
+    task->rq_next = NULL;
+    task->rq_prev = cpu->rq_tail[level];
+    if(cpu->rq_tail[level] != NULL){
+        cpu->rq_tail[level]->rq_next = task;
+    } else{
+        cpu->rq_head[level] = task;
+    }
+    cpu->rq_tail[level] = task;
+    cpu->rq_mask |= 1 << level;
+    cpu->rq_count++;
+}
+
+static terminal_struct* rq_pop(cpu_t* cpu){
+    terminal_struct* task;
+    int level;
+
+    for(level = 0; level < SCHED_LEVELS; level++){
+        if((task = cpu->rq_head[level]) != NULL){
+            rq_remove(cpu, task);
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static void rq_remove(cpu_t* cpu, terminal_struct* task){
+    int level = task->level;
+
+    if(task->rq_prev != NULL){
+        task->rq_prev->rq_next = task->rq_next;
+    } else{
+        cpu->rq_head[level] = task->rq_next;
+    }
+    if(task->rq_next != NULL){
+        task->rq_next->rq_prev = task->rq_prev;
+    } else{
+        cpu->rq_tail[level] = task->rq_prev;
+    }
+    if(cpu->rq_head[level] == NULL){
+        cpu->rq_mask &= ~(1 << level);
+    }
+    task->rq_next = task->rq_prev = NULL;
+    cpu->rq_count--;
+}
@@ -0,0 +1,125 @@
+/* sched.h - Per-CPU run queues and task switching
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include "types.h"
+#include "smp.h"
+#include "terminal.h"
+
+/* A task is a terminal: the chain of processes started from its shell runs
+ * on one kernel stack at a time (a parent waits inside execute until its
+ * child halts), so switching tasks means switching to the newest process of
+ * another terminal. Every task is queued on one CPU, terminal n on CPU
+ * n % cpu_count to start with. A CPU whose queue runs dry steals from the
+ * tail of the busiest other queue when that one is at least two tasks
+ * ahead. It passes over tasks that ran within the last
+ * SCHED_CACHE_HOT_TICKS, whose cache is still warm where they are, unless
+ * nothing else is queued there.
+ *
+ * Each CPU runs a multi-level feedback queue: the highest non-empty level
+ * first, round robin within a level. A task that uses up the quantum of its
+ * level drops a level; one woken from sched_wait (keyboard, RTC) goes back to
+ * its top level, and every SCHED_BOOST_TICKS all of them do. The nice value
+ * of the task's newest process bounds the levels: nice > 0 lowers the top
+ * level, nice < 0 raises the bottom one (NICE_MIN never drops below 0). */
+
+#define SCHED_STACK_SIZE        0x2000      // kernel stack a terminal's shell is started on
+#define SCHED_CACHE_HOT_TICKS   4           // a task switched out this recently still has its cache warm
+#define SCHED_QUANTUM(level)    (1 << (level))  // ticks a task runs at a level before it drops
+#define SCHED_BOOST_TICKS       100         // every task back to its top level this often
+
+/*
+ * sched_start
+ *   DESCRIPTION: Make a terminal runnable: its task will execute a shell
+ *   INPUTS: term - terminal that has no task yet
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Builds the task's first frame and queues it on its CPU
+ */
+void sched_start(terminal_struct* term);
+
+/*
+ * schedule
+ *   DESCRIPTION: Switch the calling CPU to the best task in its run queue
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (returns when this context is picked again)
+ *   SIDE EFFECTS: Requeues the running task behind the others at its level
+ *                 unless it is blocked. Call with interrupts off and no
+ *                 spinlock held.
+ */
+void schedule(void);
+
+/*
+ * sched_tick
+ *   DESCRIPTION: Charge a timer tick to the running task
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Demotes a task whose quantum ran out, boosts every task
+ *                 each SCHED_BOOST_TICKS, and calls schedule when the
+ *                 running task should give way. Interrupts off.
+ */
+void sched_tick(void);
+
+/*
+ * sched_wait
+ *   DESCRIPTION: Block the calling task until *cond is non-zero
+ *   INPUTS: wq - queue the waker will call sched_wake on
+ *           cond - condition the waker sets before sched_wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Lets other tasks run meanwhile; spins instead if there is no
+ *                 task yet (before the scheduler starts)
+ */
+void sched_wait(wait_queue_t* wq, volatile int* cond);
+
+/*
+ * sched_wake
+ *   DESCRIPTION: Make every task waiting on a queue runnable again
+ *   INPUTS: wq - the queue
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Woken tasks go back to their top MLFQ level. Safe from
+ *                 interrupt handlers.
+ */
+void sched_wake(wait_queue_t* wq);
+
+/*
+ * sched_wake_cond
+ *   DESCRIPTION: Set a waiter's condition and wake the queue in one step
+ *   INPUTS: wq - the queue, cond - the condition its waiter passed to sched_wait
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Neither is touched once the waiter can see cond set, so
+ *                 both may live on the waiter's stack. Safe from interrupt handlers.
+ */
+void sched_wake_cond(wait_queue_t* wq, volatile int* cond);
+
+/*
+ * sleep_lock, sleep_unlock
+ *   DESCRIPTION: Take or give back a sleep lock
+ *   INPUTS: lock - the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sleep_lock blocks (sched_wait) while another task holds it;
+ *                 sleep_unlock wakes the waiters to try again
+ */
+void sleep_lock(sleep_lock_t* lock);
+void sleep_unlock(sleep_lock_t* lock);
+
+/*
+ * context_switch
+ *   DESCRIPTION: Save this kernel context and resume another (sched_switch.S)
+ *   INPUTS: save_esp - where to store this context's stack pointer
+ *           load_esp - stack pointer saved by an earlier context_switch
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (returns when something switches back)
+ *   SIDE EFFECTS: changes stacks
+ */
+void context_switch(uint32_t* save_esp, uint32_t load_esp);
+
+#endif /* _SCHED_H */
@@ -0,0 +1,246 @@
+/* signal.c - User signals (set_handler, sigreturn)
+ * vim:ts=4 noexpandtab
+ */
+
+#include "signal.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "terminal.h"
+#include "timer.h"
+
+#define USER_PAGE_START     ADDRESS_128MB
+#define USER_PAGE_END       (ADDRESS_128MB + ADDRESS_4MB)
+#define SIGRETURN_NUM       10              // system call number of sigreturn
+
+/* eflags bits sigreturn takes from the user stack: CF PF AF ZF SF TF DF OF AC.
+ * IF, IOPL and the rest keep what the kernel gave the process. */
+#define EFLAGS_USER_MASK    0x00040DD5
+
+/* Signals whose default action is to kill the process */
+#define SIG_DEFAULT_KILL    ((1 << SIG_DIV_ZERO) | (1 << SIG_SEGFAULT) | (1 << SIG_INTERRUPT))
+
+/* Copied onto the user stack for the handler to return to:
+ * movl $SIGRETURN_NUM, %eax; int $0x80; nop (to keep the stack aligned) */
+static const uint8_t sigreturn_code[] = {
+    0xB8, SIGRETURN_NUM, 0x00, 0x00, 0x00,
+    0xCD, 0x80,
+    0x90
+};
+
+static ktimer_t alarm_timer;
+
+static void signal_alarm(ktimer_t* timer);
+
+/*
+ * signal_init
+ *   DESCRIPTION: Start the alarm timer
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: SIG_ALARM goes to every terminal's running program each
+ *                 SIG_ALARM_TICKS from now on
+ */
+void signal_init(void){
+    alarm_timer.func = signal_alarm;
+    alarm_timer.data = NULL;
+    timer_add(&alarm_timer, pit_ticks + SIG_ALARM_TICKS);
+}
+
+/*
+ * signal_reset
+ *   DESCRIPTION: Give a process the default action for every signal
+ *   INPUTS: pcb - the process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: drops anything pending
+ */
+void signal_reset(pcb_struct* pcb){
+    int i;
+
+    for(i = 0; i < NUM_SIGNALS; i++){
+        pcb->sig_handler[i] = 0;
+    }
+    pcb->sig_pending = 0;
+    pcb->sig_masked = 0;
+}
+
+/*
+ * signal_send
+ *   DESCRIPTION: Raise a signal for a process
+ *   INPUTS: pcb - the process, signum - SIG_*
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Delivered on its next return to user mode
+ */
+void signal_send(pcb_struct* pcb, int32_t signum){
+    if(signum < 0 || signum >= NUM_SIGNALS){
+        return;
+    }
+    // the owner may be clearing another bit on a different CPU
+    asm volatile ("lock; orl %1, %0"
+                  : "+m"(pcb->sig_pending)
+                  : "r"(1 << signum)
+                  : "memory");
+}
+
+/*
+ * signal_deliver
+ *   DESCRIPTION: Act on a pending signal of the calling process before the
+ *                linkage returns to user mode
+ *   INPUTS: regs - registers the linkage will restore
+ *           frame - the iret frame above them
+ *           vector, error_code - what is being returned from, for the handler
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Does nothing when returning to the kernel. May rewrite regs,
+ *                 frame and the user stack, or halt the process (no return).
+ */
+void signal_deliver(pushal_regs_t* regs, irq_frame_t* frame, uint32_t vector, uint32_t error_code){
+    pcb_struct* pcb;
+    sig_context_t* ctx;
+    uint32_t pending, trampoline, esp;
+    int32_t signum;
+
+    if(!IRQ_FROM_USER(frame)){
+        return;
+    }
+    pcb = get_pcb_ptr();
+
+    // a handler is running: the rest waits for its sigreturn
+    while(!pcb->sig_masked && (pending = pcb->sig_pending) != 0){
+        for(signum = 0; !(pending & (1 << signum)); signum++);
+        asm volatile ("lock; andl %1, %0"
+                      : "+m"(pcb->sig_pending)
+                      : "r"(~(1 << signum))
+                      : "memory");
+
+        if(pcb->sig_handler[signum] == 0){
+            if(SIG_DEFAULT_KILL & (1 << signum)){
+                process_halt(SIG_KILL_STATUS);
+            }
+            continue;
+        }
+
+        // trampoline code, then the saved context, then signum and the return address;
+        // checked before subtracting, so a small esp cannot wrap around into the kernel
+        if(frame->esp < USER_PAGE_START + sizeof(sigreturn_code) + sizeof(sig_context_t) + 2 * sizeof(uint32_t)
+           || frame->esp > USER_PAGE_END){
+            process_halt(SIG_KILL_STATUS);          // nowhere to put the frame
+        }
+        trampoline = frame->esp - sizeof(sigreturn_code);
+        esp = trampoline - sizeof(sig_context_t) - 2 * sizeof(uint32_t);
+        memcpy((void*)trampoline, sigreturn_code, sizeof(sigreturn_code));
+
+        ctx = (sig_context_t*)(trampoline - sizeof(sig_context_t));
+        ctx->ebx = regs->ebx;
+        ctx->ecx = regs->ecx;
+        ctx->edx = regs->edx;
+        ctx->esi = regs->esi;
+        ctx->edi = regs->edi;
+        ctx->ebp = regs->ebp;
+        ctx->eax = regs->eax;
+        ctx->ds = USER_DS;
+        ctx->es = USER_DS;
+        ctx->fs = USER_DS;
+        ctx->ds_pad = ctx->es_pad = ctx->fs_pad = 0;
+        ctx->vector = vector;
+        ctx->error_code = error_code;
+        ctx->eip = frame->eip;
+        ctx->cs = frame->cs;
+        ctx->eflags = frame->eflags;
+        ctx->esp = frame->esp;
+        ctx->ss = frame->ss;
+
+        ((uint32_t*)esp)[0] = trampoline;
+        ((uint32_t*)esp)[1] = signum;
+
+        frame->esp = esp;
+        frame->eip = pcb->sig_handler[signum];
+        pcb->sig_masked = 1;
+    }
+}
+
+/*
+ * signal_set_handler
+ *   DESCRIPTION: The set_handler system call
+ *   INPUTS: signum - SIG_*, handler_address - user function, NULL for the default action
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 for a bad signal number or an address outside the user page
+ *   SIDE EFFECTS: none
+ */
+int32_t signal_set_handler(int32_t signum, void* handler_address){
+    uint32_t addr = (uint32_t)handler_address;
+
+    if(signum < 0 || signum >= NUM_SIGNALS){
+        return -1;
+    }
+    if(addr != 0 && (addr < USER_PAGE_START || addr >= USER_PAGE_END)){
+        return -1;
+    }
+    get_pcb_ptr()->sig_handler[signum] = addr;
+    return 0;
+}
+
+/*
+ * signal_return
+ *   DESCRIPTION: The sigreturn system call
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: eax of the interrupted context, -1 outside a handler or if
+ *                 the saved context is not on the user stack
+ *   SIDE EFFECTS: Rewrites the registers system_call_handler_asm restores;
+ *                 unmasks signals
+ */
+int32_t signal_return(void){
+    pcb_struct* pcb = get_pcb_ptr();
+    irq_frame_t* frame;
+    pushal_regs_t* regs;
+    sig_context_t* ctx;
+
+    if(!pcb->sig_masked){
+        return -1;
+    }
+    // a system call from user mode always enters at the top of its kernel stack
+    frame = (irq_frame_t*)(this_cpu()->tss->esp0 - sizeof(irq_frame_t));
+    regs = (pushal_regs_t*)frame - 1;
+
+    // the handler's ret popped the trampoline address, so esp is at signum
+    ctx = (sig_context_t*)(frame->esp + sizeof(uint32_t));
+    if((uint32_t)ctx < USER_PAGE_START || (uint32_t)ctx > USER_PAGE_END - sizeof(sig_context_t)){
+        return -1;
+    }
+
+    regs->ebx = ctx->ebx;
+    regs->ecx = ctx->ecx;
+    regs->edx = ctx->edx;
+    regs->esi = ctx->esi;
+    regs->edi = ctx->edi;
+    regs->ebp = ctx->ebp;
+    frame->eip = ctx->eip;
+    frame->esp = ctx->esp;
+    frame->eflags = (frame->eflags & ~EFLAGS_USER_MASK) | (ctx->eflags & EFLAGS_USER_MASK);
+    pcb->sig_masked = 0;
+    return ctx->eax;
+}
+
+/*
+ * signal_alarm
+ *   DESCRIPTION: Alarm timer callback
+ *   INPUTS: timer - alarm_timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Raises SIG_ALARM for the program running on each terminal
+ *                 and re-arms the timer
+ */
+static void signal_alarm(ktimer_t* timer){
+    int i;
+    pcb_struct* pcb;
+
+    for(i = 0; i < NUM_TERMINALS; i++){
+        pcb = terminal_array[i].curr_pcb_ptr;
+        if(terminal_array[i].number_of_processes > 0 && pcb != NULL){
+            signal_send(pcb, SIG_ALARM);
+        }
+    }
+    timer_add(timer, timer->expires + SIG_ALARM_TICKS);
+}
@@ -0,0 +1,115 @@
+/* signal.h - User signals (set_handler, sigreturn)
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SIGNAL_H
+#define _SIGNAL_H
+
+#include "types.h"
+#include "idt.h"
+#include "systemcall.h"
+
+/* A signal is raised by setting its bit in the process's pending mask, from
+ * any CPU. It is delivered by signal_deliver on the process's next way back
+ * to user mode: the system call, interrupt and exception exits all call it
+ * just before their iret. With a handler installed it builds a frame on the
+ * user stack and points the iret at the handler; sigreturn undoes that.
+ * Otherwise the default action applies, which kills the process for the
+ * first three signals and ignores the other two. */
+
+#define SIG_DIV_ZERO            0           // divide error and x87/SIMD faults
+#define SIG_SEGFAULT            1           // every other exception taken at CPL 3
+#define SIG_INTERRUPT           2           // Ctrl+C on the process's terminal
+#define SIG_ALARM               3           // every SIG_ALARM_TICKS
+#define SIG_USER1               4           // NUM_SIGNALS (systemcall.h) in all
+
+#define SIG_ALARM_TICKS         (10 * pit_default_hz)
+#define SIG_KILL_STATUS         256         // what execute returns for a killed child
+
+/* Registers in pushal order, as the linkage stubs save them */
+typedef struct {
+    uint32_t edi;
+    uint32_t esi;
+    uint32_t ebp;
+    uint32_t esp;               // kernel esp, ignored by popal
+    uint32_t ebx;
+    uint32_t edx;
+    uint32_t ecx;
+    uint32_t eax;
+} pushal_regs_t;
+
+/* What a handler finds above its signal number on the user stack, in the
+ * order ece391syscall.h documents (eax is 7 words past the number) */
+typedef struct {
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t ebp;
+    uint32_t eax;
+    uint16_t ds, ds_pad;
+    uint16_t es, es_pad;
+    uint16_t fs, fs_pad;
+    uint32_t vector;            // interrupt, exception or system call vector
+    uint32_t error_code;
+    uint32_t eip;
+    uint32_t cs;
+    uint32_t eflags;
+    uint32_t esp;
+    uint32_t ss;
+} sig_context_t;
+
+/*
+ * signal_init
+ *   DESCRIPTION: Start the alarm timer
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: SIG_ALARM goes to every terminal's running program each
+ *                 SIG_ALARM_TICKS from now on
+ */
+void signal_init(void);
+
+/*
+ * signal_reset
+ *   DESCRIPTION: Give a process the default action for every signal
+ *   INPUTS: pcb - the process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: drops anything pending
+ */
+void signal_reset(pcb_struct* pcb);
+
+/*
+ * signal_send
+ *   DESCRIPTION: Raise a signal for a process
+ *   INPUTS: pcb - the process, signum - SIG_*
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Delivered on its next return to user mode
+ */
+void signal_send(pcb_struct* pcb, int32_t signum);
+
+/*
+ * signal_deliver
+ *   DESCRIPTION: Act on a pending signal of the calling process before the
+ *                linkage returns to user mode
+ *   INPUTS: regs - registers the linkage will restore
+ *           frame - the iret frame above them
+ *           vector, error_code - what is being returned from, for the handler
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Does nothing when returning to the kernel. May rewrite regs,
+ *                 frame and the user stack, or halt the process (no return).
+ */
+void signal_deliver(pushal_regs_t* regs, irq_frame_t* frame, uint32_t vector, uint32_t error_code);
+
+/*
+ * signal_set_handler, signal_return
+ *   DESCRIPTION: The set_handler and sigreturn system calls (systemcall.c)
+ */
+int32_t signal_set_handler(int32_t signum, void* handler_address);
+int32_t signal_return(void);
+
+#endif /* _SIGNAL_H */
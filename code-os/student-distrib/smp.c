@@ -0,0 +1,203 @@
+/* smp.c - Application processor start-up and per-CPU state
+ * vim:ts=4 noexpandtab
+ */
+
+#include "smp.h"
+#include "sched.h"
+#include "pit.h"
+
+#define US_PER_MS           1000
+#define INIT_DEASSERT_US    10000       // MP spec: 10ms after INIT before the first SIPI
+#define SIPI_DELAY_US       200
+#define APIC_ID_LIMIT       256
+
+cpu_t cpus[APIC_MAX_CPUS];
+uint32_t cpu_count = 1;
+uint8_t cpu_by_apic_id[APIC_ID_LIMIT];
+
+/* page directories of the APs; the boot processor keeps pde */
+static page_directory_entry ap_pd[APIC_MAX_CPUS - 1][NUM_MAX] __attribute__((aligned (B_IN_4KB)));
+
+/* trampoline (smp_boot.S) and the words in it smp_start_ap fills in */
+extern uint8_t ap_trampoline[], ap_trampoline_end[];
+extern uint8_t ap_boot_gdt[], ap_boot_cr3[], ap_boot_stack[], ap_boot_cpu[];
+#define TRAMPOLINE_WORD(sym)    ((uint32_t*)(AP_TRAMPOLINE_ADDR + ((sym) - ap_trampoline)))
+
+void ap_main(cpu_t* cpu);
+static int32_t smp_start_ap(cpu_t* cpu, uint32_t apic_id);
+static void lapic_send_ipi(uint32_t apic_id, uint32_t command);
+
+/*
+ * smp_init
+ *   DESCRIPTION: Fill in the boot processor's cpus[] entry and start the others
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of CPUs online
+ *   SIDE EFFECTS: Maps the trampoline page while the APs start
+ */
+uint32_t smp_init(void){
+    cpu_t* bsp = &cpus[0];
+    uint32_t i;
+
+    bsp->index = 0;
+    bsp->apic_id = apic_enabled ? lapic_id() : 0;
+    bsp->tss = &tss;
+    bsp->pd = pde;
+    bsp->timer_hz = pit_default_hz;
+    bsp->online = 1;
+    cpu_count = 1;
+    if(!apic_enabled){
+        return cpu_count;
+    }
+    cpu_by_apic_id[bsp->apic_id] = 0;
+
+    paging_map_low_page(AP_TRAMPOLINE_ADDR, 1);
+    memcpy((void*)AP_TRAMPOLINE_ADDR, ap_trampoline, ap_trampoline_end - ap_trampoline);
+
+    for(i = 0; i < apic_cpu_count && cpu_count < APIC_MAX_CPUS; i++){
+        if(apic_cpu_ids[i] == bsp->apic_id){
+            continue;
+        }
+        if(smp_start_ap(&cpus[cpu_count], apic_cpu_ids[i]) == 0){
+            cpu_count++;
+        } else{
+            printf("SMP: CPU with APIC id %d did not start\n", apic_cpu_ids[i]);
+        }
+    }
+
+    paging_map_low_page(AP_TRAMPOLINE_ADDR, 0);
+    return cpu_count;
+}
+
+/*
+ * smp_start_ap
+ *   DESCRIPTION: Set up the next cpus[] entry and wake its processor
+ *   INPUTS: cpu - cpus[cpu_count], apic_id - LAPIC id of the processor
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 once the CPU reports online, -1 on timeout
+ *   SIDE EFFECTS: INIT-SIPI-SIPI to apic_id; rewrites the trampoline words
+ */
+static int32_t smp_start_ap(cpu_t* cpu, uint32_t apic_id){
+    uint32_t i;
+
+    cpu->index = cpu_count;
+    cpu->apic_id = apic_id;
+    cpu->timer_hz = pit_default_hz;
+    cpu->online = 0;
+    cpu_by_apic_id[apic_id] = cpu->index;
+
+    // kernel mappings are the same everywhere; the user pages get filled in per task
+    cpu->pd = ap_pd[cpu->index - 1];
+    memcpy(cpu->pd, pde, sizeof(ap_pd[0]));
+
+    // own TSS behind its own copy of the GDT, so every CPU can have its own esp0
+    memcpy(cpu->gdt, gdt, sizeof(cpu->gdt));
+    cpu->gdt[KERNEL_TSS >> 3] = tss_desc_ptr;
+    cpu->gdt[KERNEL_TSS >> 3].type = 0x9;                   // available (the BSP's copy is marked busy)
+    SET_TSS_PARAMS(cpu->gdt[KERNEL_TSS >> 3], &cpu->own_tss, tss_size);
+    cpu->gdt_desc.size = sizeof(cpu->gdt) - 1;
+    cpu->gdt_desc.addr = (uint32_t)cpu->gdt;
+
+    memset(&cpu->own_tss, 0, sizeof(cpu->own_tss));
+    cpu->own_tss.ldt_segment_selector = KERNEL_LDT;
+    cpu->own_tss.ss0 = KERNEL_DS;
+    cpu->own_tss.esp0 = (uint32_t)(cpu->stack + CPU_STACK_SIZE);
+    cpu->tss = &cpu->own_tss;
+
+    // the trampoline runs on the shared GDT until ap_main loads the copy
+    *(uint16_t*)TRAMPOLINE_WORD(ap_boot_gdt) = sizeof(cpu->gdt) - 1;
+    *(uint32_t*)((uint8_t*)TRAMPOLINE_WORD(ap_boot_gdt) + 2) = (uint32_t)gdt;
+    *TRAMPOLINE_WORD(ap_boot_cr3) = (uint32_t)cpu->pd;
+    *TRAMPOLINE_WORD(ap_boot_stack) = (uint32_t)(cpu->stack + CPU_STACK_SIZE);
+    *TRAMPOLINE_WORD(ap_boot_cpu) = (uint32_t)cpu;
+
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    pit_wait_us(SIPI_DELAY_US);
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+    pit_wait_us(INIT_DEASSERT_US);
+    for(i = 0; i < 2; i++){
+        lapic_send_ipi(apic_id, LAPIC_ICR_STARTUP | (AP_TRAMPOLINE_ADDR >> PAGE_FRAME_BITS));
+        pit_wait_us(SIPI_DELAY_US);
+    }
+
+    for(i = 0; i < AP_START_TIMEOUT_MS && !cpu->online; i++){
+        pit_wait_us(US_PER_MS);
+    }
+    return cpu->online ? 0 : -1;
+}
+
+/*
+ * lapic_send_ipi
+ *   DESCRIPTION: Send an inter-processor interrupt and wait for it to be accepted
+ *   INPUTS: apic_id - destination, command - low ICR word
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes the ICR
+ */
+static void lapic_send_ipi(uint32_t apic_id, uint32_t command){
+    lapic_write(LAPIC_ICR_HIGH, apic_id << LAPIC_ID_SHIFT);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while(lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING);
+}
+
+/*
+ * smp_wakeup
+ *   DESCRIPTION: Get another CPU out of hlt so it looks at its run queue
+ *   INPUTS: cpu - the CPU
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sends it SCHED_IPI_VECTOR
+ */
+void smp_wakeup(cpu_t* cpu){
+    uint32_t flags;
+
+    if(!apic_enabled || !cpu->online){
+        return;
+    }
+    cli_and_save(flags);                // the ICR pair belongs to this CPU until the send is done
+    lapic_send_ipi(cpu->apic_id, SCHED_IPI_VECTOR);
+    restore_flags(flags);
+}
+
+/*
+ * ap_main
+ *   DESCRIPTION: First C code on an application processor (from smp_boot.S)
+ *   INPUTS: cpu - its cpus[] entry
+ *   OUTPUTS: none
+ *   RETURN VALUE: never returns
+ *   SIDE EFFECTS: Loads its GDT/IDT/TSS, enables SSE and its LAPIC and timer,
+ *                 then idles until sched.c gives it a task
+ */
+void ap_main(cpu_t* cpu){
+    lgdt(&cpu->gdt_desc.size);
+    asm volatile ("lidt (%0)" : : "r"(&idt_desc_ptr) : "memory");
+    ltr(KERNEL_TSS);
+    lldt(KERNEL_LDT);
+
+    sse_init();
+    lapic_enable();
+    lapic_timer_init(cpu->timer_hz);
+
+    cpu->online = 1;
+    cpu_idle();
+}
+
+/*
+ * cpu_idle
+ *   DESCRIPTION: Idle loop of every CPU; runs tasks as they are queued
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: never returns
+ *   SIDE EFFECTS: halts between interrupts, with the timer tick stopped
+ *                 while it does (pit.c)
+ */
+void cpu_idle(void){
+    while(1){
+        cli();
+        timer_idle_exit();
+        schedule();
+        timer_idle_enter();
+        // sti takes effect after hlt starts, so no wakeup is lost in between
+        asm volatile ("sti; hlt" : : : "memory");
+    }
+}
@@ -0,0 +1,143 @@
+/* smp.h - Application processor start-up and per-CPU state
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "x86_desc.h"
+
+/* smp_init() starts every processor apic_init() found with INIT-SIPI-SIPI.
+ * Each one gets a copy of the GDT whose TSS descriptor points at its own
+ * TSS, its own page directory (the user page at 128MB differs per CPU),
+ * an idle stack, and its own LAPIC timer. Without an APIC there is one CPU. */
+
+#define CPU_STACK_SIZE          0x2000      // idle/boot stack of each CPU
+#define AP_TRAMPOLINE_ADDR      0x8000      // real mode entry; the SIPI vector is its page number
+#define AP_START_TIMEOUT_MS     100
+
+/* ICR fields for the start-up sequence */
+#define LAPIC_ICR_INIT          0x00000500
+#define LAPIC_ICR_STARTUP       0x00000600
+#define LAPIC_ICR_LEVEL         0x00008000
+#define LAPIC_ICR_ASSERT        0x00004000
+#define LAPIC_ICR_PENDING       0x00001000
+
+#ifndef ASM
+
+#include "types.h"
+#include "lib.h"
+#include "paging.h"
+#include "apic.h"
+
+struct terminal_struct;
+
+/* task states (sched.c) */
+#define TASK_RUNNABLE           0           // running or queued
+#define TASK_BLOCKED            1           // in sched_wait until sched_wake
+
+#define SCHED_LEVELS            4           // MLFQ priority levels, 0 runs first
+
+/* tasks sleeping in sched_wait until something calls sched_wake */
+typedef struct wait_queue {
+    spinlock_t lock;
+    struct terminal_struct* head;
+} wait_queue_t;
+#define WAIT_QUEUE_INIT         {SPINLOCK_INIT, NULL}
+
+/* lock a task may sleep on, and sleep holding (sched.c); for data guarded
+ * across disk I/O, where a spinlock cannot be held */
+typedef struct sleep_lock {
+    spinlock_t lock;
+    volatile int free;
+    wait_queue_t wq;
+} sleep_lock_t;
+#define SLEEP_LOCK_INIT         {SPINLOCK_INIT, 1, WAIT_QUEUE_INIT}
+
+typedef struct cpu {
+    uint32_t index;                     // position in cpus[], 0 is the boot processor
+    uint32_t apic_id;
+    volatile uint32_t online;           // set by the CPU itself once it takes interrupts
+
+    /* what is running here (sched.c) */
+    uint32_t pid;                       // cur_pid on this CPU
+    struct terminal_struct* terminal;   // running task, NULL while idle
+    uint32_t idle_esp;                  // saved idle loop context while a task runs
+    struct terminal_struct* switched_from;  // task whose context the last switch saved
+    uint32_t steals;                    // tasks taken from other CPUs' queues
+
+    /* tasks waiting for this CPU, one queue per level, oldest first; other
+     * CPUs steal from the tails */
+    spinlock_t rq_lock;
+    struct terminal_struct* rq_head[SCHED_LEVELS];
+    struct terminal_struct* rq_tail[SCHED_LEVELS];
+    uint32_t rq_mask;                   // bit n set while level n has tasks
+    uint32_t rq_count;
+    uint32_t boost_ticks;               // ticks since every task was last boosted
+
+    /* timer (pit.c) */
+    uint32_t timer_hz;                  // rate this CPU's timer is programmed for
+    uint32_t timer_subticks;
+    uint32_t idle_ticks;                // length of the one-shot while the tick is stopped, else 0
+
+    tss_t* tss;                         // &tss on the boot processor, &own_tss elsewhere
+    page_directory_entry* pd;           // pde on the boot processor
+
+    tss_t own_tss;
+    seg_desc_t gdt[GDT_ENTRIES];
+    x86_desc_t gdt_desc;
+    uint8_t stack[CPU_STACK_SIZE] __attribute__((aligned (16)));
+} cpu_t;
+
+extern cpu_t cpus[APIC_MAX_CPUS];
+extern uint32_t cpu_count;              // CPUs online
+extern uint8_t cpu_by_apic_id[];
+
+/*
+ * this_cpu
+ *   DESCRIPTION: Per-CPU state of the calling processor
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer into cpus[]
+ *   SIDE EFFECTS: reads the LAPIC id register when the APIC is in use
+ */
+static inline cpu_t* this_cpu(void) {
+    return apic_enabled ? &cpus[cpu_by_apic_id[lapic_id()]] : &cpus[0];
+}
+
+/*
+ * smp_init
+ *   DESCRIPTION: Fill in the boot processor's cpus[] entry and start the others
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of CPUs online
+ *   SIDE EFFECTS: Maps the trampoline page while the APs start. Call after
+ *                 apic_init, pit_init and every change to the kernel's page
+ *                 directory (the APs copy it).
+ */
+uint32_t smp_init(void);
+
+/*
+ * smp_wakeup
+ *   DESCRIPTION: Get another CPU out of hlt so it looks at its run queue
+ *   INPUTS: cpu - the CPU
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sends it SCHED_IPI_VECTOR
+ */
+void smp_wakeup(cpu_t* cpu);
+
+/*
+ * cpu_idle
+ *   DESCRIPTION: Idle loop of every CPU; runs tasks as they are queued
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: never returns
+ *   SIDE EFFECTS: halts between interrupts, with the timer tick stopped
+ *                 while it does (pit.c)
+ */
+void cpu_idle(void);
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
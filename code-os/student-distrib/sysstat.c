@@ -0,0 +1,168 @@
+#include "sysstat.h"
+#include "lib.h"
+#include "systemcall.h"
+#include "fd.h"
+
+#define SYSSTAT_LINE_SIZE   512             // header plus every latency bucket at full width
+#define SYSSTAT_NUM_ROWS    (SYSSTAT_MAX_PID * SYSSTAT_NUM_CALLS)
+
+static sysstat_entry_t sysstat_table[SYSSTAT_MAX_PID][SYSSTAT_NUM_CALLS];
+
+static int8_t* sysstat_names[SYSSTAT_NUM_CALLS] = {
+    "?",
+    "halt",
+    "execute",
+    "read",
+    "write",
+    "open",
+    "close",
+    "getargs",
+    "vidmap",
+    "set_handler",
+    "sigreturn",
+    "nice",
+    "sleep",
+    "fdlimit",
+    "dup",
+    "dup2",
+    "lseek",
+    "pread",
+    "readv",
+    "writev",
+    "getdents",
+    "stat",
+    "fstat",
+    "create",
+    "unlink",
+    "ftruncate",
+    "io_setup",
+    "io_enter",
+    "poll",
+    "ioctl"
+};
+
+/*
+ * sysstat_log2
+ *   DESCRIPTION: Latency bucket of a 64 bit cycle count
+ *   INPUTS: lo/hi - cycle count halves
+ *   OUTPUTS: none
+ *   RETURN VALUE: floor(log2(cycles)) clamped to the last bucket; 0 for 0 cycles
+ *   SIDE EFFECTS: none
+ */
+static uint32_t sysstat_log2(uint32_t lo, uint32_t hi){
+    uint32_t bit;
+
+    if(hi != 0){
+        return SYSSTAT_LAT_BUCKETS - 1;
+    }
+    if(lo == 0){
+        return 0;
+    }
+    asm ("bsrl %1, %0" : "=r"(bit) : "rm"(lo) : "cc");
+    return bit;
+}
+
+/*
+ * sysstat_record
+ *   DESCRIPTION: Account one finished system call
+ *   INPUTS: num - syscall number, pid - caller, ret - return value,
+ *           cycles_lo/cycles_hi - latency in TSC cycles
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Updates the counters of (pid, num)
+ */
+void sysstat_record(uint32_t num, uint32_t pid, int32_t ret, uint32_t cycles_lo, uint32_t cycles_hi){
+    sysstat_entry_t* entry;
+
+    if(num >= SYSSTAT_NUM_CALLS || pid >= SYSSTAT_MAX_PID){
+        return;
+    }
+    entry = &sysstat_table[pid][num];
+    entry->calls++;
+    if(ret < 0){
+        entry->errors++;
+    }
+    entry->latency[sysstat_log2(cycles_lo, cycles_hi)]++;
+}
+
+/*
+ * sysstat_open, sysstat_close
+ *   DESCRIPTION: Open/close the "sysstat" device file
+ *   INPUTS: filename / fd
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t sysstat_open(const uint8_t* filename){
+    return 0;
+}
+
+int32_t sysstat_close(int32_t fd){
+    return 0;
+}
+
+/*
+ * sysstat_read
+ *   DESCRIPTION: Render the counters as text, one line per (pid, syscall) that was used
+ *   INPUTS: fd - sysstat file descriptor, buf - user buffer, nbytes - size of buf
+ *   OUTPUTS: "<pid> <syscall> <calls> <errors> <k>:<count> ..." lines
+ *   RETURN VALUE: number of bytes written (whole lines only), 0 at the end
+ *   SIDE EFFECTS: Advances the file position (a pid * SYSSTAT_NUM_CALLS + num index)
+ */
+int32_t sysstat_read(int32_t fd, void* buf, int32_t nbytes){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    int8_t line[SYSSTAT_LINE_SIZE];
+    sysstat_entry_t* entry;
+    uint32_t pid, num, k;
+    int32_t bytes_read = 0;
+    int32_t line_length;
+
+    while(file->file_position < SYSSTAT_NUM_ROWS){
+        pid = file->file_position / SYSSTAT_NUM_CALLS;
+        num = file->file_position % SYSSTAT_NUM_CALLS;
+        entry = &sysstat_table[pid][num];
+        if(entry->calls == 0){
+            file->file_position++;
+            continue;
+        }
+
+        line_length = snprintf(line, SYSSTAT_LINE_SIZE, "%3u %-11s %8u %6u",
+                pid, sysstat_names[num], entry->calls, entry->errors);
+        for(k = 0; k < SYSSTAT_LAT_BUCKETS; k++){
+            if(entry->latency[k] != 0){
+                line_length += snprintf(line + line_length, SYSSTAT_LINE_SIZE - line_length,
+                        " %u:%u", k, entry->latency[k]);
+            }
+        }
+        line_length += snprintf(line + line_length, SYSSTAT_LINE_SIZE - line_length, "\n");
+
+        if(bytes_read + line_length > nbytes){
+            break;                              // only whole lines
+        }
+        memcpy((int8_t*)buf + bytes_read, line, line_length);
+        bytes_read += line_length;
+        file->file_position++;
+    }
+
+    return bytes_read;
+}
+
+/*
+ * sysstat_write
+ *   DESCRIPTION: Reset all counters
+ *   INPUTS: buf - pointer to an int32_t that must be 0
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on bad input
+ *   SIDE EFFECTS: Clears every pid's statistics
+ */
+int32_t sysstat_write(int32_t fd, const void* buf, int32_t nbytes){
+    uint32_t flags;
+
+    if(buf == NULL || nbytes < sizeof(int32_t) || *(int32_t*)buf != 0){
+        return -1;
+    }
+    cli_and_save(flags);
+    memset(sysstat_table, 0, sizeof(sysstat_table));
+    restore_flags(flags);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef _SYSSTAT_H
+#define _SYSSTAT_H
+
+#include "types.h"
+
+/* Per-syscall, per-pid statistics.
+ * system_call_handler_asm timestamps every dispatched call with the TSC and
+ * syscall_exit() hands the result to sysstat_record(), which keeps call and
+ * error counts and a log2 histogram of latency in cycles. The numbers are
+ * read as text through the "sysstat" device file (user program: stat). */
+
+#define SYSSTAT_NUM_CALLS       30          // syscall numbers 1-29; slot 0 unused
+#define SYSSTAT_LAT_BUCKETS     32          // bucket k counts latencies in [2^k, 2^(k+1)) cycles;
+                                            // the last one also takes anything slower
+#define SYSSTAT_MAX_PID         8           // one row per pid slot (MAX_PID_NUM)
+
+typedef struct {
+    uint32_t calls;
+    uint32_t errors;                        // calls that returned a negative value
+    uint32_t latency[SYSSTAT_LAT_BUCKETS];
+} sysstat_entry_t;
+
+/*
+ * sysstat_record
+ *   DESCRIPTION: Account one finished system call
+ *   INPUTS: num - syscall number, pid - caller, ret - return value,
+ *           cycles_lo/cycles_hi - latency in TSC cycles
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Updates the counters of (pid, num)
+ */
+void sysstat_record(uint32_t num, uint32_t pid, int32_t ret, uint32_t cycles_lo, uint32_t cycles_hi);
+
+/*
+ * sysstat_open, sysstat_close
+ *   DESCRIPTION: Open/close the "sysstat" device file
+ *   INPUTS: filename / fd
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t sysstat_open(const uint8_t* filename);
+int32_t sysstat_close(int32_t fd);
+
+/*
+ * sysstat_read
+ *   DESCRIPTION: Render the counters as text, one line per (pid, syscall) that was used
+ *   INPUTS: fd - sysstat file descriptor, buf - user buffer, nbytes - size of buf
+ *   OUTPUTS: "<pid> <syscall> <calls> <errors> <k>:<count> ..." lines, listing only
+ *            the nonempty latency buckets
+ *   RETURN VALUE: number of bytes written (whole lines only), 0 at the end
+ *   SIDE EFFECTS: Advances the file position (a pid * SYSSTAT_NUM_CALLS + num index)
+ */
+int32_t sysstat_read(int32_t fd, void* buf, int32_t nbytes);
+
+/*
+ * sysstat_write
+ *   DESCRIPTION: Reset all counters
+ *   INPUTS: buf - pointer to an int32_t that must be 0
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on bad input
+ *   SIDE EFFECTS: Clears every pid's statistics
+ */
+int32_t sysstat_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* _SYSSTAT_H */
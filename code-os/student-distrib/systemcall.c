@@ -3,37 +3,45 @@
 #include "paging.h"
 #include "terminal.h"
 #include "x86_desc.h"
+#include "trace.h"
+#include "profile.h"
+#include "sysstat.h"
+#include "procfs.h"
+#include "timer.h"
+#include "signal.h"
+#include "fd.h"
+#include "io_ring.h"
+#include "poll.h"
 
 //variables for keeping track of the pid values
-uint32_t cur_pid = 0;
 // uint32_t parent_pid = 0;
 uint32_t pid_array[MAX_PID_NUM];
+static spinlock_t pid_lock = SPINLOCK_INIT;    // pid_array, shared by every CPU
+
+/* Kernel device files, looked up by name before the boot image dentries */
+static device_file_t device_files[] = {
+    { "trace", &trace_fileop_table, 0 },                        // tracepoint ring (trace.c)
+    { "profile", &profile_fileop_table, 0 },                    // PIT sampling profiler (profile.c)
+    { "sysstat", &sysstat_fileop_table, 0 },                    // per-syscall counters (sysstat.c)
+    { "proc/processes", &proc_fileop_table, PROC_PROCESSES },   // synthetic state files (procfs.c)
+    { "proc/meminfo", &proc_fileop_table, PROC_MEMINFO },
+    { "proc/interrupts", &proc_fileop_table, PROC_INTERRUPTS },
+    { "proc/sched", &proc_fileop_table, PROC_SCHED },
+    { "proc/bcache", &proc_fileop_table, PROC_BCACHE },
+};
+#define NUM_DEVICE_FILES (sizeof(device_files) / sizeof(device_files[0]))
+
+static device_file_t* device_file_lookup(const uint8_t* filename);
+static int32_t process_alloc_std(file_array_struct* std[2]);
+static void process_open_std(pcb_struct* pcb);
+static int32_t open_install(fileop_table_t* fileop, uint32_t inode);
+static int32_t transfer_vector(int32_t fd, const iovec_t* iov, int32_t iovcnt, int32_t write);
 
 //Assembly functions. Descriptions in sycall_support.S
 extern void flush_tlb();
-extern void halt_asm(uint32_t execute_ebp, uint32_t execute_esp, uint8_t status);
+extern void halt_asm(uint32_t execute_ebp, uint32_t execute_esp, uint32_t status);
 extern void process_asm(uint32_t eip_arg, uint32_t user_ds, uint32_t user_cs, uint32_t esp_arg);
 
-/* 
- * switch_process
- *   DESCRIPTION: called by the pit handler to do schdeling 
- *   INPUTS: none
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: switch the process
- */
-extern void switch_process(){
-    /*fetch the curr pid and related info*/
-    // pcb_struct* cur_pcb_ptr = get_pcb_ptr();
-    /*store the current process stack info*/
-    // cur_pcb_ptr->esp_user = ok;
-    // cur_pcb_ptr->ebp_execute = ok;
-    // cur_pcb_ptr->esp0_tss = ok;
-    /*fetch the next process info/ terminal info*/
-
-    /*switch process*/
-    //if no process create a new shell
-}
 /* 
  * halt
  *   DESCRIPTION: Halts the system
@@ -43,70 +51,77 @@ extern void switch_process(){
  *   SIDE EFFECTS: halts current task, returns to parent
  */
 int32_t halt(uint8_t status){
+    return process_halt(status);
+}
+
+/*
+ * process_halt
+ *   DESCRIPTION: End the current process with any status
+ *   INPUTS: status - what the parent's execute returns (SIG_KILL_STATUS when killed)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none, does not return
+ *   SIDE EFFECTS: halts current task, returns to parent
+ */
+int32_t process_halt(uint32_t status){
   int i;
   int process_terminal;
+  uint32_t ebp_execute, esp_execute;
 //---------Restore parent data-----------------------------------------
-    //printf("0");
 
-    pcb_struct* cur_pcb_ptr = current_terminal->curr_pcb_ptr;
+    terminal_struct* term = running_terminal();
+    pcb_struct* cur_pcb_ptr = term->curr_pcb_ptr;
     process_terminal = cur_pcb_ptr->terminal_num;
+    TRACE(TRACE_HALT, HALT_PHASE_START, status);
+
+    // release what the process still holds: its descriptors (the drivers'
+    // close runs for files nobody else has open) and its vidmap page
+    for(i = fd_next_open(cur_pcb_ptr, 0); i != -1; i = fd_next_open(cur_pcb_ptr, i + 1)){
+        fd_close(cur_pcb_ptr, i);
+    }
+    cur_pcb_ptr->vidmap = 0;
+    cur_pcb_ptr->io_ring = 0;
+    terminal_set_mode(term, cur_pcb_ptr->term_mode);    // the parent gets back the mode it ran the program in
+
     //return to shell if it is the base shell
     if(cur_pcb_ptr->pid_parent == -1){
-            //printf("0.1");
-
         uint32_t eip_arg = cur_pcb_ptr->eip_user; //getting eip & esp arguments from user
         uint32_t esp_arg = cur_pcb_ptr->esp_user;
+        signal_reset(cur_pcb_ptr);
+        process_open_std(cur_pcb_ptr);
     //Enable interrupts
      sti();
-         //printf("0.2");
 
         process_asm(eip_arg,esp_arg,USER_CS,USER_DS);
     }
     // get updated pid with parent's pcb
-    // printf("0.5");
-    // printf("%d", cur_pcb_ptr->pid_parent);
-
     pcb_struct* parent_pcb_ptr = get_pcb(cur_pcb_ptr->pid_parent);
+    TRACE(TRACE_HALT, HALT_PHASE_PARENT, parent_pcb_ptr->pid);
 
-        //printf("0.6");
-
-    current_terminal->pid = parent_pcb_ptr->pid;
+    term->pid = parent_pcb_ptr->pid;
     cur_pid = parent_pcb_ptr->pid;
     
 
-    current_terminal->curr_pcb_ptr = parent_pcb_ptr;
-    //printf("0.7");
+    term->curr_pcb_ptr = parent_pcb_ptr;
 
     // current_terminal->parent_pid = parent_pcb_ptr->pid;
     // terminal_array[process_terminal].pid = parent_pcb_ptr->pid;
     // terminal_array[process_terminal].parent_pid = parent_pcb_ptr->pid;
 
 
-    //printf("0.8");
-    pid_array[cur_pcb_ptr->pid] = 0;
-    //printf("1");
-// Restore Parent Paging
-    uint32_t physical_addr = (PHYSICAL_MEMORY_START_IDX + cur_pid) * 0x400000;     // starts at 8mb
-    pde[32].kb.bit_addr_31_12 = physical_addr >> 12; // get pde address by physical address / 4096 as each stores 4kb
-    flush_tlb();    // flush tlb
-
-// Reset all File descriptor to unused
-    for(i=0;i<8;i++){
-        cur_pcb_ptr->file_array[i].used = 0;
-    }
+// Restore Parent Paging (and its kernel stack in the TSS)
+    process_load(cur_pid);
 
-// Store parent pid back to TSS
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = 0x800000 - (0x2000 *parent_pcb_ptr->pid) - sizeof(int32_t);
-    //printf("2");
-    current_terminal->number_of_processes--;
-    //printf("2.5");
+    term->number_of_processes--;
 
     // terminal_array[process_terminal].curr_pcb_ptr->pid = parent_pid;
     // terminal_array[process_terminal].curr_pcb_ptr->pid = current_terminal->parent_pid;
-    //printf("3");
 // Jump to Execute Return
-    halt_asm(cur_pcb_ptr->ebp_execute,cur_pcb_ptr->esp_execute,status);                                     // error
+    TRACE(TRACE_HALT, HALT_PHASE_RETURN, status);
+    ebp_execute = cur_pcb_ptr->ebp_execute;
+    esp_execute = cur_pcb_ptr->esp_execute;
+    // free the pid last: another CPU may hand its PCB out again right away
+    pid_array[cur_pcb_ptr->pid] = 0;
+    halt_asm(ebp_execute,esp_execute,status);                                     // error
 
     // printf("past halt");
     //  asm volatile (
@@ -138,7 +153,7 @@ int32_t execute(const uint8_t* command){
     int arg_idx = 0;    // start of arg
 
     int length = strlen((const int8_t*)command);
-    // printf("c1");
+    TRACE(TRACE_EXEC, EXEC_PHASE_START, length);
 
     //File system variables
     uint8_t cmd[32];
@@ -148,7 +163,6 @@ int32_t execute(const uint8_t* command){
       cmd[i] = '\0';
       arg[i] = '\0';
     }
-    // printf("c2");
 
     dentry_t dentry_enter;
     uint8_t buf[sizeof(int32_t)];
@@ -156,7 +170,6 @@ int32_t execute(const uint8_t* command){
     //Arguments for switching to user context.
     uint32_t eip_arg;
     uint32_t esp_arg;
-    // printf("c3");
 
 
 // Parse arguments
@@ -173,11 +186,14 @@ int32_t execute(const uint8_t* command){
         i++;
     }
     arg_idx = i;
-    while(i<length && command[i]!=' '){ //argument
+    while(i<length && i-arg_idx < sizeof(arg)-1){ //argument: rest of the line, so "prof grep foo" keeps both words
         arg[i-arg_idx] = command[i];
         i++;
     }
-    // printf("c4");
+    while(i>arg_idx && arg[i-arg_idx-1]==' '){ //trailing spaces
+        i--;
+        arg[i-arg_idx] = '\0';
+    }
 
 // File executable check
 
@@ -192,64 +208,74 @@ int32_t execute(const uint8_t* command){
     if((buf[0] == EXECUTABLE_BYTE1 && buf[1] == EXECUTABLE_BYTE2 && buf[2] == EXECUTABLE_BYTE3 && buf[3] == EXECUTABLE_BYTE4)!=1) {
         return -1; /* ELF not found, not an executable*/
     }
+    TRACE(TRACE_EXEC, EXEC_PHASE_PARSED, dentry_enter.inode_number);
 
-    // printf("5");
 // Paging set up
     pcb_struct* cur_pcb;
+    terminal_struct* term = running_terminal();
+    file_array_struct* std[2] = {NULL, NULL};
+    uint32_t flags;
+    // a terminal's first program gets stdin and stdout; take the open files
+    // first, so running out of them fails execute before anything needs undoing
+    if(term->number_of_processes == 0 && process_alloc_std(std) == -1){
+        return -1;
+    }
+    spin_lock_irqsave(&pid_lock, flags);
     for(i = 0; i < 8 ;i++){         
         if(pid_array[i] == 0){      // find unused pid
             pid_array[i] = 1;       // set to used
-            cur_pid = i;                  
             break;
         }
     }
+    spin_unlock_irqrestore(&pid_lock, flags);
     if(i == 8){
+        if(std[0] != NULL){
+            file_put(std[0]);
+            file_put(std[1]);
+        }
         return -1;          // pid all used
     }
-    // printf("6");
-    uint32_t memory_index = PHYSICAL_MEMORY_START_IDX + cur_pid;               // starts from 8mb
-    uint32_t physical_memory_addr = memory_index * 0x400000;        // find physical memory as each occupies 4mb 
-    pde[32].kb.bit_addr_31_12 = physical_memory_addr >> 12;         // set user virtual memory to physical memory
-    flush_tlb();
+    cur_pid = i;
+    get_pcb(cur_pid)->vidmap = 0;
+    process_load(cur_pid);          // user virtual memory at 128MB -> the new process's 4MB page
+    TRACE(TRACE_EXEC, EXEC_PHASE_PAGED, cur_pid);
 
 // memory load (file)
     index_node* temp_inode_ptr = (index_node *)(index_nodes_ptr+dentry_enter.inode_number);
     uint8_t* image_addr = (uint8_t*)IMAGE_ADDR;           //it should stay the same, overwriting existing program image
     read_data(dentry_enter.inode_number, (uint32_t)0, image_addr,temp_inode_ptr->file_length); //copying entire file to memory starting at Virt addr 0x08048000
-    // printf("7");
+    TRACE(TRACE_EXEC, EXEC_PHASE_LOADED, temp_inode_ptr->file_length);
 // PCB creation
 
     cur_pcb = get_pcb(cur_pid);          // create pcb for current pcb
     cur_pcb->pid = cur_pid;              // store current pid
-
-    // printf("8");
+    cur_pcb->exe_inode = dentry_enter.inode_number;
+    cur_pcb->user_ticks = 0;
+    cur_pcb->kernel_ticks = 0;
+    cur_pcb->io_ring = 0;
+    cur_pcb->term_mode = term->mode;
+    signal_reset(cur_pcb);
 
     /* Set Up Relevant Terminal Information */
     // Check if the current terminal has any processes
-    if(current_terminal->number_of_processes == 0){
-        // printf("a");
+    if(term->number_of_processes == 0){
         // if not, then set parent of current process as -1
         cur_pcb->pid_parent = -1;
-        // printf("b");
-        cur_pcb->terminal_num = current_terminal->terminal_num;
-        current_terminal->pid = cur_pid;
-        // printf("c");
+        cur_pcb->terminal_num = term->terminal_num;
+        cur_pcb->nice = 0;
+        term->pid = cur_pid;
     } else{
         // if it has, then set parent process id accordingly
-        // printf("d");
-        cur_pcb->pid_parent = current_terminal->pid;
-        // printf("e");
-        current_terminal->pid = cur_pid;
-        // printf("f");
-        cur_pcb->terminal_num = current_terminal->terminal_num;
-        // printf("g");
-    }
-    // printf("9");
-    current_terminal->number_of_processes++;
-    current_terminal->curr_pcb_ptr = cur_pcb;
+        cur_pcb->pid_parent = term->pid;
+        cur_pcb->nice = get_pcb(term->pid)->nice;
+        term->pid = cur_pid;
+        cur_pcb->terminal_num = term->terminal_num;
+    }
+    term->number_of_processes++;
+    term->curr_pcb_ptr = cur_pcb;
+    TRACE(TRACE_EXEC, EXEC_PHASE_PCB, cur_pcb->pid_parent);
 
     //printf("\nPID: %d ParentPID: %d Terminal: %d\n", cur_pcb->pid, cur_pcb->pid_parent, cur_pcb->terminal_num);
-    // printf("10");
     // if(cur_pid != 0 ){
     //     cur_pcb->pid_parent = parent_pid;
     //     parent_pid = cur_pid;
@@ -257,27 +283,16 @@ int32_t execute(const uint8_t* command){
     //     cur_pcb->pid_parent = cur_pid;
     // }
 
-
-    // printf("11");
-
-    // Initialize the file descriptor array
-    for (i = 0; i < 8;i++) {
-        if(i==0){
-            cur_pcb->file_array[i].fileop_ptr = &stdin_fileop_table; //sender in 
-            cur_pcb->file_array[i].used = 1;
-        }
-        else if(i==1){
-            cur_pcb->file_array[i].fileop_ptr = &stdout_fileop_table; //sender out
-            cur_pcb->file_array[i].used = 1;
-        }
-        else{
-            cur_pcb->file_array[i].fileop_ptr = NULL;                //file 
-            cur_pcb->file_array[i].used = 0;
-        }
-        cur_pcb->file_array[i].inode_number = 0;
-        cur_pcb->file_array[i].file_position = 0;
+    // Initialize the file descriptor table: a terminal's first program opens
+    // stdin and stdout, the others share every open file of their parent
+    if(cur_pcb->pid_parent == -1){
+        fd_init(cur_pcb, FD_DEFAULT_LIMIT);
+        fd_install(cur_pcb, 0, std[0]);     //sender in
+        fd_install(cur_pcb, 1, std[1]);     //sender out
+    } else{
+        fd_init(cur_pcb, get_pcb(cur_pcb->pid_parent)->fd_limit);
+        fd_inherit(cur_pcb, get_pcb(cur_pcb->pid_parent));
     }
-    // printf("12");
 
     strncpy((int8_t*)cur_pcb->command_arg, (int8_t*)(arg), 32);
 
@@ -286,18 +301,14 @@ int32_t execute(const uint8_t* command){
     uint8_t eip_buffer[4];
     read_data(dentry_enter.inode_number, ELF_START, eip_buffer, sizeof(int32_t)); // Read eip
     eip_arg = *((int*)eip_buffer);
-    // printf("13");
 
     esp_arg = 0x8000000 + 0x400000 - sizeof(int32_t); // where program starts
 
     cur_pcb->eip_user = eip_arg;
     cur_pcb->esp_user = esp_arg;
 
-    //For privilege level switch
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = ADDRESS_8MB - (NUM_BITS_8KB*cur_pid) - sizeof(int32_t);
-    cur_pcb->esp0_tss = tss.esp0;
-    // printf("14");
+    //For privilege level switch (process_load put it in this CPU's TSS)
+    cur_pcb->esp0_tss = this_cpu()->tss->esp0;
 
     //Get the esp and ebp values for the user context switch.
     uint32_t esp;
@@ -306,15 +317,13 @@ int32_t execute(const uint8_t* command){
     asm("\t movl %%ebp, %0" : "=r"(ebp));
     cur_pcb->esp_execute = esp;
     cur_pcb->ebp_execute = ebp;
-    // printf("15");
+    TRACE(TRACE_EXEC, EXEC_PHASE_USER, eip_arg);
 
     //Enable interrupts
     sti();
-        // printf("16");
 
     //push args for iret and iret
     process_asm(eip_arg,esp_arg,USER_CS,USER_DS);           // ERROR
-        // printf("17");
 
     return 0;
 }
@@ -331,39 +340,42 @@ int32_t execute(const uint8_t* command){
  *                 necessary data to handle the file type
  */
 int32_t open(const uint8_t* filename){
-    int i;
-    pcb_struct* current_pcb = get_pcb_ptr();            // get current process pcb
+    fileop_table_t* fileop;
     dentry_t directory;
+    device_file_t* device;
+    int32_t fd;
 
     // need to check for empty string; if empty, return -1
     if(strlen((char*)filename) == 0){
         return -1;
     }
 
-    if(read_dentry_by_name(filename, &directory)==-1){  // read dentry by file name
-        return -1;                                      // fail if filename doesn't exist
-    }
+    // kernel device files are not in the boot image; look them up first
+    device = device_file_lookup(filename);
 
-    // start from index 2 in fd (0 and 1 are for stdin and stdout) through 8 non-inclusive (max 8 files to support)
-    for(i=2;i<8;i++){                                   // iterate through each index in file array (not stdin or stdout)
-        if(current_pcb->file_array[i].used == 0){         // if it's not used, check file type
-            if(directory.file_type==0){
-                current_pcb->file_array[i].fileop_ptr = &rtc_fileop_table;          // give rtc its op
-            }
-            else if(directory.file_type == 1){
-                current_pcb->file_array[i].fileop_ptr = &dir_fileop_table;    // give directory its op
-            }
-            else if(directory.file_type == 2){
-                current_pcb->file_array[i].fileop_ptr = &file_fileop_table;         // give file its file op
-            }
-            current_pcb->file_array[i].inode_number = directory.inode_number;           // assign inode
-            current_pcb->file_array[i].file_position = 0;                               // set file position to 0
-            current_pcb->file_array[i].used = 1;                                        // set it to used
-            return i;                                                                   // return the index modified
+    if(device == NULL){
+        // unlink cannot remove the file between finding it and opening it
+        fs_lookup_lock();
+        if(read_dentry_by_name(filename, &directory)==-1){  // read dentry by file name
+            fs_lookup_unlock();
+            return -1;                                  // fail if filename doesn't exist
+        }
+        if(directory.file_type==0){
+            fileop = &rtc_fileop_table;                 // give rtc its op
         }
+        else if(directory.file_type == 1){
+            fileop = &dir_fileop_table;                 // give directory its op
+        }
+        else{
+            fileop = &file_fileop_table;                // give file its file op
+        }
+        fd = open_install(fileop, directory.inode_number);
+        fs_lookup_unlock();
+        return fd;                                      // return the descriptor
     }
-    return -1;      // fail if all used
 
+    fileop = device->fileop_ptr;                        // give the device its op
+    return open_install(fileop, device->inode);         // tells the driver which file
 }
 
 // CHANGED; verified
@@ -377,27 +389,13 @@ int32_t open(const uint8_t* filename){
  *   SIDE EFFECTS: Should not allow attempts to close default descriptors (0 for input, 1 for output)
  */
 int32_t close(int32_t fd){
-    // check if fd is an invalid descriptor (valid descriptor needs to be between 2 and 7 inclusive (0 indexed)); if so, return -1
-    if(fd < 2 || fd > 7){
+    // default descriptors cannot be closed
+    if(fd < 2){
         return -1;
     }
 
-    // retrieve the current pcb pointer and file array pointer
-    pcb_struct* current_pcb = get_pcb_ptr();
-
-    //check if the file is in use; if not, cannot close
-    if (current_pcb->file_array[fd].used == 0) {
-        return -1;
-    }
-    
-
-    // file is open, so set free the descriptor (file_position reset in open)
-    current_pcb->file_array[fd].used = 0;                // 0 for free descriptor
-
-    // close the file by calling the appropriate file operation 
-    return current_pcb->file_array[fd].fileop_ptr->close(fd);
-
-;
+    // the driver's close runs once no other descriptor shares the file
+    return fd_close(get_pcb_ptr(), fd);
 }
 
 /*read
@@ -411,23 +409,20 @@ SIDE EFFECTS: read the fd to the buf
 int32_t read(int32_t fd, void* buf, int32_t nbytes){
     sti();
 
-    // check if fd is an invalid descriptor (valid descriptor needs to be between 0 and 7 inclusive (0 indexed)); if so, return -1
-    // also check if we are given invalid buffer and bytes to read is less than 0
-    if (fd < 0 || fd > 7 || buf == NULL || nbytes < 0) return -1;
-
-    // if we are reading from stdout, return -1; invalid
-    if (fd == 1) return -1;
+    // check if we are given invalid buffer and bytes to read is less than 0
+    if (buf == NULL || nbytes < 0) return -1;
 
-    // get the current pcb 
-    pcb_struct*  curr_pcb = get_pcb_ptr();
-
-    //check if the file is in use; if not, cannot read from it, so return -1
-    if (curr_pcb->file_array[fd].used == 0) {
+    //check if the descriptor is open; if not, cannot read from it, so return -1
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    if (file == NULL) {
         return -1;
     }
+
+    // if it cannot be read (stdout), return -1; invalid
+    if (file->fileop_ptr->read == NULL) return -1;
     
     // read and return result (how many bytes read)
-    return curr_pcb->file_array[fd].fileop_ptr->read(fd, buf, nbytes);
+    return file->fileop_ptr->read(fd, buf, nbytes);
 
 }
 
@@ -440,23 +435,20 @@ RETURN VALUE: -1 if fd is invalid or attempt to close default fd, 0 on success
 SIDE EFFECTS: write to the buf accoring to the types of file opened
 */
 int32_t write(int32_t fd, void* buf, int32_t nbytes){
-    // check if fd is an invalid descriptor (valid descriptor needs to be between 0 and 7 inclusive (0 indexed)); if so, return -1
-    // also check if we are given invalid buffer and bytes to read is less than 0
-    if (fd < 0 || fd > 8 || buf == NULL || nbytes < 0) return -1;
+    // check if we are given invalid buffer and bytes to write is less than 0
+    if (buf == NULL || nbytes < 0) return -1;
 
-    // if we are writing to stdin, return -1; invalid
-    if (fd == 0) return -1;
-
-    // get current pcb 
-    pcb_struct*  curr_pcb = get_pcb_ptr();
-
-    //check if the file is in use, if not, cannot read, so return -1
-    if (curr_pcb->file_array[fd].used == 0) {
+    //check if the descriptor is open, if not, cannot write, so return -1
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    if (file == NULL) {
         return -1;
     }
 
+    // if it cannot be written (stdin), return -1; invalid
+    if (file->fileop_ptr->write == NULL) return -1;
+
     // write and return result
-    return curr_pcb->file_array[fd].fileop_ptr->write(fd, buf, nbytes);
+    return file->fileop_ptr->write(fd, buf, nbytes);
 }
 
 
@@ -476,6 +468,10 @@ void init_file_op_table() {
     init_directory_fileop();
     init_stdout_fileop();
     init_stdin_fileop();
+    init_trace_fileop();
+    init_profile_fileop();
+    init_sysstat_fileop();
+    init_proc_fileop();
 }
 
 /* getargs
@@ -528,29 +524,580 @@ int32_t vidmap(uint32_t** screen_start){
     pte[0].user_supervisor = 1;       // page can be used by user
     pte[0].bit_addr_31_12 = (int)(VIDEO_MEM_ADDR>>PAGE_FRAME_BITS);   // map the page to virtual mem
 
-    // set up the virtual mem video page
-    pde[(USERSPACE_ADDR + ADDRESS_8MB)>>22].kb.present = 1;    // mark the page as present
-    pde[(USERSPACE_ADDR + ADDRESS_8MB)>>22].kb.page_size = 0;       // the page is 4 kb in size
-    pde[(USERSPACE_ADDR + ADDRESS_8MB)>>22].kb.user_supervisor = 1;       // page can be used by user
-    pde[(USERSPACE_ADDR + ADDRESS_8MB)>>22].kb.bit_addr_31_12 = (int)pte >> PAGE_FRAME_BITS;   // map the page to pte in physical mem
-    
-
-    flush_tlb(); // flush tlb
+    // set up the virtual mem video page; it follows the process from CPU to CPU
+    get_pcb_ptr()->vidmap = 1;
+    process_load(cur_pid);
 
     *screen_start = (uint32_t*)(USERSPACE_ADDR + ADDRESS_8MB);
 
     return 0;
 }
 
+/*
+ * set_handler
+ *   DESCRIPTION: Install a user handler for a signal
+ *   INPUTS: signum - SIG_*, handler_address - user function, NULL for the default action
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 for a bad signal number or handler address
+ *   SIDE EFFECTS: none
+ */
 int32_t set_handler(int32_t signum, void* handler_address){
-    return -1;
+    return signal_set_handler(signum, handler_address);
 }
+
+/*
+ * sigreturn
+ *   DESCRIPTION: Resume the context a signal handler interrupted
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the interrupted eax, so the exit path leaves it in place
+ *   SIDE EFFECTS: Restores the registers signal_deliver saved on the user stack
+ */
 int32_t sigreturn(void){
-    return -1;
+    return signal_return();
+}
+
+/*
+ * nice
+ *   DESCRIPTION: Set the scheduling nice value of a process
+ *   INPUTS: pid - process to change, -1 for the caller
+ *           value - NICE_MIN (favored) to NICE_MAX (background)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the pid is not running or value is out of range
+ *   SIDE EFFECTS: sched.c applies it from the process's next tick
+ */
+int32_t nice(int32_t pid, int32_t value){
+    if(pid == -1){
+        pid = cur_pid;
+    }
+    if(pid < 0 || pid >= MAX_PID_NUM || !pid_array[pid]){
+        return -1;
+    }
+    if(value < NICE_MIN || value > NICE_MAX){
+        return -1;
+    }
+    get_pcb(pid)->nice = value;
+    return 0;
+}
+
+/*
+ * sleep
+ *   DESCRIPTION: Suspend the calling process
+ *   INPUTS: ms - milliseconds to sleep, rounded up to whole timer ticks
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: other processes run meanwhile (timer.c)
+ */
+int32_t sleep(uint32_t ms){
+    timer_sleep(TIMER_MS_TO_TICKS(ms));
+    return 0;
+}
+
+/*
+ * fdlimit
+ *   DESCRIPTION: Get or set how many file descriptors the caller may have open
+ *   INPUTS: limit - new limit, NUM_FILE_DES to FD_MAX, or 0 to only ask
+ *   OUTPUTS: none
+ *   RETURN VALUE: the limit before the call, -1 if limit is out of range or
+ *                 below a descriptor that is open
+ *   SIDE EFFECTS: programs executed afterwards inherit the limit
+ */
+int32_t fdlimit(int32_t limit){
+    pcb_struct* pcb = get_pcb_ptr();
+
+    if(limit == 0){
+        return pcb->fd_limit;
+    }
+    return fd_set_limit(pcb, limit);
+}
+
+/*
+ * dup
+ *   DESCRIPTION: Open another descriptor to the same file
+ *   INPUTS: fd - an open descriptor
+ *   OUTPUTS: none
+ *   RETURN VALUE: the lowest free descriptor, now sharing fd's file and
+ *                 position; -1 if fd is not open or no descriptor is free
+ *   SIDE EFFECTS: none
+ */
+int32_t dup(int32_t fd){
+    pcb_struct* pcb = get_pcb_ptr();
+    file_array_struct* file = fd_get(pcb, fd);
+    int32_t new_fd;
+
+    if(file == NULL){
+        return -1;
+    }
+    file_get(file);
+    new_fd = fd_install(pcb, -1, file);
+    if(new_fd == -1){
+        file_put(file);
+    }
+    return new_fd;
+}
+
+/*
+ * dup2
+ *   DESCRIPTION: Make a given descriptor refer to the file of another
+ *   INPUTS: fd - an open descriptor, new_fd - descriptor to point at its file
+ *   OUTPUTS: none
+ *   RETURN VALUE: new_fd, -1 if fd is not open or new_fd is past the limit
+ *   SIDE EFFECTS: Closes what new_fd had open first, stdin and stdout
+ *                 included, which is how a child gets its output redirected
+ */
+int32_t dup2(int32_t fd, int32_t new_fd){
+    pcb_struct* pcb = get_pcb_ptr();
+    file_array_struct* file = fd_get(pcb, fd);
+
+    if(file == NULL || new_fd < 0 || new_fd >= (int32_t)pcb->fd_limit){
+        return -1;
+    }
+    if(new_fd == fd){
+        return new_fd;
+    }
+    file_get(file);
+    fd_close(pcb, new_fd);
+    if(fd_install(pcb, new_fd, file) == -1){
+        file_put(file);                 // no chunk left for it in the pool
+        return -1;
+    }
+    return new_fd;
+}
+
+
+/*
+ * lseek
+ *   DESCRIPTION: Move the position of an open file
+ *   INPUTS: fd - an open descriptor, offset - how far, whence - SEEK_SET,
+ *           SEEK_CUR or SEEK_END
+ *   OUTPUTS: none
+ *   RETURN VALUE: the new position, -1 if fd is not open, its driver has no
+ *                 position (terminal, rtc) or the result would be negative
+ *   SIDE EFFECTS: descriptors sharing the file move with it
+ */
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+
+    if(file == NULL || file->fileop_ptr->lseek == NULL){
+        return -1;
+    }
+    return file->fileop_ptr->lseek(fd, offset, whence);
+}
+
+/*
+ * pread
+ *   DESCRIPTION: Read from a given offset of an open file
+ *   INPUTS: fd - an open descriptor, buf - where to, nbytes - how much,
+ *           offset - where from
+ *   OUTPUTS: none
+ *   RETURN VALUE: bytes read, -1 if fd is not open or its driver has no position
+ *   SIDE EFFECTS: The file's position stays where it was, so a program can
+ *                 go back over a file without reopening or seeking
+ */
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
+    file_array_struct* file;
+
+    if(buf == NULL || nbytes < 0) return -1;
+
+    file = fd_get(get_pcb_ptr(), fd);
+    if(file == NULL || file->fileop_ptr->pread == NULL){
+        return -1;
+    }
+    return file->fileop_ptr->pread(fd, buf, nbytes, offset);
+}
+
+/*
+ * readv
+ *   DESCRIPTION: Read into several buffers with one system call
+ *   INPUTS: fd - an open descriptor, iov - the buffers, iovcnt - 1 to IOV_MAX
+ *   OUTPUTS: none
+ *   RETURN VALUE: total bytes read, -1 if fd is not open, the buffers are bad
+ *                 or the first read fails
+ *   SIDE EFFECTS: Stops at the first buffer the driver does not fill (end of
+ *                 file, or a terminal line), as separate reads would
+ */
+int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt){
+    sti();
+    return transfer_vector(fd, iov, iovcnt, 0);
+}
+
+/*
+ * writev
+ *   DESCRIPTION: Write from several buffers with one system call
+ *   INPUTS: fd - an open descriptor, iov - the buffers, iovcnt - 1 to IOV_MAX
+ *   OUTPUTS: none
+ *   RETURN VALUE: total bytes written, -1 if fd is not open, the buffers are
+ *                 bad or the first write fails
+ *   SIDE EFFECTS: Stops at the first buffer the driver does not take in full
+ */
+int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt){
+    return transfer_vector(fd, iov, iovcnt, 1);
+}
+
+
+/*
+ * getdents
+ *   DESCRIPTION: Read as many directory entries as fit in a buffer
+ *   INPUTS: fd - a descriptor open on the directory, buf - where to put the
+ *           dirent_t records, nbytes - size of buf
+ *   OUTPUTS: none
+ *   RETURN VALUE: bytes filled, 0 past the last entry, -1 if fd is not an open
+ *                 directory or buf is too small for one record
+ *   SIDE EFFECTS: Shares the position read() uses on the directory, so
+ *                 listing it takes one call per buffer rather than per name
+ */
+int32_t getdents(int32_t fd, dirent_t* buf, int32_t nbytes){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+
+    if(buf == NULL || file == NULL || file->fileop_ptr != &dir_fileop_table){
+        return -1;
+    }
+    return directory_getdents(fd, buf, nbytes);
+}
+
+
+/*
+ * stat
+ *   DESCRIPTION: Describe a file by name
+ *   INPUTS: filename - as open takes it, buf - where to put the stat_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if there is no such file or buf is NULL
+ *   SIDE EFFECTS: none
+ */
+int32_t stat(const uint8_t* filename, stat_t* buf){
+    dentry_t directory;
+
+    if(filename == NULL || buf == NULL || strlen((char*)filename) == 0){
+        return -1;
+    }
+    if(device_file_lookup(filename) != NULL){
+        return file_stat(DEVICE_FILE_TYPE, 0, buf);
+    }
+    if(read_dentry_by_name(filename, &directory) == -1){
+        return -1;
+    }
+    return file_stat(directory.file_type, directory.inode_number, buf);
+}
+
+/*
+ * fstat
+ *   DESCRIPTION: Describe the file an open descriptor refers to
+ *   INPUTS: fd - an open descriptor, buf - where to put the stat_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if fd is not open or buf is NULL
+ *   SIDE EFFECTS: none
+ */
+int32_t fstat(int32_t fd, stat_t* buf){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    uint32_t file_type;
+
+    if(file == NULL || buf == NULL){
+        return -1;
+    }
+    // the driver tells which kind of file open found
+    if(file->fileop_ptr == &file_fileop_table){
+        file_type = REGULAR_FILE_TYPE;
+    } else if(file->fileop_ptr == &dir_fileop_table){
+        file_type = DIRECTORY_FILE_TYPE;
+    } else if(file->fileop_ptr == &rtc_fileop_table){
+        file_type = RTC_FILE_TYPE;
+    } else {
+        file_type = DEVICE_FILE_TYPE;               // terminal and kernel device files
+    }
+    return file_stat(file_type, file->inode_number, buf);
+}
+
+
+/*
+ * create
+ *   DESCRIPTION: Make an empty regular file and open it
+ *   INPUTS: filename - 1 to 32 characters
+ *   OUTPUTS: none
+ *   RETURN VALUE: the descriptor, -1 if the name is taken by something other
+ *                 than a regular file (or a device), the file system is full
+ *                 or read-only, or no descriptor is free
+ *   SIDE EFFECTS: An existing regular file of that name is emptied instead
+ */
+int32_t create(const uint8_t* filename){
+    int32_t inode, fd = -1;
+
+    if(filename == NULL || device_file_lookup(filename) != NULL){
+        return -1;
+    }
+    // the lookup, the create or truncate, and the open are one step to unlink and other creates
+    fs_lookup_lock();
+    inode = file_create(filename);
+    if(inode != -1){
+        fd = open_install(&file_fileop_table, inode);
+    }
+    fs_lookup_unlock();
+    return fd;
+}
+
+/*
+ * unlink
+ *   DESCRIPTION: Remove a regular file
+ *   INPUTS: filename - its name
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if there is no such regular file or a
+ *                 process has it open
+ *   SIDE EFFECTS: Its blocks and inode go back to the file system
+ */
+int32_t unlink(const uint8_t* filename){
+    if(filename == NULL){
+        return -1;
+    }
+    return file_unlink(filename);       // looks the name up and checks it under fs_lock
+}
+
+/*
+ * ftruncate
+ *   DESCRIPTION: Set the length of an open regular file
+ *   INPUTS: fd - an open descriptor, length - new length in bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if fd is not an open regular file or the
+ *                 file system cannot grow it that far
+ *   SIDE EFFECTS: The position stays put, even if now past the end
+ */
+int32_t ftruncate(int32_t fd, uint32_t length){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+
+    if(file == NULL || file->fileop_ptr != &file_fileop_table){
+        return -1;
+    }
+    return file_truncate(file->inode_number, length);
+}
+
+/*
+ * io_setup
+ *   DESCRIPTION: Register a submission/completion ring
+ *   INPUTS: ring - in the caller's user page, NULL to drop the current one
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the ring is not inside the user page
+ *   SIDE EFFECTS: Empties the ring
+ */
+int32_t io_setup(void* ring){
+    return io_ring_setup(get_pcb_ptr(), ring);
+}
+
+/*
+ * io_enter
+ *   DESCRIPTION: Run the requests queued on the caller's ring
+ *   INPUTS: to_submit - most requests to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of requests run, -1 if there is no ring or its
+ *                 counters are inconsistent
+ *   SIDE EFFECTS: Posts a result for each one; stops early when the
+ *                 completion ring is full
+ */
+int32_t io_enter(uint32_t to_submit){
+    pcb_struct* pcb = get_pcb_ptr();
+
+    if(pcb->io_ring == 0){
+        return -1;
+    }
+    return io_ring_enter((io_ring_t*)pcb->io_ring, to_submit);
+}
+
+/*
+ * poll
+ *   DESCRIPTION: Wait until one of several descriptors is ready
+ *   INPUTS: fds - descriptors and the events wanted, nfds - how many
+ *           timeout_ms - -1 to wait for ever, 0 to return at once
+ *   OUTPUTS: revents of each
+ *   RETURN VALUE: number of ready descriptors, 0 on a timeout, -1 for a bad
+ *                 fds or nfds
+ *   SIDE EFFECTS: Sleeps until a driver reports a change or the timeout
+ */
+int32_t poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms){
+    return poll_fds(get_pcb_ptr(), fds, nfds, timeout_ms);
+}
+
+/* ioctl
+DESCRIPTION: control an open file: its flags (IOCTL_GETFL/SETFL, for every file) or
+             its device (IOCTL_TGETMODE/TSETMODE for the terminal, through the driver)
+INPUTS: fd - an open descriptor, request - IOCTL_*, arg - the new flags or mode for the set requests
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not open, or the request or arg is not one the file takes); the flags or mode for the get requests, 0 for the set requests (on success)
+SIDE EFFECTS: the flags belong to the open file, so descriptors dup shares it with see them too
+*/
+int32_t ioctl(int32_t fd, uint32_t request, uint32_t arg){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+
+    if(file == NULL){
+        return -1;
+    }
+    switch(request){
+        case IOCTL_GETFL:
+            return file->flags;
+        case IOCTL_SETFL:
+            if(arg & ~O_NONBLOCK){
+                return -1;
+            }
+            file->flags = arg;
+            return 0;
+        default:
+            if(file->fileop_ptr->ioctl == NULL){
+                return -1;
+            }
+            return file->fileop_ptr->ioctl(fd, request, arg);
+    }
 }
 
 
 //////////////////////////helper function///////////////////////////////////
+/*
+ * open_install
+ *   DESCRIPTION: The end of open and create: a new open file on the lowest
+ *                free descriptor, up to the process's limit
+ *   INPUTS: fileop - the file's driver, inode - handed to the driver
+ *   OUTPUTS: none
+ *   RETURN VALUE: the descriptor, -1 if every open file or descriptor is taken
+ *   SIDE EFFECTS: none
+ */
+static int32_t open_install(fileop_table_t* fileop, uint32_t inode){
+    file_array_struct* file;
+    int32_t fd;
+
+    file = file_alloc(fileop, inode);
+    if(file == NULL){
+        return -1;                                      // fail if every open file is taken
+    }
+    fd = fd_install(get_pcb_ptr(), -1, file);
+    if(fd == -1){
+        file_put(file);
+        return -1;                                      // fail if all used
+    }
+    return fd;
+}
+
+/*
+ * transfer_vector
+ *   DESCRIPTION: The loop behind readv and writev
+ *   INPUTS: fd, iov, iovcnt - as the system calls take them
+ *           write - 0 to go through the driver's read, 1 for its write
+ *   OUTPUTS: none
+ *   RETURN VALUE: total bytes moved, -1 if nothing was moved because of an error
+ *   SIDE EFFECTS: Checks every buffer before moving anything
+ */
+static int32_t transfer_vector(int32_t fd, const iovec_t* iov, int32_t iovcnt, int32_t write){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    int32_t total = 0, ret, i;
+
+    if(file == NULL || iov == NULL || iovcnt < 1 || iovcnt > IOV_MAX){
+        return -1;
+    }
+    if((write && file->fileop_ptr->write == NULL) || (!write && file->fileop_ptr->read == NULL)){
+        return -1;
+    }
+    for(i = 0; i < iovcnt; i++){
+        if(iov[i].base == NULL || iov[i].len < 0 || iov[i].len > INT32_MAX - total){
+            return -1;
+        }
+        total += iov[i].len;
+    }
+
+    total = 0;
+    for(i = 0; i < iovcnt; i++){
+        if(write){
+            ret = file->fileop_ptr->write(fd, iov[i].base, iov[i].len);
+        } else {
+            ret = file->fileop_ptr->read(fd, iov[i].base, iov[i].len);
+        }
+        if(ret < 0){
+            return total > 0 ? total : -1;
+        }
+        total += ret;
+        if(ret < iov[i].len){
+            break;
+        }
+    }
+    return total;
+}
+/*
+ * process_alloc_std
+ *   DESCRIPTION: Make the open files of a terminal's stdin and stdout
+ *   INPUTS: none
+ *   OUTPUTS: std - stdin and stdout
+ *   RETURN VALUE: 0 on success, -1 if the open file table is full (neither is taken)
+ *   SIDE EFFECTS: takes two open file slots
+ */
+static int32_t process_alloc_std(file_array_struct* std[2]){
+    std[0] = file_alloc(&stdin_fileop_table, 0);
+    std[1] = file_alloc(&stdout_fileop_table, 0);
+    if(std[0] == NULL || std[1] == NULL){
+        if(std[0] != NULL) file_put(std[0]);
+        if(std[1] != NULL) file_put(std[1]);
+        std[0] = std[1] = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * process_open_std
+ *   DESCRIPTION: Open stdin and stdout again for a terminal's first program
+ *                when it restarts
+ *   INPUTS: pcb - the process, with descriptors 0 and 1 free
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: takes two open file slots. If the table is full they stay
+ *                 closed, so reading and writing them fail rather than fault.
+ */
+static void process_open_std(pcb_struct* pcb){
+    file_array_struct* std[2];
+
+    if(process_alloc_std(std) == 0){
+        fd_install(pcb, 0, std[0]);      //sender in
+        fd_install(pcb, 1, std[1]);      //sender out
+    }
+}
+
+/*
+ * device_file_lookup
+ *   DESCRIPTION: Find the kernel device file with the given name
+ *   INPUTS: filename - name passed to open
+ *   OUTPUTS: none
+ *   RETURN VALUE: the device file entry, or NULL if no device has that name
+ *   SIDE EFFECTS: none
+ */
+static device_file_t* device_file_lookup(const uint8_t* filename){
+    int i;
+    for(i = 0; i < NUM_DEVICE_FILES; i++){
+        if(strncmp((int8_t*)filename, device_files[i].name, MAX_FILE_NAME) == 0){
+            return &device_files[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * syscall_enter, syscall_exit
+ *   DESCRIPTION: Called by system_call_handler_asm around every dispatched system call
+ *   INPUTS: num - system call number (1-29), ret - value the call returned,
+ *           start - record on the caller's kernel stack shared by both hooks
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Records syscall entry/exit tracepoints and per-pid statistics.
+ *                 The pid is taken at entry because execute/halt change cur_pid.
+ */
+void syscall_enter(uint32_t num, syscall_start_t* start){
+    TRACE(TRACE_SYSCALL_ENTER, num, 0);
+    start->pid = cur_pid;
+    rdtsc(&start->tsc_lo, &start->tsc_hi);
+}
+
+void syscall_exit(uint32_t num, int32_t ret, syscall_start_t* start){
+    uint32_t lo, hi;
+
+    rdtsc(&lo, &hi);
+    // 64 bit end - start, borrowing from the high half
+    hi = hi - start->tsc_hi - (lo < start->tsc_lo);
+    lo = lo - start->tsc_lo;
+    sysstat_record(num, start->pid, ret, lo, hi);
+    TRACE(TRACE_SYSCALL_EXIT, num, ret);
+}
+
 /* x
  * get_pcb_ptr
  *   DESCRIPTION: Get the pointer to the PCB of current process (for file system use)
@@ -563,7 +1110,7 @@ int32_t sigreturn(void){
 pcb_struct* get_pcb_ptr(){
     // return (pcb_struct*)(ADDRESS_8MB-NUM_BITS_8KB*(cur_pid+1));
     // return (pcb_struct*)(ADDRESS_8MB-NUM_BITS_8KB*(current_terminal->curr_pcb_ptr->pid+1));
-    return (pcb_struct*)(ADDRESS_8MB-NUM_BITS_8KB*(current_terminal->pid+1));
+    return (pcb_struct*)(ADDRESS_8MB-NUM_BITS_8KB*(cur_pid+1));
 }
 
 /* 
@@ -578,6 +1125,34 @@ pcb_struct* get_pcb(uint32_t pid){
     return (pcb_struct*)(ADDRESS_8MB-NUM_BITS_8KB*(pid+1));
 }
 
+/* 
+ * process_load
+ *   DESCRIPTION: Make a process's address space and kernel stack current on this CPU
+ *   INPUTS: pid - process to load
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Points this CPU's 128MB page at the process's 4MB frame, maps or
+ *                 unmaps its vidmap page, sets esp0 in this CPU's TSS, flushes the TLB
+ */
+void process_load(uint32_t pid){
+    cpu_t* cpu = this_cpu();
+    page_directory_entry* vid = &cpu->pd[(USERSPACE_ADDR + ADDRESS_8MB) >> 22];
+
+    cpu->pd[USERSPACE_ADDR >> 22].kb.bit_addr_31_12 = ((PHYSICAL_MEMORY_START_IDX + pid) * ADDRESS_4MB) >> PAGE_FRAME_BITS;
+    if(get_pcb(pid)->vidmap){
+        vid->kb.page_size = 0;                  // the page is 4 kb in size
+        vid->kb.user_supervisor = 1;            // page can be used by user
+        vid->kb.bit_addr_31_12 = (int)pte >> PAGE_FRAME_BITS;   // map the page to pte in physical mem
+        vid->kb.present = 1;
+    } else{
+        vid->kb.present = 0;
+    }
+    flush_tlb();
+
+    cpu->tss->ss0 = KERNEL_DS;
+    cpu->tss->esp0 = ADDRESS_8MB - (NUM_BITS_8KB*pid) - sizeof(int32_t);
+}
+
 
 /*
 DESCRIPTION: assign open, close, read, write operations to different operations
@@ -592,28 +1167,60 @@ void init_rtc_fileop(){
     rtc_fileop_table.close = rtc_close;
     rtc_fileop_table.read = rtc_read;
     rtc_fileop_table.write = rtc_write;
+    rtc_fileop_table.poll = rtc_poll;
 }
 void init_file_fileop(){
     file_fileop_table.open = file_open;
     file_fileop_table.close = file_close;
     file_fileop_table.read  = file_read;
     file_fileop_table.write = file_write;
+    file_fileop_table.lseek = file_lseek;
+    file_fileop_table.pread = file_pread;
 }
 void init_directory_fileop(){
     dir_fileop_table.open = directory_open;
     dir_fileop_table.close = directory_close;
     dir_fileop_table.read  = directory_read;
     dir_fileop_table.write = directory_write;
+    dir_fileop_table.lseek = directory_lseek;
+    dir_fileop_table.pread = directory_pread;
 }
 void init_stdout_fileop(){
     stdout_fileop_table.open = terminal_open;
     stdout_fileop_table.close = terminal_close;
     stdout_fileop_table.read = NULL;
     stdout_fileop_table.write = terminal_write;
+    stdout_fileop_table.ioctl = terminal_ioctl;
 }
 void init_stdin_fileop(){
     stdin_fileop_table.open = terminal_open;
     stdin_fileop_table.close = terminal_close;
     stdin_fileop_table.read = terminal_read;
     stdin_fileop_table.write = NULL;
+    stdin_fileop_table.poll = terminal_poll;
+    stdin_fileop_table.ioctl = terminal_ioctl;
+}
+void init_trace_fileop(){
+    trace_fileop_table.open = trace_open;
+    trace_fileop_table.close = trace_close;
+    trace_fileop_table.read = trace_read;
+    trace_fileop_table.write = trace_write;
+}
+void init_profile_fileop(){
+    profile_fileop_table.open = profile_open;
+    profile_fileop_table.close = profile_close;
+    profile_fileop_table.read = profile_read;
+    profile_fileop_table.write = profile_write;
+}
+void init_sysstat_fileop(){
+    sysstat_fileop_table.open = sysstat_open;
+    sysstat_fileop_table.close = sysstat_close;
+    sysstat_fileop_table.read = sysstat_read;
+    sysstat_fileop_table.write = sysstat_write;
+}
+void init_proc_fileop(){
+    proc_fileop_table.open = proc_open;
+    proc_fileop_table.close = proc_close;
+    proc_fileop_table.read = proc_read;
+    proc_fileop_table.write = proc_write;
 }
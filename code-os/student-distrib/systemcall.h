@@ -4,13 +4,20 @@
 #include "types.h"
 #include "lib.h"
 #include "file_system.h"
+#include "smp.h"
 
 
-#define NUM_FILE_DES 8
+#define NUM_FILE_DES 8              // descriptors kept in the PCB (fd.h)
+#define FD_MAX       64             // highest descriptor limit a process can have
+#define FD_CHUNK     8              // descriptors per chunk beyond NUM_FILE_DES
+#define FD_CHUNKS_PER_PROC ((FD_MAX - NUM_FILE_DES) / FD_CHUNK)
 #define IMAGE_ADDR 0x08048000
 #define PROGRAM_IMAGE_OFFSET 0x48000
 
-#define MAX_PID_NUM         8
+#define MAX_PID_NUM         8           // layout.ld checks the kernel ends below their PCBs
+#define NICE_MIN            -20         // scheduling nice values (sched.c)
+#define NICE_MAX            19
+#define NUM_SIGNALS         5           // signal.h
 #define PHYSICAL_MEMORY_START_IDX  2
 #define ELF_SIZE        4
 #define ELF_START       24
@@ -36,16 +43,65 @@ typedef struct{
     int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
     int32_t (*open)(const uint8_t* fname);
     int32_t (*close)(int32_t fd);
+    // optional, NULL where the device has no position (terminal, rtc)
+    int32_t (*lseek)(int32_t fd, int32_t offset, int32_t whence);
+    int32_t (*pread)(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+    // optional POLL* mask of what would not block now; NULL for always ready (poll.c)
+    int32_t (*poll)(int32_t fd);
+    // optional, for the ioctl requests the system call does not handle itself
+    int32_t (*ioctl)(int32_t fd, uint32_t request, uint32_t arg);
 } fileop_table_t;
 
+#define SEEK_SET            0           // lseek whence: from the start
+#define SEEK_CUR            1           // from the current position
+#define SEEK_END            2           // from the end of the file
+#define IOV_MAX             16          // buffers one readv or writev takes
+
+#define POLLIN              0x01        // poll events: read would not block
+#define POLLOUT             0x04        // write would not block
+#define POLLNVAL            0x20        // revents only: the descriptor is not open
+
+#define O_NONBLOCK          0x1         // open file flags: read returns 0 rather than wait
+#define IOCTL_GETFL         1           // ioctl requests: the open file's flags, any descriptor
+#define IOCTL_SETFL         2
+#define IOCTL_TGETMODE      3           // terminal mode (TERM_* in terminal.h)
+#define IOCTL_TSETMODE      4
+
+/* One descriptor of a poll */
+typedef struct {
+    int32_t fd;
+    int16_t events;             // POLLIN and/or POLLOUT
+    int16_t revents;            // filled in by poll
+} pollfd_t;
+
+/* One buffer of a readv or writev */
+typedef struct {
+    void* base;
+    int32_t len;
+} iovec_t;
+
 fileop_table_t rtc_fileop_table;
 fileop_table_t dir_fileop_table;
 fileop_table_t file_fileop_table;
 fileop_table_t stdin_fileop_table;
 fileop_table_t stdout_fileop_table;
+fileop_table_t trace_fileop_table;
+fileop_table_t profile_fileop_table;
+fileop_table_t sysstat_fileop_table;
+fileop_table_t proc_fileop_table;
 
-// called by pit handler to handle RR scheduling
-extern void switch_process();
+/* Kernel device file: a name that open() resolves to a driver rather than
+ * to a dentry in the boot image (e.g. "trace") */
+typedef struct {
+    int8_t* name;
+    fileop_table_t* fileop_ptr;
+    uint32_t inode;             // handed to the driver through file_array[fd].inode_number
+} device_file_t;
+
+// pid of the process running on this CPU (set by execute/halt and the scheduler)
+#define cur_pid (this_cpu()->pid)
+// nonzero for each pid in use
+extern uint32_t pid_array[MAX_PID_NUM];
 
 void init_file_op_table();
 /* Functions to get the file operations jump table for the 4 file types */
@@ -90,12 +146,55 @@ void init_file_fileop();
  */
 void init_directory_fileop();
 
-/* file array structure */
+/* 
+ * init_trace_fileop
+ *   DESCRIPTION: Sets up a file operations jump table for the trace device
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Sets up a file operations jump table structure
+ */
+void init_trace_fileop();
+
+/* 
+ * init_profile_fileop
+ *   DESCRIPTION: Sets up a file operations jump table for the profile device
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Sets up a file operations jump table structure
+ */
+void init_profile_fileop();
+
+/* 
+ * init_sysstat_fileop
+ *   DESCRIPTION: Sets up a file operations jump table for the sysstat device
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Sets up a file operations jump table structure
+ */
+void init_sysstat_fileop();
+
+/* 
+ * init_proc_fileop
+ *   DESCRIPTION: Sets up a file operations jump table for the synthetic proc/ files
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Sets up a file operations jump table structure
+ */
+void init_proc_fileop();
+
+/* open file, shared by every descriptor dup, dup2 or execute made from the
+ * one open returned (fd.c) */
 typedef struct {
     fileop_table_t* fileop_ptr; // To implement in later checkpoints, when we implement wrap drivers around a unified file system call interface (like the POSIX API)
     uint32_t inode_number;
     uint32_t file_position;
-    uint32_t used;
+    uint32_t flags;             // O_NONBLOCK
+    uint32_t readahead;         // data block a sequential read comes to next (file_system.c)
+    uint32_t refcount;          // descriptors pointing here, 0 while the slot is free
 } file_array_struct;
 
 
@@ -109,8 +208,21 @@ typedef struct{
     uint32_t eip_user;
     uint32_t esp_user;
     uint8_t command_arg[32];
-    file_array_struct file_array[NUM_FILE_DES];
+    file_array_struct* file_array[NUM_FILE_DES];   // descriptors 0-7; the rest through fd_get
+    file_array_struct** fd_chunk[FD_CHUNKS_PER_PROC];  // descriptors 8 and up, from the fd.c pool
+    uint32_t fd_used[FD_MAX / 32];  // bit per open descriptor
+    uint32_t fd_limit;          // descriptors from here up are refused, inherited from the parent
     uint32_t terminal_num;
+    uint32_t exe_inode;         // inode of the running executable (names samples in profile.c)
+    uint32_t user_ticks;        // timer ticks spent at CPL 3
+    uint32_t kernel_ticks;      // timer ticks spent in the kernel on its behalf
+    uint32_t vidmap;            // 1 once it called vidmap (process_load maps the page)
+    int32_t nice;               // NICE_MIN..NICE_MAX, inherited from the parent
+    uint32_t sig_handler[NUM_SIGNALS];  // user handler addresses, 0 for the default action
+    volatile uint32_t sig_pending;      // bit per raised signal (signal_send)
+    uint32_t sig_masked;        // 1 while a handler runs, until its sigreturn
+    uint32_t io_ring;           // user address of its io_setup ring, 0 for none
+    int term_mode;              // terminal mode when it started, put back when it halts
 } pcb_struct;
 
 
@@ -122,6 +234,26 @@ typedef struct{
     */
 extern void system_call_handler_asm();
 
+/* Per-call record that system_call_handler_asm reserves on the kernel stack
+ * and passes to both hooks */
+typedef struct {
+    uint32_t tsc_lo;            // TSC at entry
+    uint32_t tsc_hi;
+    uint32_t pid;               // caller
+} syscall_start_t;
+
+/*
+ * syscall_enter, syscall_exit
+ *   DESCRIPTION: Called by system_call_handler_asm around every dispatched system call
+ *   INPUTS: num - system call number (1-29), ret - value the call returned,
+ *           start - record on the caller's kernel stack shared by both hooks
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Records syscall entry/exit tracepoints and per-pid statistics
+ */
+void syscall_enter(uint32_t num, syscall_start_t* start);
+void syscall_exit(uint32_t num, int32_t ret, syscall_start_t* start);
+
 /* x
  * get_pcb_ptr
  *   DESCRIPTION: Get the pointer to the PCB of current process (for file system use)
@@ -141,6 +273,17 @@ pcb_struct* get_pcb_ptr();
  *   SIDE EFFECTS: Finds pcb pointer for the given process
  */pcb_struct* get_pcb(uint32_t pid);
 
+/* 
+ * process_load
+ *   DESCRIPTION: Make a process's address space and kernel stack current on this CPU
+ *   INPUTS: pid - process to load
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Points this CPU's 128MB page at the process's 4MB frame, maps or
+ *                 unmaps its vidmap page, sets esp0 in this CPU's TSS, flushes the TLB
+ */
+void process_load(uint32_t pid);
+
 
 /* 
  * halt
@@ -152,6 +295,16 @@ pcb_struct* get_pcb_ptr();
  */
 int32_t halt(uint8_t status);
 
+/*
+ * process_halt
+ *   DESCRIPTION: halt with a status that does not fit a byte
+ *   INPUTS: status - what the parent's execute returns (SIG_KILL_STATUS when killed)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none, does not return
+ *   SIDE EFFECTS: halts current task, returns to parent
+ */
+int32_t process_halt(uint32_t status);
+
 
 /* execute
  *   DESCRIPTION: Execute file
@@ -225,12 +378,187 @@ SIDE EFFECTS: map the virtual and physical memory video page together
 int32_t vidmap(uint32_t** screen_start);
 
 
-/*For extra credit
-    return -1 for now*/
+/*
+set_handler
+DESCRIPTION: Install a user handler for a signal (signal.c)
+INPUTS: signum - SIG_*, handler_address - user function, NULL for the default action
+OUTPUTS: none
+RETURN VALUE: 0 on success, -1 for a bad signal number or an address outside the user page
+SIDE EFFECTS: none
+*/
 int32_t set_handler(int32_t signum, void* handler_address);
-/*For extra credit
-    return -1 for now*/
+/*
+sigreturn
+DESCRIPTION: Called by the trampoline a handler returns to; resumes the interrupted context
+INPUTS: none
+OUTPUTS: none
+RETURN VALUE: eax of the interrupted context, -1 if the saved frame is not on the user stack
+SIDE EFFECTS: unmasks signals
+*/
 int32_t sigreturn(void);
 
+/* nice
+DESCRIPTION: set the scheduling nice value of a process
+INPUTS: pid - process to change, -1 for the caller
+        value - NICE_MIN (favored) to NICE_MAX (background)
+OUTPUTS: none
+RETURN VALUE: -1 (if the pid is not running or value is out of range); 0 (on sucess)
+SIDE EFFECTS: the scheduler applies it from its next tick; processes it executes
+              afterwards inherit it
+*/
+int32_t nice(int32_t pid, int32_t value);
+
+/* sleep
+DESCRIPTION: suspend the calling process for a while
+INPUTS: ms - milliseconds, rounded up to whole timer ticks
+OUTPUTS: none
+RETURN VALUE: 0
+SIDE EFFECTS: other processes run until a kernel timer wakes it
+*/
+int32_t sleep(uint32_t ms);
+
+/* fdlimit
+DESCRIPTION: get or set how many file descriptors the caller may have open (fd.c)
+INPUTS: limit - NUM_FILE_DES to FD_MAX, 0 to leave it as it is
+OUTPUTS: none
+RETURN VALUE: -1 (if limit is out of range or below an open descriptor); the old limit (on success)
+SIDE EFFECTS: processes it executes afterwards inherit it
+*/
+int32_t fdlimit(int32_t limit);
+
+/* dup
+DESCRIPTION: open another descriptor to the file fd has open (fd.c)
+INPUTS: fd - an open descriptor
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not open or no descriptor is free); the new descriptor (on success)
+SIDE EFFECTS: both share one file position
+*/
+int32_t dup(int32_t fd);
+
+/* dup2
+DESCRIPTION: make new_fd refer to the file fd has open, closing what it had first
+INPUTS: fd - an open descriptor, new_fd - any descriptor under the limit, 0 and 1 included
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not open or new_fd is out of range); new_fd (on success)
+SIDE EFFECTS: both share one file position; children executed afterwards inherit both
+*/
+int32_t dup2(int32_t fd, int32_t new_fd);
+
+/* lseek
+DESCRIPTION: move the position of an open file or directory
+INPUTS: fd - an open descriptor, offset - bytes (entries for a directory) to move by
+        whence - SEEK_SET, SEEK_CUR or SEEK_END
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not open, cannot seek, or the position would be negative); the new position (on success)
+SIDE EFFECTS: descriptors sharing the open file see the new position
+*/
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence);
+
+/* pread
+DESCRIPTION: read from an offset of an open file without moving its position
+INPUTS: fd - an open descriptor, buf - where to read to, nbytes - how much
+        offset - where to read from (an entry index for a directory)
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not open or cannot seek); the number of bytes read (on success)
+SIDE EFFECTS: none
+*/
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+
+/* readv, writev
+DESCRIPTION: read into or write from several buffers in one system call
+INPUTS: fd - an open descriptor, iov - the buffers, in order, iovcnt - 1 to IOV_MAX
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not open, the buffers are bad, or the first transfer fails); the total moved (on success)
+SIDE EFFECTS: stops after a buffer that was not filled (or not written in full)
+*/
+int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+/* getdents
+DESCRIPTION: read a batch of directory entries with their type, inode and length (file_system.c)
+INPUTS: fd - a descriptor open on the directory, buf - room for dirent_t records, nbytes - its size
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not an open directory or buf cannot hold one record); 0 (past the last entry); bytes filled (on success)
+SIDE EFFECTS: moves the directory position past the entries returned
+*/
+int32_t getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+
+/* stat, fstat
+DESCRIPTION: report the type, inode number, length and block count of a named file or an open descriptor
+INPUTS: filename - name as open takes it, or fd - an open descriptor
+        buf - stat_t to fill
+OUTPUTS: none
+RETURN VALUE: -1 (if the file does not exist, fd is not open or buf is NULL); 0 (on success)
+SIDE EFFECTS: none
+*/
+int32_t stat(const uint8_t* filename, stat_t* buf);
+int32_t fstat(int32_t fd, stat_t* buf);
+
+/* create
+DESCRIPTION: make an empty regular file (or empty an existing one) and open it (file_system.c)
+INPUTS: filename - 1 to 32 characters
+OUTPUTS: none
+RETURN VALUE: -1 (if the name belongs to a directory, rtc or device, or the file system is full or read-only); the descriptor (on success)
+SIDE EFFECTS: adds a directory entry and takes an index node
+*/
+int32_t create(const uint8_t* filename);
+
+/* unlink
+DESCRIPTION: remove a regular file
+INPUTS: filename - its name
+OUTPUTS: none
+RETURN VALUE: -1 (if it is not a regular file or is still open); 0 (on success)
+SIDE EFFECTS: frees its index node and data blocks
+*/
+int32_t unlink(const uint8_t* filename);
+
+/* ftruncate
+DESCRIPTION: set the length of an open regular file
+INPUTS: fd - an open descriptor, length - bytes
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not a regular file or there are not enough free blocks); 0 (on success)
+SIDE EFFECTS: growing it fills the new part with zeros
+*/
+int32_t ftruncate(int32_t fd, uint32_t length);
+
+/* io_setup
+DESCRIPTION: register a submission/completion ring in the caller's user page (io_ring.c)
+INPUTS: ring - the ring, NULL to drop the current one
+OUTPUTS: none
+RETURN VALUE: -1 (if the ring is not inside the user page); 0 (on success)
+SIDE EFFECTS: empties the ring
+*/
+int32_t io_setup(void* ring);
+
+/* io_enter
+DESCRIPTION: run the requests queued on the caller's ring and post their results
+INPUTS: to_submit - most requests to run
+OUTPUTS: none
+RETURN VALUE: -1 (if there is no ring or its counters are inconsistent); number of requests run (on success)
+SIDE EFFECTS: stops early when the completion ring is full
+*/
+int32_t io_enter(uint32_t to_submit);
+
+/* poll
+DESCRIPTION: wait until one of several descriptors is ready, or a timeout (poll.c)
+INPUTS: fds - descriptors and the POLLIN/POLLOUT events wanted, nfds - how many (up to FD_MAX)
+        timeout_ms - -1 to wait for ever, 0 to return at once
+OUTPUTS: revents of each, POLLNVAL for one that is not open
+RETURN VALUE: -1 (if fds is NULL or nfds too large); number of ready descriptors, 0 on a timeout (on success)
+SIDE EFFECTS: sleeps
+*/
+int32_t poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+
+
+
+/* ioctl
+DESCRIPTION: control an open file: its flags (IOCTL_GETFL/SETFL, for every file) or
+             its device (IOCTL_TGETMODE/TSETMODE for the terminal, through the driver)
+INPUTS: fd - an open descriptor, request - IOCTL_*, arg - the new flags or mode for the set requests
+OUTPUTS: none
+RETURN VALUE: -1 (if fd is not open, or the request or arg is not one the file takes); the flags or mode for the get requests, 0 for the set requests (on success)
+SIDE EFFECTS: the flags belong to the open file, so descriptors dup shares it with see them too
+*/
+int32_t ioctl(int32_t fd, uint32_t request, uint32_t arg);
 
 #endif
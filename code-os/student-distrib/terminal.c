@@ -4,118 +4,143 @@
 #include "i8259.h"
 #include "paging.h"
 #include "systemcall.h"
+#include "trace.h"
+#include "sched.h"
+#include "fd.h"
+#include "poll.h"
 
-#define NUM_COLS    80
+#define TAB_WIDTH 4                 // columns a tab takes on screen
 
-char command[BUFFER_SIZE];          // buffer
-int command_idx = 0;                // buffer index
-extern void flush_tlb();
+static void terminal_puts(terminal_struct* term, int8_t* s);
+static void terminal_paint_scrollback(terminal_struct* term);
+static int terminal_input_put(terminal_struct* term, char c);
+static char terminal_input_take(terminal_struct* term);
+static void terminal_input_update(terminal_struct* term);
+
+/* terminal_struct* running_terminal();
+ * terminal whose process is running on this CPU
+ * 
+ * Inputs: NONE
+ * Return Value: the terminal (the displayed one until the scheduler starts a task)
+ * Side effects: none */
+terminal_struct* running_terminal(){
+    terminal_struct* term = this_cpu()->terminal;
+    return (term != NULL) ? term : current_terminal;
+}
 
 /* void switch_terminal();
  * switch to the other terminal
  * 
  * Inputs: terminal_num 
  * Return Value: none
- * Side effects: switch to the other terminal */
-
-void update_video_memory_paging(terminal_struct* next_term){
-    // if(get_pcb_ptr()->terminal_num == next_term->terminal_num){
-    //     pte[VIDEO_MEM_ADDR>>12].bit_addr_31_12 = VIDEO_MEM_ADDR>>12;   // map the page to pte in physical mem
-    //     // set up the physical mem video page
-    //     // pte[0].present = 1;
-    //     // pte[0].bit_addr_31_12 = (int)(VIDEO_MEM_ADDR>>PAGE_FRAME_BITS);   // map the page to virtual mem
-    // } else{
-    //     pte[VIDEO_MEM_ADDR>>12].bit_addr_31_12 = (VIDEO_MEM_ADDR>>12) + 1 + next_term->terminal_num;   // map the page to pte in physical mem
-
-    // }
-    pte[VIDEO_MEM_ADDR>>12].bit_addr_31_12 = (VIDEO_MEM_ADDR>>12) + 1 + next_term->terminal_num; // map the page to pte in physical mem
-    flush_tlb(); // flush tlb
-}
-
+ * Side effects: switch to the other terminal, starting its shell the first time.
+ *               Called with console_lock held (keyboard handler) */
 extern void switch_terminal(int terminal_num){
-    // int i;
+    terminal_struct* next = &terminal_array[terminal_num-1];
+    int8_t banner[16];
+
     //sanity check return if switch to the same one
     if ((terminal_num - 1) ==current_terminal->terminal_num){
         return;
     }
-    
+    TRACE(TRACE_SWITCH, current_terminal->terminal_num, terminal_num - 1);
+    terminal_scroll(current_terminal, -current_terminal->scroll_view);  // leave it showing its live screen
 
-    // if(terminal_num == 2){
-    //     printf("terminal 2");
-    // }
-    send_eoi(1);
     /* Save Terminal */
-
-    // printf("t0");
-
-    // //store command idx 
-    //current_terminal->command_idx = command_idx;
-    // //store command buffer
-    // for (i = 0; i < BUFFER_SIZE; i++){
-    //     current_terminal->command[i] = command[i];
-    // }
-
-    // printf("t1");
-
-    int cur_pos = get_cursor_position();
-    current_terminal->cursor_x = cur_pos%NUM_COLS; //store cursor location
-    current_terminal->cursor_y = cur_pos/NUM_COLS;
-
-    //pte[VIDEO_MEM_ADDR>>12].bit_addr_31_12 = VIDEO_MEM_ADDR>>12;
-    //update_video_memory_paging(current_terminal);
-
-    // printf("t02");
-
-    //save current terminal screen to video page assign to it
+    //save current terminal screen to video page assign to it; its process keeps drawing there
     memcpy((void*)current_terminal->video_buffer,(void*)VIDEO_MEM_ADDR,FOUR_KB);
-
+    current_terminal->screen.video = (char*)current_terminal->video_buffer;
+    current_terminal->screen.shown = 0;
 
     /* Get New Terminal */
-    current_terminal = (terminal_struct*) &terminal_array[terminal_num-1];
-    
-    //restore command buffer and position 
-    // for (i = 0; i < BUFFER_SIZE; i++){
-    //     command[i] = current_terminal->command[i];
-    // }
-    // printf("t03");
-
-
-    command_idx = current_terminal->command_idx; // update terminal with command idx
-    // update cursor to new position 
-    update_cursor(current_terminal->cursor_x, current_terminal->cursor_y);
-    // printf("t04");
-
+    current_terminal = next;
     //restore new current terminal screen to video page assign to it
     memcpy((void*)VIDEO_MEM_ADDR,(void*)current_terminal->video_buffer,FOUR_KB);
-    // printf("t05");
-
-    
-    if(current_terminal->number_of_processes == 0){ //print the current terminal after switching
-        //execute((uint8_t*) "shell");
-        printf("\nTerminal %d:\n", terminal_num);
-        execute((uint8_t*) "shell");
-        //execute((uint8_t*) "halt");
-    }
-    //update_video_memory_paging(current_terminal);
-
-    //flush_tlb();
+    current_terminal->screen.video = (char*)VIDEO_MEM_ADDR;
+    current_terminal->screen.shown = 1;
+    console = &current_terminal->screen;
+    // update cursor to new position 
+    update_cursor(current_terminal->screen.x, current_terminal->screen.y);
 
+    if(current_terminal->cpu == -1){ //first visit: print the terminal and start its shell
+        snprintf(banner, sizeof(banner), "\nTerminal %d:\n", terminal_num);
+        terminal_puts(current_terminal, banner);
+        sched_start(current_terminal);
+    }
+}
 
-    // if(terminal_array[current_terminal->terminal_num].number_of_processes == 0){
-    //     // if no processes have been running, then run shell 
-    //         printf("t06");
+/* void terminal_scroll(terminal_struct* term, int lines);
+ * Scroll the displayed terminal back into its scrollback or forward again
+ * 
+ * Inputs: term - the displayed terminal, lines - rows back (> 0) or forward (< 0)
+ * Return Value: none
+ * Side effects: While scrolled back, video memory shows the saved rows and the
+ *               terminal's output goes to its backing page, as if it were not
+ *               displayed. Called with console_lock held (keyboard handler) */
+void terminal_scroll(terminal_struct* term, int lines){
+    int saved = (term->scrollback.saved < SCROLLBACK_LINES) ? term->scrollback.saved : SCROLLBACK_LINES;
+    int view = term->scroll_view + lines;
+
+    if(view < 0) view = 0;
+    if(view > saved) view = saved;
+    if(view == term->scroll_view){
+        return;
+    }
 
-    //     pte[VIDEO_MEM_ADDR>>12].bit_addr_31_12 = VIDEO_MEM_ADDR>>12;   // map the page to pte in physical mem
-    //     flush_tlb();
-    //     execute((uint8_t*) "shell");
-    //         printf("t07");
+    if(term->scroll_view == 0){
+        //leaving the live screen: keep it on the backing page, where output goes meanwhile
+        memcpy((void*)term->video_buffer,(void*)VIDEO_MEM_ADDR,FOUR_KB);
+        term->screen.video = (char*)term->video_buffer;
+        term->screen.shown = 0;
+        update_cursor(0, NUM_ROWS);                 // off the screen
+    }
+    term->scroll_view = view;
+    if(view == 0){
+        //back to the live screen, with what was written meanwhile
+        memcpy((void*)VIDEO_MEM_ADDR,(void*)term->video_buffer,FOUR_KB);
+        term->screen.video = (char*)VIDEO_MEM_ADDR;
+        term->screen.shown = 1;
+        update_cursor(term->screen.x, term->screen.y);
+        return;
+    }
+    terminal_paint_scrollback(term);
+}
 
-    // } else{
-    //     /* Switch Execution */
-    //     update_video_memory_paging(current_terminal);
-    //         printf("t08");
+/* void terminal_paint_scrollback(terminal_struct* term);
+ * draw a scrolled back terminal: the saved rows followed by its live screen,
+ * scroll_view rows up from the bottom
+ * 
+ * Inputs: term - the displayed terminal, scrolled back
+ * Return Value: none
+ * Side effects: the caller holds console_lock */
+static void terminal_paint_scrollback(terminal_struct* term){
+    scrollback_t* history = &term->scrollback;
+    int saved = (history->saved < SCROLLBACK_LINES) ? history->saved : SCROLLBACK_LINES;
+    uint16_t* video = (uint16_t*)VIDEO_MEM_ADDR;
+    uint16_t* live = (uint16_t*)term->video_buffer;
+    int row, k;
+
+    for(row = 0; row < NUM_ROWS; row++){
+        k = saved - term->scroll_view + row;        // row of the saved rows and live screen together
+        if(k < saved){
+            memcpy(video + row*NUM_COLS, history->rows[(history->saved - saved + k) & (SCROLLBACK_LINES - 1)], NUM_COLS << 1);
+        }
+        else{
+            memcpy(video + row*NUM_COLS, live + (k - saved)*NUM_COLS, NUM_COLS << 1);
+        }
+    }
+}
 
-    // }
+/* void terminal_puts(terminal_struct* term, int8_t* s);
+ * write a string on a terminal's screen
+ * 
+ * Inputs: term - terminal, s - string
+ * Return Value: none
+ * Side effects: the caller holds console_lock */
+static void terminal_puts(terminal_struct* term, int8_t* s){
+    while(*s != '\0'){
+        screen_putc(&term->screen, *s++);
+    }
 }
 
 /* void terminal_init();
@@ -128,123 +153,275 @@ extern void switch_terminal(int terminal_num){
 extern void terminal_init(){ 
     int i;
     int j;
-    for (i = 0; i < 3; i++){
+    for (i = 0; i < NUM_TERMINALS; i++){
         terminal_array[i].processing = 0; // set the terminal to its default setting
         terminal_array[i].pid = 0;
         terminal_array[i].parent_pid = -1;
         terminal_array[i].terminal_num = i;
-        terminal_array[i].cursor_x = 0;
-        terminal_array[i].cursor_y = 0;
         terminal_array[i].command_idx = 0;
         terminal_array[i].video_buffer = TERMINAL_VID_BUF_START + (i*FOUR_KB);
+        terminal_array[i].screen.video = (char*)terminal_array[i].video_buffer;
+        terminal_array[i].screen.shown = 0;
+        terminal_array[i].screen.history = &terminal_array[i].scrollback;
+        terminal_array[i].scrollback.saved = 0;
+        terminal_array[i].scroll_view = 0;
+        screen_clear(&terminal_array[i].screen);
+        terminal_array[i].cpu = -1;
+        terminal_array[i].rq_next = NULL;
+        terminal_array[i].rq_prev = NULL;
+        terminal_array[i].wait_next = NULL;
+        terminal_array[i].input_wait = (wait_queue_t)WAIT_QUEUE_INIT;
         terminal_array[i].curr_pcb_ptr = NULL;
         terminal_array[i].number_of_processes=0;
-        terminal_array[i].enter_flag = 0;
+        terminal_array[i].input_ready = 0;
+        terminal_array[i].input_head = 0;
+        terminal_array[i].input_tail = 0;
+        terminal_array[i].input_lines = 0;
+        terminal_array[i].mode = 0;
         for(j = 0; j < BUFFER_SIZE; j++){
             terminal_array[i].command[j] = '\0';
         }
     }
-    //let the current terminal be the 0th terminal (0-index)
+    //let the current terminal be the 0th terminal (0-index); it takes over the boot screen
     current_terminal = &terminal_array[0];
     terminal_array[0].processing = 1;
+    terminal_array[0].screen = *console;
+    terminal_array[0].screen.history = &terminal_array[0].scrollback;
+    console = &terminal_array[0].screen;
+}
+/* void terminal_store_char(terminal_struct* term, char c);
+ * Take a typed character: edit the line with it, or in raw mode store it
+ * for terminal_read, and echo it
+ * 
+ * Inputs: term - terminal it was typed on, c - typed character from keyboard
+ * Return Value: none
+ * Side effects: wakes the terminal's reader once input is ready. The caller
+ *               holds console_lock (keyboard handler) */
+
+void terminal_store_char(terminal_struct* term, char c){
+    int echo = !(term->mode & TERM_NOECHO);
+    int i, n;
+
+    terminal_scroll(term, -term->scroll_view);      // typing goes back to the live screen
+    if(term->mode & TERM_RAW){
+        if(!terminal_input_put(term, c)){
+            return;                                 // reader is behind: the key is lost
+        }
+        if(echo){
+            screen_putc(&term->screen, c);
+        }
+    }
+    else if(c=='\b'){                               // if backspace is typed
+        if(term->command_idx==0){                   // nothing to delete
+            return;
+        }
+        term->command_idx--;
+        n = (term->command[term->command_idx]=='\t') ? TAB_WIDTH : 1;
+        term->command[term->command_idx] = '\0';
+        for(i=0;echo && i<n;i++){
+            screen_putc(&term->screen, '\b');       // delete a character
+        }
+        return;
+    }
+    else if(c=='\n'){
+        // the line with its newline goes into input whole, or not at all
+        if(TERM_INPUT_SIZE - (term->input_tail - term->input_head) > term->command_idx){
+            for(i=0;i<term->command_idx;i++){
+                terminal_input_put(term, term->command[i]);
+            }
+            terminal_input_put(term, '\n');
+        }
+        term->command_idx = 0;                      // next line -> buffer starts over
+        if(echo){
+            screen_putc(&term->screen, '\n');       // print new line
+        }
+    }
+    else{
+        if(term->command_idx >= BUFFER_SIZE-1){     // only enter fits when buffer is full
+            return;
+        }
+        term->command[term->command_idx++] = c;     // store the typed character
+        if(echo){
+            screen_putc(&term->screen, c);
+        }
+        return;
+    }
+    terminal_input_update(term);
+}
+
+/* int32_t terminal_set_mode(terminal_struct* term, int mode);
+ * Switch a terminal between canonical and raw input and turn echo on or off
+ * 
+ * Inputs: term - terminal, mode - TERM_RAW and/or TERM_NOECHO, 0 for the default
+ * Return Value: 0, -1 for an unknown mode bit
+ * Side effects: going raw hands the line being edited to the reader as it is;
+ *               leaving raw mode drops what was typed and not read */
+int32_t terminal_set_mode(terminal_struct* term, int mode){
+    uint32_t flags;
+    int i;
+
+    if(mode & ~(TERM_RAW | TERM_NOECHO)){
+        return -1;
+    }
+    spin_lock_irqsave(&console_lock, flags);
+    if((mode & TERM_RAW) && !(term->mode & TERM_RAW)){
+        for(i=0;i<term->command_idx && terminal_input_put(term, term->command[i]);i++);
+        term->command_idx = 0;
+    } else if(!(mode & TERM_RAW) && (term->mode & TERM_RAW)){
+        // raw keys left unread ('\b', half a line) are not part of the next line
+        term->input_head = term->input_tail;
+        term->input_lines = 0;
+    }
+    term->mode = mode;
+    terminal_input_update(term);
+    spin_unlock_irqrestore(&console_lock, flags);
+    return 0;
 }
-// /* void terminal_store_char(char c);
-//  * Store the typed character into buffer and allow terminal_read when
-//  * enter is typed
-//  * 
-//  * Inputs: c - typed character from keyboard
-//  * Return Value: none
-//  * Side effects: changed the enter_stat and command and command_idx */
-
-// void terminal_store_char(char c){
-//     if(c=='\n'){
-//         if(command_idx >= BUFFER_SIZE){     // if buffer is full
-//             command[BUFFER_SIZE-1] = '\n';  // turn last character to \n
-//         }
-//         else{
-//             command[command_idx] = '\n';    // else store enter
-//         }
-//         enter_stat = 1;                     // if enter is typed, allow terminal_read
-//     }
-//     else if(c=='\b'){                       // if backspace is typed
-//         if(command_idx!=0){                 // if the buffer is not at start
-//             if(command[command_idx-1]=='\t'){
-//                 command[command_idx-1] = ' ';   // delete the last character (make it as space)
-//                 command_idx--; 
-//             }
-//             else{
-//                 command[command_idx-1] = ' ';   // delete the last character (make it as space)
-//                 command_idx--; 
-//             }
-//                              // decrement buffer index
-//         }
-//     }
-//     else if(command_idx < BUFFER_SIZE-1){   // otherwise, if the key is not special and buffer not full
-//         command[command_idx] = c;           // store the typed character
-//         command_idx++;                      // increment the buffer index
-//     }
-// }
 
 /* int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
- * Read nbytes of characters from buf
+ * Read typed input: one line in canonical mode, whatever was typed in raw mode
  * Inputs: fd-file descriptor, buf-buffer to store characters, nbytes-number of characters to read
- * Return Value: number of characters read
- * Side effects: read current command into buf, changed the enter_stat and command and command_idx */
+ * Return Value: number of characters read, 0 if none are ready and fd is O_NONBLOCK
+ * Side effects: waits for input unless fd is O_NONBLOCK. A line longer than
+ *               nbytes is cut short: its last byte read becomes a newline and
+ *               the rest of it is dropped */
 
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
-    int i;
-    if(buf==NULL)return -1;     // handle NULL buffer
+    terminal_struct* term = running_terminal();    // the reader's terminal, not necessarily the one on screen
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    char* out = (char*)buf;
+    uint32_t flags;
+    int32_t count = 0;
+    char c;
+    if(buf==NULL || nbytes<0)return -1;     // handle NULL buffer
+    if(nbytes==0)return 0;
+
+    spin_lock_irqsave(&console_lock, flags);
+    while(!term->input_ready){
+        spin_unlock_irqrestore(&console_lock, flags);
+        if(file != NULL && (file->flags & O_NONBLOCK)){
+            return 0;
+        }
+        sched_wait(&term->input_wait, &term->input_ready);     // sleep until there is input
+        spin_lock_irqsave(&console_lock, flags);
+    }
+
+    if(term->mode & TERM_RAW){
+        while(count<nbytes && term->input_head!=term->input_tail){
+            out[count++] = terminal_input_take(term);
+        }
+    }
+    else{
+        do{                                         // up to and including the newline
+            c = terminal_input_take(term);
+            if(count<nbytes){
+                out[count++] = c;
+            }
+        }while(c!='\n');
+        out[count-1] = '\n';                        // set last character to new line
+    }
+    terminal_input_update(term);
+    spin_unlock_irqrestore(&console_lock, flags);
+    return count;                                   // return total bytes read
+}
 
-    while(!current_terminal->enter_flag){}        // keep waiting for enter pressed
+/* int32_t terminal_poll(int32_t fd)
+ * What terminal_read would do now
+ * Inputs: fd-file descriptor
+ * Return Value: POLLIN once input is ready on the reader's terminal, else 0
+ * Side effects: none */
+int32_t terminal_poll(int32_t fd){
+    return running_terminal()->input_ready ? POLLIN : 0;
+}
 
-    cli();
-    for(i=0;i<current_terminal->command_idx;i++){ //read buffer from terminal 
-        command[i] = current_terminal->command[i];
+/* int32_t terminal_ioctl(int32_t fd, uint32_t request, uint32_t arg)
+ * Terminal requests of the ioctl system call
+ * Inputs: fd-file descriptor, request-IOCTL_TGETMODE or IOCTL_TSETMODE, arg-the new mode
+ * Return Value: the mode for IOCTL_TGETMODE, 0 for IOCTL_TSETMODE, -1 for a bad request or mode
+ * Side effects: the mode belongs to the caller's terminal, not to the descriptor */
+int32_t terminal_ioctl(int32_t fd, uint32_t request, uint32_t arg){
+    terminal_struct* term = running_terminal();
+
+    switch(request){
+        case IOCTL_TGETMODE:
+            return term->mode;
+        case IOCTL_TSETMODE:
+            return terminal_set_mode(term, (int)arg);
+        default:
+            return -1;
     }
-    command_idx = current_terminal->command_idx;
-    for(i=0;i<nbytes;i++){                      // read each characters
-        ((char*)buf)[i] = command[i];           // store each character into buf
-        command[i] = ' ';                       // clear the current command
-        if(((char*)buf)[i] == '\n'){            // when there's new line, end reading
-            current_terminal->enter_flag = 0;
-            current_terminal->command_idx = 0;
-            sti();
-            return i+1;                         // return total bytes read
-        }
-        if(i==nbytes-1 || i==BUFFER_SIZE-1){    // if read 128 or nbytes
-            ((char*)buf)[i] = '\n';             // set last character to new line 
-            current_terminal->enter_flag = 0;
-            current_terminal->command_idx = 0;
-            sti();
-            return i+1;                         // return total bytes read
-        }
+}
+
+/* int terminal_input_put(terminal_struct* term, char c);
+ * append a character to a terminal's input ring
+ * 
+ * Inputs: term - terminal, c - character
+ * Return Value: 1, 0 if the ring is full
+ * Side effects: the caller holds console_lock */
+static int terminal_input_put(terminal_struct* term, char c){
+    if(term->input_tail - term->input_head == TERM_INPUT_SIZE){
+        return 0;
+    }
+    term->input[term->input_tail++ & (TERM_INPUT_SIZE-1)] = c;
+    if(c=='\n'){
+        term->input_lines++;
+    }
+    return 1;
+}
+
+/* char terminal_input_take(terminal_struct* term);
+ * take the oldest character out of a terminal's input ring
+ * 
+ * Inputs: term - terminal, whose ring is not empty
+ * Return Value: the character
+ * Side effects: the caller holds console_lock */
+static char terminal_input_take(terminal_struct* term){
+    char c = term->input[term->input_head++ & (TERM_INPUT_SIZE-1)];
+    if(c=='\n'){
+        term->input_lines--;
+    }
+    return c;
+}
+
+/* void terminal_input_update(terminal_struct* term);
+ * set input_ready from what is in the ring and the mode
+ * 
+ * Inputs: term - terminal
+ * Return Value: none
+ * Side effects: wakes its reader (in terminal_read or poll) if input is ready.
+ *               The caller holds console_lock */
+static void terminal_input_update(terminal_struct* term){
+    if(term->mode & TERM_RAW){
+        term->input_ready = (term->input_head != term->input_tail);
+    }
+    else{
+        term->input_ready = (term->input_lines > 0);
+    }
+    if(term->input_ready){
+        sched_wake(&term->input_wait);              // its reader sleeps in terminal_read
+        poll_notify();                              // or in poll
     }
-    sti();
-    return 0;
 }
 
 /* int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes)
  * Write n characters from buf to screen
  * Inputs: fd-file descriptor, buf-buffer that stores characters, nbytes-number of characters to write
  * Return Value: Number of characters written to screen
- * Side effects: write to video memory */
-
+ * Side effects: write to the writer's terminal (video memory if it is displayed) */
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes){
-    cli();
+    terminal_struct* term = running_terminal();
+    uint32_t flags;
     int i;
     if(buf == NULL || nbytes<0){                        // fail if buf is NULL or nbytes<0
         return -1;
     }
+    spin_lock_irqsave(&console_lock, flags);
     for(i=0;i<nbytes;i++){                              // otherwise, look at each character
         if(((char*)buf)[i]!='\0'){                      // if it's a valid character
-            putc(((char*)buf)[i]);                      // write to video mem
-            // if(((char*)buf)[i]=='\n')return i+1;        // if it's new line, end writing
+            screen_putc(&term->screen, ((char*)buf)[i]);     // write to its screen
         }
-        // else{
-        //     return i+1;                                 // if there's invalid character, end writing
-        // }
     }
-    sti();
+    spin_unlock_irqrestore(&console_lock, flags);
     return nbytes;                                      // return total bytes read
 }
 
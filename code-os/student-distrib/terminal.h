@@ -11,27 +11,66 @@
 #define FOUR_KB 4096
 
 #define BUFFER_SIZE 128             // buffer limit
-
-/* terminal struct  */
-typedef struct{
+#define NUM_TERMINALS 3
+#define TERM_INPUT_SIZE 256         // input ring, a power of 2
+
+/* terminal modes (ioctl IOCTL_TSETMODE). In the default canonical mode a key
+ * edits the line in command and enter moves the whole line into the input
+ * ring, so read returns a line at a time. In raw mode every key goes into the
+ * ring as it is typed ('\b' and '\n' included) and read returns whatever is
+ * there. Ctrl+C, Ctrl+L and Alt+Fn keep their meaning in both. */
+#define TERM_RAW        0x1         // no line editing
+#define TERM_NOECHO     0x2         // typed keys are not shown
+
+/* terminal struct. Each terminal is also one scheduler task (sched.c): its
+ * process chain runs on one kernel stack at a time, newest process on top */
+typedef struct terminal_struct {
     uint32_t pid;                   // current process id
     uint32_t parent_pid;            // current process's parent id
     int processing;                 
     int terminal_num;
-    int cursor_x;
-    int cursor_y;
-    char command[BUFFER_SIZE];
+    screen_t screen;                // where its output goes (video memory while displayed)
+    scrollback_t scrollback;        // rows its screen scrolled off
+    int scroll_view;                // rows the monitor is scrolled back by, 0 for the live screen
+    char command[BUFFER_SIZE];      // line being edited (canonical mode)
     int command_idx;
+    char input[TERM_INPUT_SIZE];    // typed and not read yet, a ring
+    uint32_t input_head;            // next to read; head and tail count up forever
+    uint32_t input_tail;            // next to store
+    int input_lines;                // newlines in input
+    int mode;                       // TERM_RAW, TERM_NOECHO
     int video_buffer;
     int number_of_processes;        // variable to track number of processes on terminal
-    volatile int enter_flag;
+    volatile int input_ready;       // read would not wait: a line is in input (any key in raw mode)
     pcb_struct* curr_pcb_ptr;
+
+    /* scheduler state, owned by sched.c */
+    int cpu;                        // run queue the task belongs to, -1 until it is started
+    uint32_t sched_esp;             // kernel stack pointer saved by context_switch
+    uint32_t sched_pid;             // pid that was running when it was switched out
+    volatile int on_cpu;            // 1 until its context is saved; not stealable before that
+    uint32_t last_ran;              // pit_ticks when it was last switched out (cache affinity)
+    int state;                      // TASK_RUNNABLE or TASK_BLOCKED
+    int level;                      // MLFQ level, 0 is the highest priority
+    int slice;                      // ticks left at this level before it is demoted
+    int sleep_locks;                // sleep locks it holds (sleep_lock, sleep_unlock)
+    struct terminal_struct* rq_next;    // run queue links
+    struct terminal_struct* rq_prev;
+    struct terminal_struct* wait_next;  // wait queue link while blocked
+    wait_queue_t input_wait;        // its reader, until input_ready
 } terminal_struct;
 
 /////////////////////////////////////////////////////////////////////////////////
-extern void update_video_memory_paging(terminal_struct* next_term);
-terminal_struct terminal_array[3];  // construct a terminal array that is use for multiplay terminal 
-terminal_struct* current_terminal;
+terminal_struct terminal_array[NUM_TERMINALS];  // construct a terminal array that is use for multiplay terminal 
+terminal_struct* current_terminal;              // the terminal on the monitor (gets the keyboard)
+
+/* terminal_struct* running_terminal();
+ * terminal whose process is running on this CPU
+ * 
+ * Inputs: NONE
+ * Return Value: the terminal (the displayed one until the scheduler starts a task)
+ * Side effects: none */
+extern terminal_struct* running_terminal();
 
 
 
@@ -40,10 +79,21 @@ terminal_struct* current_terminal;
  * 
  * Inputs: terminal_num 
  * Return Value: none
- * Side effects: switch to the other terminal */
+ * Side effects: switch to the other terminal, starting its shell the first time.
+ *               Called with console_lock held (keyboard handler) */
 
 extern void switch_terminal(int terminal_num);  
 
+/* void terminal_scroll(terminal_struct* term, int lines);
+ * Scroll the displayed terminal back into its scrollback or forward again
+ * 
+ * Inputs: term - the displayed terminal, lines - rows back (> 0) or forward (< 0)
+ * Return Value: none
+ * Side effects: While scrolled back, video memory shows the saved rows and the
+ *               terminal's output goes to its backing page, as if it were not
+ *               displayed. Called with console_lock held (keyboard handler) */
+extern void terminal_scroll(terminal_struct* term, int lines);
+
 /* void terminal_init();
  * init terminal with default settings
  * 
@@ -53,23 +103,47 @@ extern void switch_terminal(int terminal_num);
 
 extern void terminal_init();  
 
-/* void terminal_char(char c);
- * Store the typed character into buffer and allow terminal_read when
- * enter is typed
+/* void terminal_store_char(terminal_struct* term, char c);
+ * Take a typed character: edit the line with it, or in raw mode store it
+ * for terminal_read, and echo it
  * 
- * Inputs: c - typed character from keyboard
+ * Inputs: term - terminal it was typed on, c - typed character from keyboard
  * Return Value: none
- * Side effects: changed the enter_stat and command and command_idx */
+ * Side effects: wakes the terminal's reader once input is ready. The caller
+ *               holds console_lock (keyboard handler) */
+
+extern void terminal_store_char(terminal_struct* term, char c);                     // handle typed character
 
-extern void terminal_store_char(char c);                                              // handle typed character
+/* int32_t terminal_set_mode(terminal_struct* term, int mode);
+ * Switch a terminal between canonical and raw input and turn echo on or off
+ * 
+ * Inputs: term - terminal, mode - TERM_RAW and/or TERM_NOECHO, 0 for the default
+ * Return Value: 0, -1 for an unknown mode bit
+ * Side effects: going raw hands the line being edited to the reader as it is;
+ *               leaving raw mode drops what was typed and not read */
+extern int32_t terminal_set_mode(terminal_struct* term, int mode);
 
 /* int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
- * ////////////////////////////////////////////////////////////////////////////////////////////////////////////
- * Inputs: c - typed character from keyboard
- * Return Value: none
- * Side effects: changed the enter_stat and command and command_idx */
+ * Read typed input: one line in canonical mode, whatever was typed in raw mode
+ * Inputs: fd-file descriptor, buf-buffer to store characters, nbytes-number of characters to read
+ * Return Value: number of characters read, 0 if none are ready and fd is O_NONBLOCK
+ * Side effects: waits for input unless fd is O_NONBLOCK */
 extern int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);            // terminal read
 
+/* int32_t terminal_poll(int32_t fd)
+ * What terminal_read would do now
+ * Inputs: fd-file descriptor
+ * Return Value: POLLIN once input is ready on the reader's terminal, else 0
+ * Side effects: none */
+extern int32_t terminal_poll(int32_t fd);
+
+/* int32_t terminal_ioctl(int32_t fd, uint32_t request, uint32_t arg)
+ * Terminal requests of the ioctl system call
+ * Inputs: fd-file descriptor, request-IOCTL_TGETMODE or IOCTL_TSETMODE, arg-the new mode
+ * Return Value: the mode for IOCTL_TGETMODE, 0 for IOCTL_TSETMODE, -1 for a bad request or mode
+ * Side effects: the mode belongs to the caller's terminal, not to the descriptor */
+extern int32_t terminal_ioctl(int32_t fd, uint32_t request, uint32_t arg);
+
 
 /* int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes)
  * ////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -10,6 +10,12 @@
 #include "paging.h"
 #include "idt.h"
 #include "file_system.h"
+#include "timer.h"
+#include "signal.h"
+#include "fd.h"
+#include "ata.h"
+#include "bcache.h"
+#include "io_ring.h"
 
 
 #define PASS 1
@@ -640,6 +646,504 @@ int test_rtc_freq() {
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
+/* Library tests */
+
+#define MEM_TEST_SIZE	5000		// larger than SSE_COPY_THRESHOLD so both paths run
+#define MEM_TEST_GUARD	64			// slack for destination offsets and guard bytes
+#define MEM_TEST_BYTE(i)	((uint8_t)((i) * 7 + 1))
+
+static uint8_t mem_test_src[MEM_TEST_SIZE + MEM_TEST_GUARD];
+static uint8_t mem_test_dst[MEM_TEST_SIZE + MEM_TEST_GUARD];
+
+/* lib_memory_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: memcpy, memset, memmove on both the rep movs and SSE2 paths,
+ *           misaligned heads and tails, forward and backward overlap
+ * Files: lib.h/c
+ */
+int lib_memory_test(){
+	TEST_HEADER;
+	uint32_t sizes[] = {0, 1, 3, 63, 64, 2047, 2048, 2049, 4096, MEM_TEST_SIZE};
+	uint32_t s, n, off, i;
+	int result = PASS;
+
+	for (i = 0; i < MEM_TEST_SIZE + MEM_TEST_GUARD; i++)
+		mem_test_src[i] = MEM_TEST_BYTE(i);
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		n = sizes[s];
+		for (off = 0; off < 4; off++) {
+			// memcpy from a misaligned source to a misaligned destination
+			memset(mem_test_dst, 0, sizeof(mem_test_dst));
+			memcpy(mem_test_dst + off, mem_test_src + 1, n);
+			for (i = 0; i < n; i++)
+				if (mem_test_dst[off + i] != MEM_TEST_BYTE(i + 1)) result = FAIL;
+			if (mem_test_dst[off + n] != 0) result = FAIL;
+
+			// memset must stop exactly at n
+			memset(mem_test_dst + off, 0xAB, n);
+			for (i = 0; i < n; i++)
+				if (mem_test_dst[off + i] != 0xAB) result = FAIL;
+			if (mem_test_dst[off + n] != 0) result = FAIL;
+
+			// memmove with dest above src (copied back to front)
+			memcpy(mem_test_dst, mem_test_src, n + off + 1);
+			memmove(mem_test_dst + off + 1, mem_test_dst, n);
+			for (i = 0; i < n; i++)
+				if (mem_test_dst[off + 1 + i] != MEM_TEST_BYTE(i)) result = FAIL;
+
+			// memmove with dest below src (copied front to back)
+			memcpy(mem_test_dst, mem_test_src, n + off + 1);
+			memmove(mem_test_dst, mem_test_dst + off + 1, n);
+			for (i = 0; i < n; i++)
+				if (mem_test_dst[i] != MEM_TEST_BYTE(off + 1 + i)) result = FAIL;
+		}
+	}
+
+	return result;
+}
+
+/* lib_snprintf_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: snprintf conversions, field widths and truncation
+ * Files: lib.h/c
+ */
+int lib_snprintf_test(){
+	TEST_HEADER;
+	int8_t buf[64];
+	int result = PASS;
+
+	snprintf(buf, sizeof(buf), "%d %u %x %#x %s %c%%", -12, 7, 255, 0xAB, "hi", 'z');
+	if (strncmp(buf, "-12 7 FF 000000AB hi z%", sizeof(buf)) != 0) result = FAIL;
+
+	snprintf(buf, sizeof(buf), "[%5u][%-6s]", 42, "ab");
+	if (strncmp(buf, "[   42][ab    ]", sizeof(buf)) != 0) result = FAIL;
+
+	// output is cut at size - 1 characters and always terminated
+	if (snprintf(buf, 5, "hello world") != 4) result = FAIL;
+	if (strncmp(buf, "hell", sizeof(buf)) != 0) result = FAIL;
+
+	return result;
+}
+
+
+/* timer_test_count
+ * Callback of timer_wheel_test: counts how often a timer fired */
+static void timer_test_count(ktimer_t* timer){
+	(*(int*)timer->data)++;
+}
+
+/* timer_wheel_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: Waits a few timer ticks (interrupts must be on)
+ * Coverage: timer_add/timer_cancel, expiry, timers a full wheel turn away
+ *           sharing a slot with due ones
+ * Files: timer.h/c
+ */
+int timer_wheel_test(){
+	TEST_HEADER;
+	ktimer_t soon, cancelled, far;
+	int soon_count = 0, cancelled_count = 0, far_count = 0;
+	uint32_t start = pit_ticks;
+	int result = PASS;
+
+	soon.func = cancelled.func = far.func = timer_test_count;
+	soon.data = &soon_count;
+	cancelled.data = &cancelled_count;
+	far.data = &far_count;
+	timer_add(&soon, start + 1);
+	timer_add(&cancelled, start + 2);
+	timer_add(&far, start + 1 + TIMER_WHEEL_SIZE);	// same slot as soon
+
+	if (timer_cancel(&cancelled) != 1) result = FAIL;
+	while (pit_ticks - start < 3);
+
+	if (soon_count != 1 || soon.pending) result = FAIL;
+	if (cancelled_count != 0 || timer_cancel(&cancelled) != 0) result = FAIL;
+	if (far_count != 0 || timer_cancel(&far) != 1) result = FAIL;
+
+	return result;
+}
+
+/* signal_frame_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: handler frame layout ece391sigtest relies on (eax at &signum + 7),
+ *           signal_send/signal_reset on a pending mask
+ * Files: signal.h/c
+ */
+int signal_frame_test(){
+	TEST_HEADER;
+	static pcb_struct pcb;
+	sig_context_t ctx;
+	int result = PASS;
+
+	if (sizeof(sig_context_t) != 17 * sizeof(uint32_t)) result = FAIL;
+	if ((uint32_t*)&ctx.eax - (uint32_t*)&ctx != 6) result = FAIL;
+	if ((uint32_t*)&ctx.eip - (uint32_t*)&ctx != 12) result = FAIL;
+
+	signal_reset(&pcb);
+	signal_send(&pcb, SIG_ALARM);
+	signal_send(&pcb, SIG_USER1);
+	signal_send(&pcb, NUM_SIGNALS);		// out of range, dropped
+	if (pcb.sig_pending != ((1 << SIG_ALARM) | (1 << SIG_USER1))) result = FAIL;
+	signal_reset(&pcb);
+	if (pcb.sig_pending != 0 || pcb.sig_masked) result = FAIL;
+
+	return result;
+}
+
+/* fd_test_close
+ * Driver close of the files fd_table_test opens: counts the calls */
+static int fd_test_closes;
+static int32_t fd_test_close(int32_t fd){
+	fd_test_closes++;
+	return 0;
+}
+
+/* fd_table_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: lowest-free allocation, the per-process limit, descriptors past
+ *           the PCB's own entries and their chunks going back to the pool,
+ *           shared open files closing with their last descriptor
+ * Files: fd.h/c
+ */
+int fd_table_test(){
+	TEST_HEADER;
+	static pcb_struct pcb;
+	static fileop_table_t ops;
+	file_array_struct* file;
+	int32_t fd;
+	int result = PASS;
+
+	ops.close = fd_test_close;
+	fd_test_closes = 0;
+	fd_init(&pcb, NUM_FILE_DES);
+	for (fd = 0; fd < NUM_FILE_DES; fd++) {
+		if (fd_install(&pcb, -1, file_alloc(&ops, 0)) != fd) result = FAIL;
+	}
+	file = file_alloc(&ops, 0);
+	if (fd_install(&pcb, -1, file) != -1) result = FAIL;		// at the limit
+	file_put(file);
+	fd_close(&pcb, 4);
+	if (fd_get(&pcb, 4) != NULL || fd_test_closes != 1) result = FAIL;
+
+	// two descriptors to one file: the driver's close waits for the second
+	file = fd_get(&pcb, 3);
+	file_get(file);
+	if (fd_install(&pcb, -1, file) != 4) result = FAIL;		// lowest free first
+	fd_close(&pcb, 3);
+	if (fd_test_closes != 1 || file->refcount != 1) result = FAIL;
+	fd_close(&pcb, 4);
+	if (fd_test_closes != 2 || file->refcount != 0) result = FAIL;
+
+	if (fd_set_limit(&pcb, FD_MAX) != NUM_FILE_DES) result = FAIL;
+	for (fd = NUM_FILE_DES; fd < FD_MAX; fd++) {
+		if (fd_install(&pcb, fd, file_alloc(&ops, 0)) != fd || fd_get(&pcb, fd) == NULL) result = FAIL;
+	}
+	if (fd_set_limit(&pcb, NUM_FILE_DES) != -1) result = FAIL;	// fds above it are open
+	for (fd = 0; fd < FD_MAX; fd++) {
+		fd_close(&pcb, fd);
+	}
+	if (fd_next_open(&pcb, 0) != -1) result = FAIL;
+	for (fd = 0; fd < FD_CHUNKS_PER_PROC; fd++) {
+		if (pcb.fd_chunk[fd] != NULL) result = FAIL;
+	}
+
+	return result;
+}
+
+/* file_stat_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: length and block count from the index node for a regular file,
+ *           zero for a directory, bad inode numbers
+ * Files: file_system.h/c
+ */
+int file_stat_test(){
+	TEST_HEADER;
+	dentry_t dentry;
+	stat_t st;
+	uint32_t length;
+	int result = PASS;
+
+	if (read_dentry_by_name((uint8_t*)"frame0.txt", &dentry) == -1) return FAIL;
+	length = index_nodes_ptr[dentry.inode_number].file_length;
+	if (file_stat(dentry.file_type, dentry.inode_number, &st) != 0) result = FAIL;
+	if (st.file_type != REGULAR_FILE_TYPE || st.inode_number != dentry.inode_number) result = FAIL;
+	if (st.file_length != length) result = FAIL;
+	if (st.block_count != (length + FILE_SYSTEM_BLOCK_SIZE - 1) / FILE_SYSTEM_BLOCK_SIZE) result = FAIL;
+
+	if (read_dentry_by_name((uint8_t*)".", &dentry) == -1) return FAIL;
+	if (file_stat(dentry.file_type, dentry.inode_number, &st) != 0) result = FAIL;
+	if (st.file_type != DIRECTORY_FILE_TYPE || st.file_length != 0 || st.block_count != 0) result = FAIL;
+
+	if (file_stat(REGULAR_FILE_TYPE, boot_block_ptr->inode_count, &st) != -1) result = FAIL;
+
+	return result;
+}
+
+/* fs_write_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: Creates and removes the file "fs_write_test"
+ * Coverage: create, writing across a block boundary and past the end,
+ *           truncate zeroing what it cuts off, unlink freeing the name
+ * Files: file_system.h/c
+ */
+int fs_write_test(){
+	TEST_HEADER;
+	static uint8_t buf[FILE_SYSTEM_BLOCK_SIZE + 16];
+	dentry_t dentry;
+	int32_t inode;
+	int i, result = PASS;
+
+	fs_lookup_lock();
+	inode = file_create((uint8_t*)"fs_write_test");
+	fs_lookup_unlock();
+	if (inode == -1) return FAIL;
+	if (read_dentry_by_name((uint8_t*)"fs_write_test", &dentry) == -1 || dentry.inode_number != inode) result = FAIL;
+
+	for (i = 0; i < 16; i++) buf[i] = 'a' + i;
+	if (write_data(inode, FILE_SYSTEM_BLOCK_SIZE - 8, buf, 16) != 16) result = FAIL;	// straddles two blocks
+	if (index_nodes_ptr[inode].file_length != FILE_SYSTEM_BLOCK_SIZE + 8) result = FAIL;
+	if (read_data(inode, 0, buf, sizeof(buf)) != FILE_SYSTEM_BLOCK_SIZE + 8) result = FAIL;
+	for (i = 0; i < FILE_SYSTEM_BLOCK_SIZE - 8; i++) {
+		if (buf[i] != 0) result = FAIL;			// the gap reads as zeros
+	}
+	if (buf[FILE_SYSTEM_BLOCK_SIZE - 8] != 'a' || buf[FILE_SYSTEM_BLOCK_SIZE + 7] != 'p') result = FAIL;
+
+	if (file_truncate(inode, FILE_SYSTEM_BLOCK_SIZE - 4) != 0) result = FAIL;
+	if (file_truncate(inode, FILE_SYSTEM_BLOCK_SIZE + 8) != 0) result = FAIL;
+	if (read_data(inode, FILE_SYSTEM_BLOCK_SIZE - 8, buf, 16) != 16) result = FAIL;
+	if (buf[3] != 'd' || buf[4] != 0 || buf[15] != 0) result = FAIL;
+
+	if (file_unlink((uint8_t*)"fs_write_test") != 0) result = FAIL;
+	if (read_dentry_by_name((uint8_t*)"fs_write_test", &dentry) != -1) result = FAIL;
+	if (file_unlink((uint8_t*)".") != -1) result = FAIL;			// not a regular file
+
+	return result;
+}
+
+/* fs_create_unlink_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: Creates and removes the file "fs_create_test"
+ * Coverage: create and unlink taking turns on one name: a second create
+ *           empties and reuses the file, unlink is refused while it is open
+ *           and frees the name once closed, so the next create starts over
+ * Files: file_system.h/c, fd.h/c
+ */
+int fs_create_unlink_test(){
+	TEST_HEADER;
+	static uint8_t data[] = "create";
+	file_array_struct* file;
+	dentry_t dentry;
+	int32_t inode;
+	int result = PASS;
+
+	// what create does: file_create and the open under one hold of the lock
+	fs_lookup_lock();
+	inode = file_create((uint8_t*)"fs_create_test");
+	file = (inode == -1) ? NULL : file_alloc(&file_fileop_table, inode);
+	fs_lookup_unlock();
+	if (file == NULL) return FAIL;
+	if (write_data(inode, 0, data, sizeof(data)) != sizeof(data)) result = FAIL;
+
+	if (file_unlink((uint8_t*)"fs_create_test") != -1) result = FAIL;	// still open
+	fs_lookup_lock();
+	if (file_create((uint8_t*)"fs_create_test") != inode) result = FAIL;	// the name is there: reuse it
+	fs_lookup_unlock();
+	if (index_nodes_ptr[inode].file_length != 0) result = FAIL;
+	fs_lookup_lock();
+	if (file_create((uint8_t*)".") != -1) result = FAIL;			// not a regular file
+	fs_lookup_unlock();
+
+	file_put(file);
+	if (file_unlink((uint8_t*)"fs_create_test") != 0) result = FAIL;
+	if (read_dentry_by_name((uint8_t*)"fs_create_test", &dentry) != -1) result = FAIL;
+	fs_lookup_lock();
+	inode = file_create((uint8_t*)"fs_create_test");
+	fs_lookup_unlock();
+	if (inode == -1 || index_nodes_ptr[inode].file_length != 0) result = FAIL;
+	if (file_unlink((uint8_t*)"fs_create_test") != 0) result = FAIL;
+
+	return result;
+}
+
+/* bcache_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: Reads the first two blocks of the first disk (the boot disk) into the cache
+ * Coverage: a second read of a block is a hit with the same data, readahead fills the cache
+ * Files: bcache.h/c, ata.h/c
+ */
+int bcache_test(){
+	TEST_HEADER;
+	static uint8_t block[BCACHE_BLOCK_SIZE];
+	uint8_t part[16];
+	uint32_t next = 1;
+	uint32_t drive, hits;
+	int i, result = PASS;
+
+	drive = (ata_sectors(ATA_MASTER) != 0) ? ATA_MASTER : ATA_SLAVE;
+	if (ata_sectors(drive) < 2 * BCACHE_BLOCK_SIZE / ATA_SECTOR_SIZE) return FAIL;	// no disk
+
+	if (bcache_read(drive, 0, 0, block, BCACHE_BLOCK_SIZE) == -1) return FAIL;	// hit or miss
+	hits = bcache_stats.hits;
+	if (bcache_read(drive, 0, 16, part, sizeof(part)) != 0) result = FAIL;
+	if (bcache_stats.hits != hits + 1) result = FAIL;
+	for (i = 0; i < sizeof(part); i++) {
+		if (part[i] != block[16 + i]) result = FAIL;
+	}
+
+	bcache_readahead(drive, &next, 1);
+	if (bcache_read(drive, next, 0, part, sizeof(part)) != 0) result = FAIL;
+
+	return result;
+}
+
+/* io_ring_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: requests complete in order with their user_data, an unknown op
+ *           fails on its own, a full completion ring stops submission,
+ *           inconsistent counters are refused
+ * Files: io_ring.h/c
+ */
+int io_ring_test(){
+	TEST_HEADER;
+	static io_ring_t ring;
+	int i, result = PASS;
+
+	// NOPs and bad ops need no process (the others go through its descriptors)
+	for (i = 0; i < 3; i++) {
+		ring.sq[i].op = (i == 1) ? 99 : IO_OP_NOP;
+		ring.sq[i].user_data = 100 + i;
+	}
+	ring.sq_tail = 3;
+	if (io_ring_enter(&ring, 2) != 2 || ring.sq_head != 2) result = FAIL;
+	if (io_ring_enter(&ring, 8) != 1 || ring.cq_tail != 3) result = FAIL;
+	if (ring.cq[0].user_data != 100 || ring.cq[0].result != 0) result = FAIL;
+	if (ring.cq[1].user_data != 101 || ring.cq[1].result != -1) result = FAIL;
+
+	// the completion ring has room for IO_RING_ENTRIES - 3 more
+	for (i = 0; i < IO_RING_ENTRIES; i++) {
+		ring.sq[(ring.sq_tail + i) % IO_RING_ENTRIES].op = IO_OP_NOP;
+	}
+	ring.sq_tail += IO_RING_ENTRIES - 2;
+	if (io_ring_enter(&ring, IO_RING_ENTRIES) != IO_RING_ENTRIES - 3) result = FAIL;
+	ring.cq_head = ring.cq_tail;
+	if (io_ring_enter(&ring, IO_RING_ENTRIES) != 1) result = FAIL;
+
+	ring.sq_tail = ring.sq_head + IO_RING_ENTRIES + 1;
+	if (io_ring_enter(&ring, 1) != -1) result = FAIL;
+
+	return result;
+}
+
+/* terminal_input_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: canonical mode edits the line and hands it over at enter, going
+ *           raw hands the partial line over, raw mode stores every key, a full
+ *           ring drops keys, leaving raw mode drops what was not read
+ * Files: terminal.h/c
+ */
+int terminal_input_test(){
+	TEST_HEADER;
+	static terminal_struct term;	// not echoed, so it needs no screen
+	int i, result = PASS;
+
+	term.input_wait = (wait_queue_t)WAIT_QUEUE_INIT;
+	term.mode = TERM_NOECHO;
+	terminal_store_char(&term, 'a');
+	terminal_store_char(&term, 'x');
+	terminal_store_char(&term, '\b');
+	if (term.input_ready || term.command_idx != 1) result = FAIL;
+	terminal_store_char(&term, '\n');
+	if (!term.input_ready || term.input_lines != 1 || term.input_tail != 2) result = FAIL;
+	if (term.input[0] != 'a' || term.input[1] != '\n') result = FAIL;
+
+	term.input_head = term.input_tail;
+	term.input_lines = 0;
+	terminal_store_char(&term, 'b');
+	if (terminal_set_mode(&term, TERM_RAW | TERM_NOECHO | 0x100) != -1) result = FAIL;
+	if (terminal_set_mode(&term, TERM_RAW | TERM_NOECHO) != 0) result = FAIL;
+	if (!term.input_ready || term.command_idx != 0 || term.input_tail != 3) result = FAIL;
+	terminal_store_char(&term, '\b');
+	if (term.input[3] != '\b') result = FAIL;
+
+	for (i = 0; i < TERM_INPUT_SIZE; i++) {
+		terminal_store_char(&term, 'c');
+	}
+	if (term.input_tail - term.input_head != TERM_INPUT_SIZE) result = FAIL;
+
+	if (terminal_set_mode(&term, TERM_NOECHO) != 0) result = FAIL;
+	if (term.input_ready || term.input_head != term.input_tail) result = FAIL;
+
+	return result;
+}
+
+/* scrollback_test
+ * 
+ * Inputs: NONE
+ * Outputs: PASS/FAIL
+ * Side Effects: none
+ * Coverage: rows that scroll off a screen land in its scrollback, oldest
+ *           first, character and attribute; a screen without one still scrolls
+ * Files: lib.h/c
+ */
+int scrollback_test(){
+	TEST_HEADER;
+	static char page[NUM_ROWS * NUM_COLS * 2];
+	static scrollback_t history;
+	screen_t screen = { page, 0, 0, 0, &history };
+	int8_t line[4];
+	int i, j, result = PASS;
+
+	// row i shows i until the screen fills; 5 more lines scroll 6 rows off
+	for (i = 0; i < NUM_ROWS + 5; i++) {
+		snprintf(line, sizeof(line), "%d", i);
+		for (j = 0; line[j] != '\0'; j++) {
+			screen_putc(&screen, line[j]);
+		}
+		screen_putc(&screen, '\n');
+	}
+	if (history.saved != 6) result = FAIL;
+	if ((history.rows[0][0] & 0xFF) != '0' || (history.rows[5][0] & 0xFF) != '5') result = FAIL;
+	if ((history.rows[5][0] >> 8) == 0) result = FAIL;	// the attribute comes along
+	if (screen.y != NUM_ROWS - 1 || page[0] != '6') result = FAIL;
+
+	screen.history = NULL;
+	screen_putc(&screen, '\n');
+	if (history.saved != 6 || page[0] != '7') result = FAIL;
+
+	return result;
+}
+
 
 /* Test suite entry point */
 void launch_tests(){
@@ -691,6 +1195,22 @@ void launch_tests(){
 	//TEST_OUTPUT("Terminal_test", test_terminal_read_write());
 	//-------------------------TERMINAL TESTS----------------------------//
 
+	//-------------------------LIBRARY TESTS----------------------------//
+	// TEST_OUTPUT("lib_memory_test", lib_memory_test());
+	// TEST_OUTPUT("lib_snprintf_test", lib_snprintf_test());
+	//-------------------------LIBRARY TESTS----------------------------//
+
+	// TEST_OUTPUT("timer_wheel_test", timer_wheel_test());
+	// TEST_OUTPUT("signal_frame_test", signal_frame_test());
+	// TEST_OUTPUT("fd_table_test", fd_table_test());
+	// TEST_OUTPUT("file_stat_test", file_stat_test());
+	// TEST_OUTPUT("fs_write_test", fs_write_test());
+	// TEST_OUTPUT("fs_create_unlink_test", fs_create_unlink_test());
+	// TEST_OUTPUT("bcache_test", bcache_test());
+	// TEST_OUTPUT("io_ring_test", io_ring_test());
+	// TEST_OUTPUT("terminal_input_test", terminal_input_test());
+	// TEST_OUTPUT("scrollback_test", scrollback_test());
+
 	
 
 
@@ -0,0 +1,278 @@
+/* timer.c - Kernel timers on a hashed timing wheel
+ * vim:ts=4 noexpandtab
+ */
+
+#include "timer.h"
+#include "lib.h"
+#include "smp.h"
+#include "sched.h"
+
+#define TIMER_SLOT(ticks)       ((ticks) & (TIMER_WHEEL_SIZE - 1))
+
+static ktimer_t* wheel[TIMER_WHEEL_SIZE];
+static uint32_t wheel_now;                  // last tick timer_run went through
+static ktimer_t* undated;                   // armed by timer_add_after while the boot processor's tick was stopped
+static spinlock_t timer_lock = SPINLOCK_INIT;
+
+/* a task in timer_sleep, on its stack */
+typedef struct {
+    volatile int done;
+    wait_queue_t wq;
+} timer_sleeper_t;
+
+static void timer_link(ktimer_t* timer, uint32_t expires);
+static void timer_unlink(ktimer_t* timer);
+static void timer_wake_sleeper(ktimer_t* timer);
+
+/*
+ * timer_add
+ *   DESCRIPTION: Arm a timer
+ *   INPUTS: timer - func and data filled in, not pending
+ *           expires - pit_ticks value to fire at (the next tick if already past)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wakes a tickless boot processor so it can shorten its sleep
+ */
+void timer_add(ktimer_t* timer, uint32_t expires){
+    uint32_t flags;
+
+    spin_lock_irqsave(&timer_lock, flags);
+    timer_link(timer, expires);
+    spin_unlock(&timer_lock);
+
+    // the wheel turns on the boot processor's tick, which may be stopped until after this one
+    if(cpus[0].idle_ticks && this_cpu() != &cpus[0]){
+        smp_wakeup(&cpus[0]);
+    }
+    restore_flags(flags);
+}
+
+/*
+ * timer_add_after
+ *   DESCRIPTION: Arm a timer to fire a number of ticks from now
+ *   INPUTS: timer - func and data filled in, not pending
+ *           ticks - how far away (at least the next tick)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wakes a tickless boot processor, which dates the timer from
+ *                 pit_ticks once it has caught up on the ticks it skipped
+ */
+void timer_add_after(ktimer_t* timer, uint32_t ticks){
+    uint32_t flags;
+
+    spin_lock_irqsave(&timer_lock, flags);
+    // timer_resume clears idle_ticks under this lock, after it caught pit_ticks up
+    if(!cpus[0].idle_ticks){
+        timer_link(timer, pit_ticks + ticks);
+        spin_unlock_irqrestore(&timer_lock, flags);
+        return;
+    }
+    timer->expires = ticks;
+    timer->prev = NULL;
+    timer->next = undated;
+    if(undated != NULL){
+        undated->prev = timer;
+    }
+    undated = timer;
+    timer->pending = TIMER_UNDATED;
+    spin_unlock(&timer_lock);
+
+    if(this_cpu() != &cpus[0]){
+        smp_wakeup(&cpus[0]);
+    }
+    restore_flags(flags);
+}
+
+/*
+ * timer_resume
+ *   DESCRIPTION: End a tickless idle period of the boot processor
+ *   INPUTS: skipped - ticks that passed without an interrupt
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Adds them to pit_ticks, clears its idle_ticks and puts the
+ *                 timers armed meanwhile in the wheel, all under the wheel lock
+ */
+void timer_resume(uint32_t skipped){
+    ktimer_t* timer;
+    uint32_t flags;
+
+    spin_lock_irqsave(&timer_lock, flags);
+    pit_ticks += skipped;
+    cpus[0].idle_ticks = 0;
+    while(undated != NULL){
+        timer = undated;
+        undated = timer->next;
+        timer_link(timer, pit_ticks + timer->expires);
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/*
+ * timer_cancel
+ *   DESCRIPTION: Disarm a timer
+ *   INPUTS: timer - the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it was still pending, 0 if it fired (its callback may
+ *                 still be running on the boot processor) or was never armed
+ *   SIDE EFFECTS: none
+ */
+int32_t timer_cancel(ktimer_t* timer){
+    int32_t was_pending;
+    uint32_t flags;
+
+    spin_lock_irqsave(&timer_lock, flags);
+    was_pending = (timer->pending != 0);
+    if(was_pending){
+        timer_unlink(timer);
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return was_pending;
+}
+
+/*
+ * timer_run
+ *   DESCRIPTION: Fire every timer due up to now (boot processor tick only)
+ *   INPUTS: now - current pit_ticks
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Catches up on ticks a tickless idle period skipped; calls
+ *                 the callbacks
+ */
+void timer_run(uint32_t now){
+    ktimer_t* due = NULL;
+    ktimer_t* timer;
+    ktimer_t* next;
+
+    spin_lock(&timer_lock);
+    while(wheel_now != now){
+        wheel_now++;
+        for(timer = wheel[TIMER_SLOT(wheel_now)]; timer != NULL; timer = next){
+            next = timer->next;
+            if(timer->expires == wheel_now){   // the others are a turn or more away
+                timer_unlink(timer);
+                timer->next = due;
+                due = timer;
+            }
+        }
+    }
+    spin_unlock(&timer_lock);
+
+    while(due != NULL){
+        next = due->next;                   // the callback may free or re-add it
+        due->func(due);
+        due = next;
+    }
+}
+
+/*
+ * timer_next
+ *   DESCRIPTION: Ticks until the next timer fires, for tickless idle
+ *   INPUTS: limit - do not look further than this
+ *   OUTPUTS: none
+ *   RETURN VALUE: ticks from the last tick timer_run went through, at most limit
+ *   SIDE EFFECTS: none
+ */
+uint32_t timer_next(uint32_t limit){
+    ktimer_t* timer;
+    uint32_t ticks, when;
+    uint32_t flags;
+
+    if(limit > TIMER_WHEEL_SIZE){
+        limit = TIMER_WHEEL_SIZE;
+    }
+    spin_lock_irqsave(&timer_lock, flags);
+    for(ticks = 1; ticks < limit; ticks++){
+        when = wheel_now + ticks;
+        for(timer = wheel[TIMER_SLOT(when)]; timer != NULL; timer = timer->next){
+            if(timer->expires == when){
+                spin_unlock_irqrestore(&timer_lock, flags);
+                return ticks;
+            }
+        }
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return limit;
+}
+
+/*
+ * timer_sleep
+ *   DESCRIPTION: Block the calling task for a number of ticks
+ *   INPUTS: ticks - how long
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: other tasks run meanwhile
+ */
+void timer_sleep(uint32_t ticks){
+    ktimer_t timer;
+    timer_sleeper_t sleeper = {0, WAIT_QUEUE_INIT};
+
+    if(ticks == 0){
+        return;
+    }
+    timer.func = timer_wake_sleeper;
+    timer.data = &sleeper;
+    timer_add_after(&timer, ticks);
+    sched_wait(&sleeper.wq, &sleeper.done);
+}
+
+/*
+ * timer_wake_sleeper
+ *   DESCRIPTION: Callback of the timer_sleep timers
+ *   INPUTS: timer - the expired timer, on the sleeper's stack
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The sleeper may return (and its stack be reused) as soon as
+ *                 its flag is set, so nothing of it is touched after that
+ */
+static void timer_wake_sleeper(ktimer_t* timer){
+    timer_sleeper_t* sleeper = timer->data;
+
+    sched_wake_cond(&sleeper->wq, &sleeper->done);
+}
+
+/*
+ * timer_link
+ *   DESCRIPTION: Put a timer in its wheel slot
+ *   INPUTS: timer - the timer, expires - pit_ticks value to fire at (the next tick if already past)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: caller holds timer_lock
+ */
+static void timer_link(ktimer_t* timer, uint32_t expires){
+    ktimer_t** slot;
+
+    if((int32_t)(expires - wheel_now) <= 0){
+        expires = wheel_now + 1;
+    }
+    timer->expires = expires;
+    slot = &wheel[TIMER_SLOT(expires)];
+    timer->prev = NULL;
+    timer->next = *slot;
+    if(*slot != NULL){
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+    timer->pending = TIMER_IN_WHEEL;
+}
+
+/*
+ * timer_unlink
+ *   DESCRIPTION: Take a pending timer out of its wheel slot or the undated list
+ *   INPUTS: timer - the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: caller holds timer_lock
+ */
+static void timer_unlink(ktimer_t* timer){
+    if(timer->prev != NULL){
+        timer->prev->next = timer->next;
+    } else if(timer->pending == TIMER_UNDATED){
+        undated = timer->next;
+    } else{
+        wheel[TIMER_SLOT(timer->expires)] = timer->next;
+    }
+    if(timer->next != NULL){
+        timer->next->prev = timer->prev;
+    }
+    timer->pending = 0;
+}
@@ -0,0 +1,114 @@
+/* timer.h - Kernel timers on a hashed timing wheel
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+#include "pit.h"
+
+/* A timer expires at an absolute pit_ticks value. It hangs in wheel slot
+ * (expires % TIMER_WHEEL_SIZE), so adding or cancelling one is O(1); the boot
+ * processor's tick visits one slot and fires the timers in it that are due,
+ * leaving the ones a whole turn or more away. Callbacks run in interrupt
+ * context, without the wheel lock held.
+ *
+ * pit_ticks stands still while the boot processor idles with its tick
+ * stopped, so on the other CPUs it can be up to timer_idle_max_ticks behind.
+ * timer_add_after is the way to arm a timer from "now" anywhere: one armed
+ * while the tick is stopped waits, undated, until the boot processor has
+ * woken and caught pit_ticks up. */
+
+#define TIMER_WHEEL_SIZE        256         // slots, a power of two
+#define TIMER_MS_PER_TICK       (1000 / pit_default_hz)
+#define TIMER_MS_TO_TICKS(ms)   ((ms) / TIMER_MS_PER_TICK + ((ms) % TIMER_MS_PER_TICK != 0))
+
+typedef struct ktimer {
+    uint32_t expires;                   // pit_ticks value it fires at
+    void (*func)(struct ktimer* timer);
+    void* data;                         // for func
+    struct ktimer* next;                // wheel slot links
+    struct ktimer* prev;
+    int pending;                        // TIMER_IN_WHEEL, TIMER_UNDATED, 0 otherwise
+} ktimer_t;
+
+#define TIMER_IN_WHEEL          1
+#define TIMER_UNDATED           2           // expires holds ticks from when the boot processor catches up
+
+/*
+ * timer_add
+ *   DESCRIPTION: Arm a timer
+ *   INPUTS: timer - func and data filled in, not pending
+ *           expires - pit_ticks value to fire at (the next tick if already past)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wakes a tickless boot processor so it can shorten its sleep
+ */
+void timer_add(ktimer_t* timer, uint32_t expires);
+
+/*
+ * timer_add_after
+ *   DESCRIPTION: Arm a timer to fire a number of ticks from now
+ *   INPUTS: timer - func and data filled in, not pending
+ *           ticks - how far away (at least the next tick)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wakes a tickless boot processor, which dates the timer from
+ *                 pit_ticks once it has caught up on the ticks it skipped
+ */
+void timer_add_after(ktimer_t* timer, uint32_t ticks);
+
+/*
+ * timer_resume
+ *   DESCRIPTION: End a tickless idle period of the boot processor
+ *   INPUTS: skipped - ticks that passed without an interrupt
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Adds them to pit_ticks, clears its idle_ticks and puts the
+ *                 timers armed meanwhile in the wheel, all under the wheel lock
+ */
+void timer_resume(uint32_t skipped);
+
+/*
+ * timer_cancel
+ *   DESCRIPTION: Disarm a timer
+ *   INPUTS: timer - the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it was still pending, 0 if it fired or was never armed
+ *   SIDE EFFECTS: none
+ */
+int32_t timer_cancel(ktimer_t* timer);
+
+/*
+ * timer_run
+ *   DESCRIPTION: Fire every timer due up to now (boot processor tick only)
+ *   INPUTS: now - current pit_ticks
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Catches up on ticks a tickless idle period skipped; calls
+ *                 the callbacks
+ */
+void timer_run(uint32_t now);
+
+/*
+ * timer_next
+ *   DESCRIPTION: Ticks until the next timer fires, for tickless idle
+ *   INPUTS: limit - do not look further than this
+ *   OUTPUTS: none
+ *   RETURN VALUE: ticks from pit_ticks, at most limit
+ *   SIDE EFFECTS: none
+ */
+uint32_t timer_next(uint32_t limit);
+
+/*
+ * timer_sleep
+ *   DESCRIPTION: Block the calling task for a number of ticks
+ *   INPUTS: ticks - how long
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: other tasks run meanwhile
+ */
+void timer_sleep(uint32_t ticks);
+
+#endif /* _TIMER_H */
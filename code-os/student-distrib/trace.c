@@ -0,0 +1,142 @@
+#include "trace.h"
+#include "lib.h"
+#include "systemcall.h"
+#include "fd.h"
+
+#define TRACE_LINE_SIZE 80              // longest rendered record, with room to spare
+
+/* Keeps the compiler from moving record accesses across the seq accesses.
+ * x86 itself keeps stores in order with stores and loads with loads. */
+#define TRACE_BARRIER() asm volatile ("" : : : "memory")
+
+volatile uint32_t trace_enabled = 1;
+
+static trace_record_t trace_ring[TRACE_RING_SIZE];
+static volatile uint32_t trace_head = 0;    // sequence number of the next record
+
+static int8_t* trace_event_names[TRACE_NUM_EVENTS] = {
+    "syscall",
+    "sysret",
+    "irq",
+    "irqret",
+    "switch",
+    "pagefault",
+    "exec",
+    "halt",
+    "sched"
+};
+
+/*
+ * trace_record
+ *   DESCRIPTION: Append one record to the trace ring (use the TRACE macro)
+ *   INPUTS: event - TRACE_* event type, arg0/arg1 - event specific values
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Claims the next ring slot, overwriting the oldest record
+ */
+void trace_record(uint32_t event, uint32_t arg0, uint32_t arg1){
+    uint32_t slot = 1;
+    trace_record_t* rec;
+
+    // atomically claim a sequence number; nested interrupts get the next one
+    asm volatile ("lock xaddl %0, %1"
+            : "+r"(slot), "+m"(trace_head)
+            :
+            : "memory", "cc"
+    );
+    rec = &trace_ring[slot & TRACE_RING_MASK];
+
+    rec->seq = 0;                               // mark the slot as being rewritten
+    TRACE_BARRIER();
+    rdtsc(&rec->tsc_lo, &rec->tsc_hi);
+    rec->event = event;
+    rec->pid = cur_pid;
+    rec->arg0 = arg0;
+    rec->arg1 = arg1;
+    TRACE_BARRIER();
+    rec->seq = slot + 1;                        // publish
+}
+
+/*
+ * trace_open, trace_close
+ *   DESCRIPTION: Open/close the "trace" device file
+ *   INPUTS: filename / fd
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none (the read position lives in the file array)
+ */
+int32_t trace_open(const uint8_t* filename){
+    return 0;
+}
+
+int32_t trace_close(int32_t fd){
+    return 0;
+}
+
+/*
+ * trace_read
+ *   DESCRIPTION: Render trace records as text lines, oldest first
+ *   INPUTS: fd - trace file descriptor, buf - user buffer, nbytes - size of buf
+ *   OUTPUTS: one line per record: "<tsc> <event> pid=<pid> <arg0> <arg1>"
+ *   RETURN VALUE: number of bytes written (whole lines only), 0 once caught up
+ *   SIDE EFFECTS: Advances the file position by the number of records read;
+ *                 records overwritten before they were read are skipped
+ */
+int32_t trace_read(int32_t fd, void* buf, int32_t nbytes){
+    file_array_struct* file = fd_get(get_pcb_ptr(), fd);
+    int8_t line[TRACE_LINE_SIZE];
+    trace_record_t rec;
+    trace_record_t* slot;
+    uint32_t head = trace_head;
+    uint32_t seq;
+    int32_t bytes_read = 0;
+    int32_t line_length;
+
+    // the oldest records still in the ring start TRACE_RING_SIZE back from head
+    if(head > TRACE_RING_SIZE && file->file_position < head - TRACE_RING_SIZE){
+        file->file_position = head - TRACE_RING_SIZE;
+    }
+
+    while(file->file_position < head){
+        // seq before and after the copy: a writer that lapped us during it
+        // changed seq, or left it 0, before touching the rest
+        slot = &trace_ring[file->file_position & TRACE_RING_MASK];
+        seq = slot->seq;
+        TRACE_BARRIER();
+        rec = *slot;
+        TRACE_BARRIER();
+        if(seq != file->file_position + 1 || slot->seq != seq){
+            file->file_position++;              // overwritten or still being written
+            continue;
+        }
+
+        line_length = snprintf(line, TRACE_LINE_SIZE, "%#x%#x %s pid=%u %#x %#x\n",
+                rec.tsc_hi, rec.tsc_lo,
+                (rec.event < TRACE_NUM_EVENTS) ? trace_event_names[rec.event] : "?",
+                (uint32_t)rec.pid, rec.arg0, rec.arg1);
+        if(bytes_read + line_length > nbytes){
+            break;                              // only whole lines
+        }
+        memcpy((int8_t*)buf + bytes_read, line, line_length);
+        bytes_read += line_length;
+        file->file_position++;
+    }
+
+    return bytes_read;
+}
+
+/*
+ * trace_write
+ *   DESCRIPTION: Turn tracing on or off
+ *   INPUTS: buf - pointer to an int32_t, 0 to stop recording, 1 to resume
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on bad input
+ *   SIDE EFFECTS: Sets trace_enabled
+ */
+int32_t trace_write(int32_t fd, const void* buf, int32_t nbytes){
+    if(buf == NULL || nbytes < sizeof(int32_t)){
+        return -1;
+    }
+    trace_enabled = (*(int32_t*)buf != 0);
+    return 0;
+}
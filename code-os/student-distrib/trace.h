@@ -0,0 +1,111 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "types.h"
+
+/* Kernel tracepoint ring buffer.
+ * Every TRACE() call appends one record stamped with the TSC. Writers claim a
+ * slot with a single locked xadd, so tracepoints are safe from interrupt
+ * context and never take a lock or touch the screen. The ring is read back
+ * through the "trace" device file (see trace_read). */
+
+#define TRACE_RING_SIZE     1024            // records kept; must be a power of two
+#define TRACE_RING_MASK     (TRACE_RING_SIZE - 1)
+
+/* Event types */
+#define TRACE_SYSCALL_ENTER 0               // arg0 = syscall number
+#define TRACE_SYSCALL_EXIT  1               // arg0 = syscall number, arg1 = return value
+#define TRACE_IRQ_ENTER     2               // arg0 = irq number
+#define TRACE_IRQ_EXIT      3               // arg0 = irq number
+#define TRACE_SWITCH        4               // arg0 = from terminal/pid, arg1 = to terminal/pid
+#define TRACE_PAGE_FAULT    5               // arg0 = faulting address (cr2), arg1 = error code
+#define TRACE_EXEC          6               // arg0 = exec phase, arg1 = phase detail
+#define TRACE_HALT          7               // arg0 = halt phase, arg1 = phase detail
+#define TRACE_SCHED         8               // arg0 = terminal switched out (-1 idle), arg1 = terminal switched in
+#define TRACE_NUM_EVENTS    9
+
+/* Phases reported by TRACE_EXEC */
+#define EXEC_PHASE_START    0               // arg1 = length of command
+#define EXEC_PHASE_PARSED   1               // arg1 = inode of the executable
+#define EXEC_PHASE_PAGED    2               // arg1 = new pid
+#define EXEC_PHASE_LOADED   3               // arg1 = bytes of program image
+#define EXEC_PHASE_PCB      4               // arg1 = parent pid
+#define EXEC_PHASE_USER     5               // arg1 = user entry point
+
+/* Phases reported by TRACE_HALT */
+#define HALT_PHASE_START    0               // arg1 = status
+#define HALT_PHASE_PARENT   1               // arg1 = parent pid
+#define HALT_PHASE_RETURN   2               // arg1 = status
+
+/* One trace record. seq is written last and equals (slot index + 1), so a
+ * reader can tell a completed record from one being overwritten. */
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t tsc_lo;
+    uint32_t tsc_hi;
+    uint16_t event;
+    uint16_t pid;
+    uint32_t arg0;
+    uint32_t arg1;
+} trace_record_t;
+
+/* 1 while tracepoints record (default); toggled by writing to "trace" */
+extern volatile uint32_t trace_enabled;
+
+/* Static tracepoint; compiles to a flag test when tracing is off */
+#define TRACE(event, arg0, arg1)                                    \
+do {                                                                \
+    if (trace_enabled)                                              \
+        trace_record((event), (uint32_t)(arg0), (uint32_t)(arg1));  \
+} while (0)
+
+/* Read the time stamp counter */
+static inline void rdtsc(uint32_t* lo, uint32_t* hi) {
+    asm volatile ("rdtsc"
+            : "=a"(*lo), "=d"(*hi)
+    );
+}
+
+/*
+ * trace_record
+ *   DESCRIPTION: Append one record to the trace ring (use the TRACE macro)
+ *   INPUTS: event - TRACE_* event type, arg0/arg1 - event specific values
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Claims the next ring slot, overwriting the oldest record
+ */
+void trace_record(uint32_t event, uint32_t arg0, uint32_t arg1);
+
+/*
+ * trace_open, trace_close
+ *   DESCRIPTION: Open/close the "trace" device file
+ *   INPUTS: filename / fd
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none (the read position lives in the file array)
+ */
+int32_t trace_open(const uint8_t* filename);
+int32_t trace_close(int32_t fd);
+
+/*
+ * trace_read
+ *   DESCRIPTION: Render trace records as text lines, oldest first
+ *   INPUTS: fd - trace file descriptor, buf - user buffer, nbytes - size of buf
+ *   OUTPUTS: one line per record: "<tsc> <event> pid=<pid> <arg0> <arg1>"
+ *   RETURN VALUE: number of bytes written (whole lines only), 0 once caught up
+ *   SIDE EFFECTS: Advances the file position by the number of records read;
+ *                 records overwritten before they were read are skipped
+ */
+int32_t trace_read(int32_t fd, void* buf, int32_t nbytes);
+
+/*
+ * trace_write
+ *   DESCRIPTION: Turn tracing on or off
+ *   INPUTS: buf - pointer to an int32_t, 0 to stop recording, 1 to resume
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on bad input
+ *   SIDE EFFECTS: Sets trace_enabled
+ */
+int32_t trace_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* _TRACE_H */
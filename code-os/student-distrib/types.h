@@ -9,6 +9,8 @@
 
 #define NULL 0
 
+#define INT32_MAX 0x7FFFFFFF
+
 #ifndef ASM
 
 /* Types defined here just like in <stdint.h> */
@@ -16,6 +16,9 @@
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
 
+/* Descriptors in the GDT: two null entries, kernel/user CS and DS, TSS, LDT */
+#define GDT_ENTRIES 8
+
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
 
@@ -118,6 +121,7 @@ extern uint16_t ldt_desc;
 extern uint32_t ldt_size;
 extern seg_desc_t ldt_desc_ptr;
 extern seg_desc_t gdt_ptr;
+extern seg_desc_t gdt[GDT_ENTRIES];
 extern uint32_t ldt;
 
 extern uint32_t tss_size;
@@ -201,6 +205,17 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Load the global descriptor table (GDT).  Like lidt, this takes the
+ * address of the 6-byte limit/base structure */
+#define lgdt(desc)                      \
+do {                                    \
+    asm volatile ("lgdt (%0)"           \
+            :                           \
+            : "r" (desc)                \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
 /* Load the local descriptor table (LDT) register.  This macro takes a
  * 16-bit index into the GDT, which points to the LDT entry.  x86 then
  * reads the GDT's LDT descriptor and loads the base address specified
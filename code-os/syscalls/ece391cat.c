@@ -3,10 +3,13 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
+#define REGULAR_FILE 2
+
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, left;
     uint8_t buf[1024];
+    struct ece391_stat st;
 
     if (0 != ece391_getargs (buf, 1024)) {
         ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
@@ -18,13 +21,22 @@ int main ()
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, 1024))) {
+    /* a regular file's length says when to stop, without a last empty read;
+       anything else is read until it returns 0 */
+    if (0 == ece391_fstat (fd, &st) && REGULAR_FILE == st.type)
+        left = st.length;
+    else
+        left = -1;
+
+    while (0 != left && 0 != (cnt = ece391_read (fd, buf, 1024))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
 	    return 3;
 	}
 	if (-1 == ece391_write (1, buf, cnt))
 	    return 3;
+	if (-1 != left)
+	    left = (cnt < left) ? left - cnt : 0;
     }
 
     return 0;
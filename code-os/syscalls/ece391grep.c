@@ -9,32 +9,37 @@
 int32_t
 do_one_file (const char* s, const char* fname) 
 {
-    int32_t fd, cnt, last, line_start, line_end, check, s_len;
+    int32_t fd, cnt, pos, line_start, line_end, check, s_len;
     uint8_t data[BUFSIZE+1];
+    struct ece391_iovec out[4];
 
     s_len = ece391_strlen ((uint8_t*)s);
     if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
         ece391_fdputs (1, (uint8_t*)"file open failed\n");
         return -1;
     }
-    last = 0;
+    out[0].base = (void*)fname;
+    out[0].len = ece391_strlen ((uint8_t*)fname);
+    out[1].base = ":";
+    out[1].len = 1;
+    out[3].base = "\n";
+    out[3].len = 1;
+    pos = 0;
     while (1) {
-        cnt = ece391_read (fd, data + last, BUFSIZE - last);
+        cnt = ece391_pread (fd, data, BUFSIZE, pos);
 	if (-1 == cnt) {
             ece391_fdputs (1, (uint8_t*)"file read failed\n");
             return -1;
 	}
-	last += cnt;
+	if (0 == cnt)
+	    break;
 	line_start = 0;
-	while (1) {
+	while (line_start < cnt) {
 	    line_end = line_start;
-	    while (line_end < last && '\n' != data[line_end])
+	    while (line_end < cnt && '\n' != data[line_end])
 		line_end++;
-	    if ('\n' != data[line_end] && 0 != cnt && line_start != 0) {
-		/* copy from line_start to last down to 0 and fix last */
-		data[line_end] = '\0';
-		ece391_strcpy (data, data + line_start);
-		last -= line_start;
+	    if (line_end == cnt && BUFSIZE == cnt && line_start != 0) {
+		/* partial line: read it again from its start next time */
 		break;
 	    }
 	    /* search the line */
@@ -42,21 +47,15 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    out[2].base = data + line_start;
+		    out[2].len = line_end - line_start;
+		    ece391_writev (1, out, 4);
 		    break;
 		}
 	    }
 	    line_start = line_end + 1;
-	    if (line_start >= last) {
-	        last = 0;
-		break;
-	    }
 	}
-	if (0 == cnt)
-	    break;
+	pos += (line_start < cnt ? line_start : cnt);
     }
     if (-1 == ece391_close (fd)) {
         ece391_fdputs (1, (uint8_t*)"file close failed\n");
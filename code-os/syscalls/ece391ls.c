@@ -4,24 +4,33 @@
 #include "ece391syscall.h"
 
 #define SBUFSIZE 33
+#define NUM_DIRENTS 16
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, i, len, out_len;
+    struct ece391_dirent ents[NUM_DIRENTS];
+    uint8_t out[NUM_DIRENTS * SBUFSIZE];
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    /* one getdents and one write per NUM_DIRENTS names */
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
+	    out_len = 0;
+	    for (i = 0; i < cnt / sizeof (ents[0]); i++) {
+	        for (len = 0; len < SBUFSIZE - 1 && '\0' != ents[i].name[len]; len++)
+	            out[out_len + len] = ents[i].name[len];
+	        out[out_len + len] = '\n';
+	        out_len += len + 1;
+	    }
+	    if (-1 == ece391_write (1, out, out_len))
 	        return 3;
     }
 
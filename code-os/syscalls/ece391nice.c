@@ -0,0 +1,52 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/*
+ * nice <value> <command> [args]
+ * Runs command at the given scheduling nice value, from -20 (favored) to 19
+ * (background). Programs the command executes inherit the value.
+ */
+int main ()
+{
+    int32_t value, sign, i;
+    uint8_t buf[BUFSIZE];
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: nice <value> <command> [args]\n");
+	return 3;
+    }
+
+    i = 0;
+    sign = 1;
+    if ('-' == buf[i]) {
+        sign = -1;
+	i++;
+    }
+    if (buf[i] < '0' || buf[i] > '9') {
+        ece391_fdputs (1, (uint8_t*)"usage: nice <value> <command> [args]\n");
+	return 3;
+    }
+    for (value = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+        value = value * 10 + (buf[i] - '0');
+    while (' ' == buf[i])
+        i++;
+    if ('\0' == buf[i]) {
+        ece391_fdputs (1, (uint8_t*)"usage: nice <value> <command> [args]\n");
+	return 3;
+    }
+
+    if (-1 == ece391_nice (-1, sign * value)) {
+        ece391_fdputs (1, (uint8_t*)"nice value must be between -20 and 19\n");
+	return 3;
+    }
+    if (-1 == ece391_execute (buf + i)) {
+        ece391_fdputs (1, (uint8_t*)"no such command\n");
+	return 2;
+    }
+
+    return 0;
+}
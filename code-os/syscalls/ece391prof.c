@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/*
+ * prof <command> [args]
+ * Runs command with the kernel's PIT sampling profiler on, then prints the
+ * sample histogram ("<eip> <pid> <image> <count>" lines). Feed the output to
+ * student-distrib/profsym.sh on the build host to get per-function totals.
+ */
+int main ()
+{
+    int32_t fd, cnt, status;
+    int32_t rate;
+    uint8_t buf[BUFSIZE];
+
+    if (0 != ece391_getargs (buf, BUFSIZE) || '\0' == buf[0]) {
+        ece391_fdputs (1, (uint8_t*)"usage: prof <command> [args]\n");
+	return 3;
+    }
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"profile"))) {
+        ece391_fdputs (1, (uint8_t*)"profiler not available\n");
+	return 2;
+    }
+
+    rate = 1;				/* kernel default sampling rate */
+    if (-1 == ece391_write (fd, &rate, sizeof (rate))) {
+        ece391_fdputs (1, (uint8_t*)"could not start profiler\n");
+	return 3;
+    }
+    status = ece391_execute (buf);
+    rate = 0;
+    (void)ece391_write (fd, &rate, sizeof (rate));
+
+    if (-1 == status) {
+        ece391_fdputs (1, (uint8_t*)"no such command\n");
+	return 2;
+    }
+
+    while (0 != (cnt = ece391_read (fd, buf, BUFSIZE))) {
+        if (-1 == cnt) {
+	    ece391_fdputs (1, (uint8_t*)"profile read failed\n");
+	    return 3;
+	}
+	if (-1 == ece391_write (1, buf, cnt))
+	    return 3;
+    }
+
+    return 0;
+}
@@ -0,0 +1,26 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/*
+ * sleep <ms>
+ * Waits the given number of milliseconds without using the RTC.
+ */
+int main ()
+{
+    uint32_t ms, i;
+    uint8_t buf[BUFSIZE];
+
+    if (0 != ece391_getargs (buf, BUFSIZE) || buf[0] < '0' || buf[0] > '9') {
+        ece391_fdputs (1, (uint8_t*)"usage: sleep <ms>\n");
+	return 3;
+    }
+    for (ms = 0, i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+        ms = ms * 10 + (buf[i] - '0');
+
+    (void)ece391_sleep (ms);
+    return 0;
+}
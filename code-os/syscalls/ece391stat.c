@@ -0,0 +1,45 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/*
+ * stat [reset]
+ * Prints the kernel's per-pid system call statistics: call and error counts
+ * and a latency histogram, where "k:n" means n calls took between 2^k and
+ * 2^(k+1) TSC cycles. "stat reset" clears the counters.
+ */
+int main ()
+{
+    int32_t fd, cnt;
+    int32_t zero = 0;
+    uint8_t buf[BUFSIZE];
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"sysstat"))) {
+        ece391_fdputs (1, (uint8_t*)"syscall statistics not available\n");
+	return 2;
+    }
+
+    if (0 == ece391_getargs (buf, BUFSIZE) &&
+        0 == ece391_strcmp (buf, (uint8_t*)"reset")) {
+        if (-1 == ece391_write (fd, &zero, sizeof (zero))) {
+	    ece391_fdputs (1, (uint8_t*)"reset failed\n");
+	    return 3;
+	}
+	return 0;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"pid syscall        calls errors log2(cycles):count\n");
+    while (0 != (cnt = ece391_read (fd, buf, BUFSIZE))) {
+        if (-1 == cnt) {
+	    ece391_fdputs (1, (uint8_t*)"sysstat read failed\n");
+	    return 3;
+	}
+	if (-1 == ece391_write (1, buf, cnt))
+	    return 3;
+    }
+
+    return 0;
+}
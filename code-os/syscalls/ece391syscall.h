@@ -5,6 +5,96 @@
 
 /* All calls return >= 0 on success or -1 on failure. */
 
+/* One buffer for readv and writev (at most 16 per call) */
+struct ece391_iovec {
+	void* base;
+	int32_t len;
+};
+
+/* One directory entry from getdents; name is NUL padded, not terminated at 32 */
+struct ece391_dirent {
+	uint8_t name[32];
+	uint32_t type;
+	uint32_t inode;
+	uint32_t length;
+};
+
+/* What stat and fstat report; type is 0 rtc, 1 directory, 2 regular file,
+ * 3 kernel device (terminal, trace, proc/...) */
+struct ece391_stat {
+	uint32_t type;
+	uint32_t inode;
+	uint32_t length;
+	uint32_t blocks;
+};
+
+/* Submission/completion ring for io_setup and io_enter. Queue a request at
+ * sq[sq_tail % IO_RING_ENTRIES] and advance sq_tail; io_enter runs queued
+ * requests in order and posts each result at cq[cq_tail % IO_RING_ENTRIES].
+ * Take results from cq_head and advance it. The counters never wrap back. */
+#define IO_RING_ENTRIES 32
+
+#define IO_OP_NOP   0
+#define IO_OP_READ  1
+#define IO_OP_WRITE 2
+#define IO_OP_OPEN  3	/* buf is the file name */
+#define IO_OP_CLOSE 4
+#define IO_OP_PREAD 5
+
+struct ece391_io_sqe {
+	uint32_t op;
+	int32_t fd;
+	void* buf;
+	int32_t nbytes;
+	uint32_t offset;
+	uint32_t user_data;
+};
+
+struct ece391_io_cqe {
+	uint32_t user_data;
+	int32_t result;
+};
+
+struct ece391_io_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	struct ece391_io_sqe sq[IO_RING_ENTRIES];
+	struct ece391_io_cqe cq[IO_RING_ENTRIES];
+};
+
+/* One descriptor for poll; revents gets the events ready, or POLLNVAL if fd
+ * is not open. A negative fd is skipped. */
+struct ece391_pollfd {
+	int32_t fd;
+	int16_t events;
+	int16_t revents;
+};
+
+#define POLLIN   0x01
+#define POLLOUT  0x04
+#define POLLNVAL 0x20
+
+/* ioctl requests. The flags belong to the open file; with O_NONBLOCK a read
+ * of a terminal with nothing typed returns 0 at once. The terminal mode
+ * belongs to the terminal and goes back to what it was when the program
+ * started (0, lines and echo, for a shell's) when the program halts: TERM_RAW hands over every key as it is typed, TERM_NOECHO
+ * stops keys from showing. */
+#define IOCTL_GETFL    1
+#define IOCTL_SETFL    2
+#define IOCTL_TGETMODE 3
+#define IOCTL_TSETMODE 4
+
+#define O_NONBLOCK  0x1
+#define TERM_RAW    0x1
+#define TERM_NOECHO 0x2
+
+/* lseek whence */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
 /*  
  * Note that the system call for halt will have to make sure that only
  * the low byte of EBX (the status argument) is returned to the calling
@@ -21,6 +111,25 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_nice (int32_t pid, int32_t value);
+extern int32_t ece391_sleep (uint32_t ms);
+extern int32_t ece391_fdlimit (int32_t limit);
+extern int32_t ece391_dup (int32_t fd);
+extern int32_t ece391_dup2 (int32_t fd, int32_t new_fd);
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+extern int32_t ece391_readv (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+extern int32_t ece391_getdents (int32_t fd, struct ece391_dirent* buf, int32_t nbytes);
+extern int32_t ece391_stat (const uint8_t* filename, struct ece391_stat* buf);
+extern int32_t ece391_fstat (int32_t fd, struct ece391_stat* buf);
+extern int32_t ece391_create (const uint8_t* filename);
+extern int32_t ece391_unlink (const uint8_t* filename);
+extern int32_t ece391_ftruncate (int32_t fd, uint32_t length);
+extern int32_t ece391_io_setup (struct ece391_io_ring* ring);
+extern int32_t ece391_io_enter (uint32_t to_submit);
+extern int32_t ece391_poll (struct ece391_pollfd* fds, uint32_t nfds, int32_t timeout_ms);
+extern int32_t ece391_ioctl (int32_t fd, uint32_t request, uint32_t arg);
 
 enum signums {
 	DIV_ZERO = 0,
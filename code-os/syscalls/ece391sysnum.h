@@ -11,5 +11,24 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_NICE    11
+#define SYS_SLEEP   12
+#define SYS_FDLIMIT  13
+#define SYS_DUP    14
+#define SYS_DUP2   15
+#define SYS_LSEEK  16
+#define SYS_PREAD  17
+#define SYS_READV  18
+#define SYS_WRITEV 19
+#define SYS_GETDENTS  20
+#define SYS_STAT   21
+#define SYS_FSTAT  22
+#define SYS_CREATE  23
+#define SYS_UNLINK  24
+#define SYS_FTRUNCATE  25
+#define SYS_IO_SETUP  26
+#define SYS_IO_ENTER  27
+#define SYS_POLL   28
+#define SYS_IOCTL  29
 
 #endif /* ECE391SYSNUM_H */